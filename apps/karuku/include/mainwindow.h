@@ -13,6 +13,9 @@
 class SheetListWidget;
 class CachingExcelResolver;
 class EXDPart;
+class ExcelSheetDiffer;
+class SearchDialog;
+class ReferencesDialog;
 
 class MainWindow : public KXmlGuiWindow
 {
@@ -30,6 +33,9 @@ public Q_SLOTS:
 private:
     void setupActions();
     void updateDocumentActions() const;
+    void compareWithInstall();
+    void openGlobalSearch();
+    void findReferences();
 
     FileCache m_cache;
     QNetworkAccessManager *m_mgr = nullptr;
@@ -37,4 +43,9 @@ private:
     std::unique_ptr<CachingExcelResolver> m_excelResolver;
     SheetListWidget *m_sheetListWidget = nullptr;
     QAction *m_saveAction = nullptr;
+    SearchDialog *m_searchDialog = nullptr;
+    ReferencesDialog *m_referencesDialog = nullptr;
+
+    // Only alive while comparing against another installation
+    std::unique_ptr<ExcelSheetDiffer> m_sheetDiffer;
 };
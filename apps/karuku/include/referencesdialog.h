@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QTreeWidget>
+
+#include "excelreferenceindex.h"
+
+/**
+ * @brief Lists every row that links to a given row, using an ExcelReferenceIndex.
+ */
+class ReferencesDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ReferencesDialog(const QString &gameDirectory, QWidget *parent = nullptr);
+    ~ReferencesDialog() override;
+
+    /**
+     * @brief Shows references to @p row in @p sheet. If the index is still being built, they're shown once it's done.
+     */
+    void showReferences(const QString &sheet, uint32_t row);
+
+Q_SIGNALS:
+    void referenceActivated(const QString &sheet, const QString &rowQuery);
+
+private:
+    void updateResults();
+
+    QFutureWatcher<ExcelReferenceIndex> *m_watcher = nullptr;
+    std::optional<ExcelReferenceIndex> m_index;
+
+    QString m_sheet;
+    uint32_t m_row = 0;
+
+    QLabel *m_statusLabel = nullptr;
+    QTreeWidget *m_results = nullptr;
+};
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
+#include <QProgressBar>
+#include <QTimer>
+#include <QTreeWidget>
+
+#include <memory>
+
+class ExcelSearchIndex;
+
+/**
+ * @brief Searches the contents of every sheet at once, using an ExcelSearchIndex.
+ */
+class SearchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SearchDialog(const QString &gameDirectory, QWidget *parent = nullptr);
+    ~SearchDialog() override;
+
+    void focusSearchField() const;
+
+Q_SIGNALS:
+    void hitActivated(const QString &sheet, const QString &rowQuery);
+
+private:
+    void rebuildIndex();
+    void runSearch();
+
+    QString m_gameDirectory;
+    std::unique_ptr<ExcelSearchIndex> m_index;
+    QFutureWatcher<void> *m_buildWatcher = nullptr;
+
+    QLineEdit *m_searchEdit = nullptr;
+    QCheckBox *m_indexNumbers = nullptr;
+    QProgressBar *m_progressBar = nullptr;
+    QLabel *m_statusLabel = nullptr;
+    QTreeWidget *m_results = nullptr;
+    QTimer *m_searchTimer = nullptr;
+};
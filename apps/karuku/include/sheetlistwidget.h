@@ -3,16 +3,25 @@
 
 #pragma once
 
-#include <QListView>
+#include <QComboBox>
+#include <QFuture>
+#include <QStandardItemModel>
+#include <QTreeView>
 #include <QWidget>
 #include <physis.hpp>
 
+#include "sheetmetadata.h"
+
+class FileCache;
+class SheetFilterModel;
+
 class SheetListWidget : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit SheetListWidget(const physis_SqPackResource *data, QWidget *parent = nullptr);
+    explicit SheetListWidget(FileCache &cache, QWidget *parent = nullptr);
+    ~SheetListWidget() override;
 
     void focusSearchField() const;
     void goToSheet(const QString &name) const;
@@ -21,7 +30,17 @@ Q_SIGNALS:
     void sheetSelected(const QString &name);
 
 private:
-    QListView *m_listWidget = nullptr;
+    /**
+     * @brief Fills in the extra columns once the metadata index is ready.
+     */
+    void applyMetadata(const QList<SheetMetadata> &metadata);
+
+    FileCache &m_cache;
+    QFuture<QList<SheetMetadata>> m_metadataFuture;
+    QTreeView *m_listWidget = nullptr;
+    QStandardItemModel *m_model = nullptr;
+    SheetFilterModel *m_searchModel = nullptr;
 
     QLineEdit *m_searchEdit = nullptr;
+    QComboBox *m_languageFilter = nullptr;
 };
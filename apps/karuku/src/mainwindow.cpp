@@ -4,6 +4,8 @@
 #include "mainwindow.h"
 
 #include "excelresolver.h"
+#include "settings.h"
+#include "sheetdiff.h"
 
 #include <KActionCollection>
 #include <KActionMenu>
@@ -14,10 +16,12 @@
 #include <QApplication>
 #include <QDesktopServices>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QInputDialog>
 #include <QListWidget>
 #include <QMessageBox>
 #include <QNetworkReply>
+#include <QProgressDialog>
 #include <QSplitter>
 #include <QStandardPaths>
 #include <QTemporaryDir>
@@ -26,6 +30,8 @@
 
 #include "exdpart.h"
 #include "openinwidget.h"
+#include "referencesdialog.h"
+#include "searchdialog.h"
 #include "sheetlistwidget.h"
 
 #include <QLineEdit>
@@ -39,7 +45,7 @@ MainWindow::MainWindow(const physis_SqPackResource data)
     dummyWidget->setChildrenCollapsible(false);
     setCentralWidget(dummyWidget);
 
-    m_sheetListWidget = new SheetListWidget(&data);
+    m_sheetListWidget = new SheetListWidget(m_cache);
     dummyWidget->addWidget(m_sheetListWidget);
 
     m_excelResolver = std::make_unique<CachingExcelResolver>(m_cache);
@@ -72,7 +78,11 @@ MainWindow::MainWindow(const physis_SqPackResource data)
     updateDocumentActions();
 }
 
-MainWindow::~MainWindow() = default;
+MainWindow::~MainWindow()
+{
+    // Children are only deleted after our members, but the sheet list may still be reading from m_cache
+    delete m_sheetListWidget;
+}
 
 QString MainWindow::getArguments() const
 {
@@ -220,6 +230,11 @@ void MainWindow::setupActions()
     });
     actionCollection()->addAction(QStringLiteral("download_list"), downloadList);
 
+    const auto compareInstall = new QAction(i18nc("@action:inmenu", "Compare With Install…"), this);
+    compareInstall->setIcon(QIcon::fromTheme(QStringLiteral("document-compare-symbolic")));
+    connect(compareInstall, &QAction::triggered, this, &MainWindow::compareWithInstall);
+    actionCollection()->addAction(QStringLiteral("compare_install"), compareInstall);
+
     const auto goToRow = new QAction(i18nc("@action:inmenu", "To Row…"), this);
     goToRow->setIcon(QIcon::fromTheme(QStringLiteral("go-jump-symbolic")));
     KActionCollection::setDefaultShortcut(goToRow, QKeySequence(Qt::Modifier::CTRL | Qt::Key::Key_G));
@@ -232,6 +247,12 @@ void MainWindow::setupActions()
     });
     actionCollection()->addAction(QStringLiteral("goto_row"), goToRow);
 
+    const auto findReferences = new QAction(i18nc("@action:inmenu", "References to Row…"), this);
+    findReferences->setIcon(QIcon::fromTheme(QStringLiteral("edit-find-symbolic")));
+    KActionCollection::setDefaultShortcut(findReferences, QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_G));
+    connect(findReferences, &QAction::triggered, this, &MainWindow::findReferences);
+    actionCollection()->addAction(QStringLiteral("find_references"), findReferences);
+
     actionCollection()->addAction(QStringLiteral("select_language"), m_exdPart->selectLanguageAction());
     actionCollection()->addAction(QStringLiteral("save_csv"), m_exdPart->saveCsvAction());
 
@@ -241,6 +262,12 @@ void MainWindow::setupActions()
     connect(focusSearch, &QAction::triggered, m_sheetListWidget, &SheetListWidget::focusSearchField);
     actionCollection()->addAction(QStringLiteral("search"), focusSearch);
 
+    const auto globalSearch = new QAction(i18nc("@action:inmenu", "Search All Sheets…"), this);
+    globalSearch->setIcon(QIcon::fromTheme(QStringLiteral("edit-find-symbolic")));
+    KActionCollection::setDefaultShortcut(globalSearch, QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    connect(globalSearch, &QAction::triggered, this, &MainWindow::openGlobalSearch);
+    actionCollection()->addAction(QStringLiteral("global_search"), globalSearch);
+
     const auto focusFilter = new QAction(i18nc("@action:inmenu", "Filter"), this);
     focusFilter->setIcon(QIcon::fromTheme(QStringLiteral("view-filter-symbolic")));
     KActionCollection::setDefaultShortcut(focusFilter, QKeySequence(Qt::CTRL | Qt::Key_I));
@@ -282,4 +309,123 @@ void MainWindow::updateDocumentActions() const
     m_saveAction->setEnabled(m_exdPart->isModified());
 }
 
+void MainWindow::compareWithInstall()
+{
+    // Only one comparison at a time
+    if (m_sheetDiffer) {
+        return;
+    }
+
+    QList<GameInstall> otherInstalls;
+    QStringList labels;
+    for (const auto &install : getGameInstalls()) {
+        if (install.uuid != QUuid::fromString(getGameUUID())) {
+            otherInstalls.push_back(install);
+            labels.push_back(QStringLiteral("%1 (%2)").arg(install.label, install.path));
+        }
+    }
+
+    if (otherInstalls.isEmpty()) {
+        QMessageBox::information(this,
+                                 i18nc("@title:window", "Compare With Install"),
+                                 i18n("There are no other game installations to compare against. Add one in the Novus SDK launcher first."));
+        return;
+    }
+
+    bool ok = false;
+    const QString label =
+        QInputDialog::getItem(this, i18nc("@title:window", "Compare With Install"), i18n("Older installation:"), labels, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+
+    const auto &install = otherInstalls[labels.indexOf(label)];
+
+    const QString reportPath = getSaveFileName(this,
+                                               QStringLiteral("ExcelEditorDiffReport"),
+                                               i18nc("@title:window", "Save Diff Report"),
+                                               QStringLiteral("diff.json"),
+                                               QStringLiteral("*.json"));
+    if (reportPath.isEmpty()) {
+        return;
+    }
+
+    const std::string installPathStd = install.path.toStdString();
+    auto resource = physis_sqpack_initialize(installPathStd.c_str());
+    if (!resource.p_ptr) {
+        QMessageBox::warning(this, i18nc("@title:window", "Compare With Install"), i18n("Failed to read game data from %1.", install.path));
+        return;
+    }
+
+    // The differ reads through its own caches, since m_cache never lets go of anything
+    const QString gameDirectory = getGameDirectory();
+    const std::string gameDirectoryStd = gameDirectory.toStdString();
+    auto currentResource = physis_sqpack_initialize(gameDirectoryStd.c_str());
+    if (!currentResource.p_ptr) {
+        physis_sqpack_free(&resource);
+        QMessageBox::warning(this, i18nc("@title:window", "Compare With Install"), i18n("Failed to read game data from %1.", gameDirectory));
+        return;
+    }
+
+    m_sheetDiffer = std::make_unique<ExcelSheetDiffer>(resource, currentResource);
+
+    const auto progressDialog = new QProgressDialog(i18n("Comparing sheets…"), i18n("Cancel"), 0, 0, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+
+    const auto watcher = new QFutureWatcher<SheetDiff>(this);
+    connect(watcher, &QFutureWatcherBase::progressRangeChanged, progressDialog, &QProgressDialog::setRange);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcherBase::cancel);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, progressDialog, reportPath] {
+        progressDialog->deleteLater();
+        watcher->deleteLater();
+
+        if (!watcher->isCanceled()) {
+            if (ExcelSheetDiffer::writeReport(watcher->future().results(), reportPath)) {
+                QMessageBox::information(this, i18nc("@title:window", "Compare With Install"), i18n("Successfully wrote diff report to %1.", reportPath));
+            } else {
+                QMessageBox::warning(this, i18nc("@title:window", "Compare With Install"), i18n("Failed to write diff report to %1.", reportPath));
+            }
+        }
+
+        m_sheetDiffer.reset();
+    });
+    watcher->setFuture(m_sheetDiffer->diffAllSheets(getLanguage()));
+}
+
+void MainWindow::openGlobalSearch()
+{
+    // Created lazily, since it starts indexing every sheet as soon as it exists
+    if (!m_searchDialog) {
+        m_searchDialog = new SearchDialog(getGameDirectory(), this);
+        connect(m_searchDialog, &SearchDialog::hitActivated, this, &MainWindow::jumpToSheetAndRow);
+    }
+
+    m_searchDialog->show();
+    m_searchDialog->raise();
+    m_searchDialog->activateWindow();
+    m_searchDialog->focusSearchField();
+}
+
+void MainWindow::findReferences()
+{
+    // Subrows can't be linked to, only their parent row
+    const QString rowQuery = m_exdPart->selectedRow();
+    if (rowQuery.isEmpty()) {
+        return;
+    }
+
+    // Created lazily, since it starts reading every sheet as soon as it exists
+    if (!m_referencesDialog) {
+        m_referencesDialog = new ReferencesDialog(getGameDirectory(), this);
+        connect(m_referencesDialog, &ReferencesDialog::referenceActivated, this, &MainWindow::jumpToSheetAndRow);
+    }
+
+    m_referencesDialog->showReferences(m_exdPart->name(), rowQuery.section(QLatin1Char('.'), 0, 0).toUInt());
+    m_referencesDialog->show();
+    m_referencesDialog->raise();
+    m_referencesDialog->activateWindow();
+}
+
 #include "moc_mainwindow.cpp"
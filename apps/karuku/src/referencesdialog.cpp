@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "referencesdialog.h"
+
+#include "filecache.h"
+#include "settings.h"
+
+#include <KLocalizedString>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+enum ReferenceColumn {
+    SheetColumn,
+    RowColumn,
+    ColumnColumn,
+};
+
+// Set on the sheet item, holds the row query to jump to
+static constexpr int RowQueryRole = Qt::UserRole;
+
+ReferencesDialog::ReferencesDialog(const QString &gameDirectory, QWidget *parent)
+    : QDialog(parent)
+{
+    resize(640, 480);
+
+    const auto layout = new QVBoxLayout();
+    setLayout(layout);
+
+    m_statusLabel = new QLabel();
+    layout->addWidget(m_statusLabel);
+
+    m_results = new QTreeWidget();
+    m_results->setRootIsDecorated(false);
+    m_results->setUniformRowHeights(true);
+    m_results->setSortingEnabled(true);
+    m_results->setHeaderLabels({
+        i18nc("@title:column", "Sheet"),
+        i18nc("@title:column", "Row"),
+        i18nc("@title:column", "Column"),
+    });
+    m_results->header()->setStretchLastSection(false);
+    m_results->header()->setSectionResizeMode(SheetColumn, QHeaderView::Stretch);
+    connect(m_results, &QTreeWidget::itemActivated, this, [this](const QTreeWidgetItem *item) {
+        Q_EMIT referenceActivated(item->text(SheetColumn), item->data(SheetColumn, RowQueryRole).toString());
+    });
+    layout->addWidget(m_results);
+
+    // Every sheet has to be read to build the index, so do it with a separate cache that doesn't hold onto them afterwards
+    m_watcher = new QFutureWatcher<ExcelReferenceIndex>(this);
+    connect(m_watcher, &QFutureWatcherBase::finished, this, [this] {
+        m_index = m_watcher->result();
+        updateResults();
+    });
+    const QString gameVersion = getGameVersion(gameDirectory);
+    m_watcher->setFuture(QtConcurrent::run([gameDirectory, gameVersion] {
+        const std::string gameDirectoryStd = gameDirectory.toStdString();
+        FileCache cache(physis_sqpack_initialize(gameDirectoryStd.c_str()));
+
+        QStringList names;
+        const auto sheetNames = physis_sqpack_get_all_sheet_names(&cache.resource());
+        for (uint32_t i = 0; i < sheetNames.name_count; i++) {
+            names.push_back(QString::fromStdString(sheetNames.names[i]));
+        }
+        physis_sqpack_free_all_sheet_names(sheetNames);
+
+        return ExcelReferenceIndex::loadOrBuild(cache, names, gameVersion);
+    }));
+}
+
+ReferencesDialog::~ReferencesDialog()
+{
+    m_watcher->waitForFinished();
+}
+
+void ReferencesDialog::showReferences(const QString &sheet, const uint32_t row)
+{
+    m_sheet = sheet;
+    m_row = row;
+
+    setWindowTitle(i18nc("@title:window", "References to %1#%2", sheet, row));
+    updateResults();
+}
+
+void ReferencesDialog::updateResults()
+{
+    m_results->clear();
+
+    if (!m_index) {
+        m_statusLabel->setText(i18n("Indexing sheets…"));
+        return;
+    }
+
+    const auto references = m_index->referencesTo(m_sheet, m_row);
+
+    QList<QTreeWidgetItem *> items;
+    items.reserve(references.size());
+    for (const auto &reference : references) {
+        const auto item = new QTreeWidgetItem();
+        item->setText(SheetColumn, reference.sheet);
+        item->setData(SheetColumn, RowQueryRole, reference.rowQuery());
+        item->setText(RowColumn, reference.rowQuery());
+        item->setText(ColumnColumn, reference.column);
+        items.push_back(item);
+    }
+    m_results->addTopLevelItems(items);
+
+    m_statusLabel->setText(i18np("1 reference", "%1 references", references.size()));
+}
+
+#include "moc_referencesdialog.cpp"
@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "searchdialog.h"
+
+#include "excelsearchindex.h"
+
+#include <KLocalizedString>
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <magic_enum.hpp>
+
+enum SearchResultColumn {
+    SheetColumn,
+    RowColumn,
+    ColumnColumn,
+    LanguageColumn,
+};
+
+// Set on the sheet item, holds the row query to jump to
+static constexpr int RowQueryRole = Qt::UserRole;
+
+SearchDialog::SearchDialog(const QString &gameDirectory, QWidget *parent)
+    : QDialog(parent)
+    , m_gameDirectory(gameDirectory)
+{
+    setWindowTitle(i18nc("@title:window", "Search All Sheets"));
+    resize(640, 480);
+
+    const auto layout = new QVBoxLayout();
+    setLayout(layout);
+
+    const auto searchLayout = new QHBoxLayout();
+    layout->addLayout(searchLayout);
+
+    m_searchEdit = new QLineEdit();
+    m_searchEdit->setPlaceholderText(i18nc("@info:placeholder", "Search…"));
+    m_searchEdit->setClearButtonEnabled(true);
+    searchLayout->addWidget(m_searchEdit);
+
+    m_indexNumbers = new QCheckBox(i18nc("@option:check", "Include numbers"));
+    m_indexNumbers->setToolTip(i18n("Also search integer cells. This makes the index much larger."));
+    connect(m_indexNumbers, &QCheckBox::toggled, this, &SearchDialog::rebuildIndex);
+    searchLayout->addWidget(m_indexNumbers);
+
+    // Don't search on every keystroke
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(150);
+    connect(m_searchTimer, &QTimer::timeout, this, &SearchDialog::runSearch);
+    connect(m_searchEdit, &QLineEdit::textChanged, m_searchTimer, qOverload<>(&QTimer::start));
+
+    m_results = new QTreeWidget();
+    m_results->setRootIsDecorated(false);
+    m_results->setUniformRowHeights(true);
+    m_results->setHeaderLabels({
+        i18nc("@title:column", "Sheet"),
+        i18nc("@title:column", "Row"),
+        i18nc("@title:column", "Column"),
+        i18nc("@title:column", "Language"),
+    });
+    m_results->header()->setStretchLastSection(false);
+    m_results->header()->setSectionResizeMode(SheetColumn, QHeaderView::Stretch);
+    connect(m_results, &QTreeWidget::itemActivated, this, [this](const QTreeWidgetItem *item) {
+        Q_EMIT hitActivated(item->text(SheetColumn), item->data(SheetColumn, RowQueryRole).toString());
+    });
+    layout->addWidget(m_results);
+
+    const auto statusLayout = new QHBoxLayout();
+    layout->addLayout(statusLayout);
+
+    m_statusLabel = new QLabel();
+    statusLayout->addWidget(m_statusLabel, 1);
+
+    m_progressBar = new QProgressBar();
+    m_progressBar->setMaximumWidth(200);
+    statusLayout->addWidget(m_progressBar);
+
+    m_buildWatcher = new QFutureWatcher<void>(this);
+    connect(m_buildWatcher, &QFutureWatcherBase::progressRangeChanged, m_progressBar, &QProgressBar::setRange);
+    connect(m_buildWatcher, &QFutureWatcherBase::progressValueChanged, this, [this](const int value) {
+        m_progressBar->setValue(value);
+        m_progressBar->setFormat(i18n("Indexing %1/%2", value, m_progressBar->maximum()));
+    });
+    connect(m_buildWatcher, &QFutureWatcherBase::finished, this, [this] {
+        m_progressBar->hide();
+        // Earlier results may have been missing sheets that weren't indexed yet
+        runSearch();
+    });
+
+    rebuildIndex();
+}
+
+SearchDialog::~SearchDialog() = default;
+
+void SearchDialog::focusSearchField() const
+{
+    m_searchEdit->setFocus(Qt::FocusReason::ShortcutFocusReason);
+    m_searchEdit->selectAll();
+}
+
+void SearchDialog::rebuildIndex()
+{
+    m_buildWatcher->setFuture({});
+    m_index = std::make_unique<ExcelSearchIndex>(m_gameDirectory, m_indexNumbers->isChecked());
+
+    m_progressBar->show();
+    m_buildWatcher->setFuture(m_index->build());
+
+    runSearch();
+}
+
+void SearchDialog::runSearch()
+{
+    m_results->clear();
+
+    const QString query = m_searchEdit->text();
+    if (query.trimmed().isEmpty()) {
+        m_statusLabel->clear();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const auto hits = m_index->search(query);
+
+    const auto elapsed = timer.elapsed();
+
+    QList<QTreeWidgetItem *> items;
+    items.reserve(hits.size());
+    for (const auto &hit : hits) {
+        const auto item = new QTreeWidgetItem();
+        item->setText(SheetColumn, hit.sheet);
+        item->setData(SheetColumn, RowQueryRole, hit.rowQuery());
+        item->setText(RowColumn, hit.rowQuery());
+        item->setText(ColumnColumn, QString::number(hit.column));
+        item->setText(LanguageColumn, QString::fromUtf8(magic_enum::enum_name(hit.language)));
+        items.push_back(item);
+    }
+    m_results->addTopLevelItems(items);
+
+    m_statusLabel->setText(i18np("1 result in %2 ms", "%1 results in %2 ms", hits.size(), elapsed));
+}
+
+#include "moc_searchdialog.cpp"
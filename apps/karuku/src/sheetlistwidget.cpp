@@ -3,55 +3,173 @@
 
 #include "sheetlistwidget.h"
 
+#include "filecache.h"
+#include "settings.h"
+#include "sheetmetadata.h"
+
 #include <KLocalizedString>
+#include <QFutureWatcher>
+#include <QHeaderView>
 #include <QLineEdit>
 #include <QSortFilterProxyModel>
-#include <QStringListModel>
 #include <QVBoxLayout>
+#include <QtConcurrent>
+#include <magic_enum.hpp>
+
+enum SheetListColumn {
+    NameColumn,
+    RowsColumn,
+    PagesColumn,
+    ColumnsColumn,
+    LanguagesColumn,
+    SheetListColumnCount,
+};
+
+// Set on the name item, holds a list of Language values once the metadata is known
+static constexpr int LanguagesRole = Qt::UserRole;
+
+/**
+ * @brief Filters sheets by name, and optionally by which language they have data for.
+ */
+class SheetFilterModel : public QSortFilterProxyModel
+{
+public:
+    using QSortFilterProxyModel::QSortFilterProxyModel;
+
+    void setLanguageFilter(const std::optional<Language> language)
+    {
+        m_language = language;
+        invalidateRowsFilter();
+    }
+
+protected:
+    bool filterAcceptsRow(const int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        if (m_language) {
+            const auto languages = sourceModel()->index(sourceRow, NameColumn, sourceParent).data(LanguagesRole);
+
+            // Don't hide anything until the metadata has loaded
+            if (languages.isValid() && !languages.toList().contains(static_cast<int>(*m_language))) {
+                return false;
+            }
+        }
 
-SheetListWidget::SheetListWidget(const physis_SqPackResource *data, QWidget *parent)
+        return QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
+    }
+
+private:
+    std::optional<Language> m_language;
+};
+
+SheetListWidget::SheetListWidget(FileCache &cache, QWidget *parent)
     : QWidget(parent)
+    , m_cache(cache)
 {
     const auto layout = new QVBoxLayout();
     layout->setContentsMargins(0, 0, 0, 0);
     layout->setSpacing(0);
     setLayout(layout);
 
-    auto searchModel = new QSortFilterProxyModel(this);
-    searchModel->setRecursiveFilteringEnabled(true);
-    searchModel->setFilterCaseSensitivity(Qt::CaseSensitivity::CaseInsensitive);
+    m_searchModel = new SheetFilterModel(this);
+    m_searchModel->setRecursiveFilteringEnabled(true);
+    m_searchModel->setFilterCaseSensitivity(Qt::CaseSensitivity::CaseInsensitive);
+    m_searchModel->setFilterKeyColumn(NameColumn);
 
     m_searchEdit = new QLineEdit();
     m_searchEdit->setPlaceholderText(i18nc("@info:placeholder", "Search…"));
     m_searchEdit->setClearButtonEnabled(true);
     m_searchEdit->setProperty("_breeze_borders_sides", QVariant::fromValue(QFlags{Qt::BottomEdge}));
-    connect(m_searchEdit, &QLineEdit::textChanged, this, [=](const QString &text) {
-        searchModel->setFilterRegularExpression(text);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        m_searchModel->setFilterRegularExpression(text);
     });
     layout->addWidget(m_searchEdit);
 
-    const auto originalModel = new QStringListModel(this);
-    searchModel->setSourceModel(originalModel);
+    m_languageFilter = new QComboBox();
+    m_languageFilter->addItem(i18n("All Languages"), -1);
+    for (const auto language : magic_enum::enum_values<Language>()) {
+        if (language == Language::None) {
+            m_languageFilter->addItem(i18n("Unlocalized"), static_cast<int>(language));
+        } else {
+            m_languageFilter->addItem(QString::fromUtf8(magic_enum::enum_name(language)), static_cast<int>(language));
+        }
+    }
+    m_languageFilter->setEnabled(false); // Enabled once we know what languages each sheet has
+    connect(m_languageFilter, &QComboBox::currentIndexChanged, this, [this] {
+        const int language = m_languageFilter->currentData().toInt();
+        if (language == -1) {
+            m_searchModel->setLanguageFilter(std::nullopt);
+        } else {
+            m_searchModel->setLanguageFilter(static_cast<Language>(language));
+        }
+    });
+    layout->addWidget(m_languageFilter);
+
+    m_model = new QStandardItemModel(0, SheetListColumnCount, this);
+    m_model->setHorizontalHeaderLabels({
+        i18nc("@title:column", "Name"),
+        i18nc("@title:column", "Rows"),
+        i18nc("@title:column", "Pages"),
+        i18nc("@title:column", "Columns"),
+        i18nc("@title:column", "Languages"),
+    });
+    m_searchModel->setSourceModel(m_model);
 
-    QStringList list;
+    QStringList names;
 
-    const auto names = physis_sqpack_get_all_sheet_names(data);
-    for (uint32_t i = 0; i < names.name_count; i++) {
-        list.push_back(QString::fromStdString(names.names[i]));
+    const auto sheetNames = physis_sqpack_get_all_sheet_names(&m_cache.resource());
+    for (uint32_t i = 0; i < sheetNames.name_count; i++) {
+        names.push_back(QString::fromStdString(sheetNames.names[i]));
     }
-    physis_sqpack_free_all_sheet_names(names);
+    physis_sqpack_free_all_sheet_names(sheetNames);
 
-    originalModel->setStringList(list);
+    for (const auto &name : std::as_const(names)) {
+        QList<QStandardItem *> items;
+        for (int i = 0; i < SheetListColumnCount; i++) {
+            const auto item = new QStandardItem();
+            item->setEditable(false);
+            items.push_back(item);
+        }
+        items[NameColumn]->setText(name);
 
-    m_listWidget = new QListView();
-    m_listWidget->setModel(searchModel);
-    m_listWidget->setEditTriggers(QListView::EditTrigger::NoEditTriggers);
+        m_model->appendRow(items);
+    }
 
-    connect(m_listWidget, &QListView::activated, [this, searchModel](const QModelIndex &index) {
-        Q_EMIT sheetSelected(searchModel->mapToSource(index).data(Qt::DisplayRole).toString());
+    m_listWidget = new QTreeView();
+    m_listWidget->setModel(m_searchModel);
+    m_listWidget->setRootIsDecorated(false);
+    m_listWidget->setUniformRowHeights(true);
+    m_listWidget->setEditTriggers(QTreeView::EditTrigger::NoEditTriggers);
+    m_listWidget->setSortingEnabled(true);
+    m_listWidget->header()->setSortIndicatorClearable(true);
+    m_listWidget->header()->setStretchLastSection(false);
+    m_listWidget->header()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+
+    // Keep the original sheet order until the user asks otherwise
+    m_listWidget->sortByColumn(-1, Qt::SortOrder::AscendingOrder);
+
+    connect(m_listWidget, &QTreeView::activated, [this](const QModelIndex &index) {
+        Q_EMIT sheetSelected(m_searchModel->mapToSource(index).siblingAtColumn(NameColumn).data(Qt::DisplayRole).toString());
     });
 
     layout->addWidget(m_listWidget);
+
+    // Parsing every EXH takes a while, so do it in the background
+    const auto watcher = new QFutureWatcher<QList<SheetMetadata>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher] {
+        applyMetadata(watcher->result());
+        watcher->deleteLater();
+    });
+    const QString gameVersion = getGameVersion(getGameDirectory());
+    m_metadataFuture = QtConcurrent::run([&cache = m_cache, names, gameVersion] {
+        return SheetMetadataIndex::loadOrBuild(cache, names, gameVersion);
+    });
+    watcher->setFuture(m_metadataFuture);
+}
+
+SheetListWidget::~SheetListWidget()
+{
+    // The worker reads through m_cache, which the owner destroys right after us
+    m_metadataFuture.waitForFinished();
 }
 
 void SheetListWidget::focusSearchField() const
@@ -65,8 +183,37 @@ void SheetListWidget::goToSheet(const QString &name) const
     if (indices.isEmpty()) {
         return;
     }
-    m_listWidget->scrollTo(indices.constFirst(), QListView::ScrollHint::PositionAtCenter);
-    m_listWidget->selectionModel()->select(indices.constFirst(), QItemSelectionModel::ClearAndSelect);
+    m_listWidget->scrollTo(indices.constFirst(), QTreeView::ScrollHint::PositionAtCenter);
+    m_listWidget->selectionModel()->select(indices.constFirst(), QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+}
+
+void SheetListWidget::applyMetadata(const QList<SheetMetadata> &metadata)
+{
+    // The metadata is in the same order as the names we passed in
+    for (int i = 0; i < std::min(static_cast<int>(metadata.size()), m_model->rowCount()); i++) {
+        const auto &sheet = metadata[i];
+        Q_ASSERT(m_model->item(i, NameColumn)->text() == sheet.name);
+
+        QVariantList languageValues;
+        QStringList languageNames;
+        for (const auto language : sheet.languages) {
+            languageValues.push_back(static_cast<int>(language));
+
+            // None is reported by many localized sheets, and isn't interesting to show there
+            if (language != Language::None || !sheet.isLocalized()) {
+                languageNames.push_back(QString::fromUtf8(magic_enum::enum_name(language)));
+            }
+        }
+
+        m_model->item(i, NameColumn)->setData(languageValues, LanguagesRole);
+        m_model->item(i, RowsColumn)->setData(sheet.rowCount, Qt::DisplayRole);
+        m_model->item(i, PagesColumn)->setData(sheet.pageCount, Qt::DisplayRole);
+        m_model->item(i, ColumnsColumn)->setData(static_cast<int>(sheet.columnTypes.size()), Qt::DisplayRole);
+        m_model->item(i, ColumnsColumn)->setToolTip(sheet.columnTypes.join(QStringLiteral(", ")));
+        m_model->item(i, LanguagesColumn)->setText(languageNames.join(QStringLiteral(", ")));
+    }
+
+    m_languageFilter->setEnabled(true);
 }
 
 #include "moc_sheetlistwidget.cpp"
@@ -172,6 +172,10 @@ void MainWindow::setupActions()
                                       .arg(m_part->mapView()->part().manager()->scene.culledLights));
     });
 
+    connect(&m_part->mapView()->part(), &MDLPart::modelPicked, this, [this](const int index) {
+        statusBar()->showMessage(i18n("Picked %1", QString::fromStdString(m_part->mapView()->part().getModel(index).name)), 5000);
+    });
+
     actionCollection()->addAction(QStringLiteral("wireframe"), m_part->mapView()->part().wireframeAction());
     actionCollection()->addAction(QStringLiteral("frustum_culling"), m_part->mapView()->part().frustumCullingAction());
     actionCollection()->addAction(QStringLiteral("debug_frustum_culling"), m_part->mapView()->part().debugFrustumCullingAction());
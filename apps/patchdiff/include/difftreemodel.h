@@ -5,9 +5,11 @@
 
 #include "hashdatabase.h"
 #include "physis.hpp"
+#include "zipatchreader.h"
 
 #include <QAbstractItemModel>
 #include <QFutureWatcher>
+#include <QPromise>
 
 struct SqPackResource;
 
@@ -50,16 +52,55 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
+    /**
+     * @brief Starts reading the patch at @p path. The tree is filled in from a background thread as chunks are read.
+     */
     void openPatch(const QString &path);
 
+Q_SIGNALS:
+    /**
+     * @brief Emitted as the patch is read, with @p progress going from 0 to 1000.
+     */
+    void loadingProgress(int progress);
+    void loadingFinished();
+
 private:
+    /**
+     * @brief A file or index touched by the patch, as found by the background thread.
+     */
+    struct PatchEntry {
+        QString indexPath;
+        std::optional<Hash> hash; // only for AddData
+        physis_Buffer buffer = {};
+    };
+
+    /**
+     * @brief Walks the patch and resolves which file each block belongs to. Runs on a worker thread.
+     */
+    void readPatch(QPromise<QList<PatchEntry>> &promise);
+
+    /**
+     * @brief Adds entries found by readPatch to the tree. Runs on the main thread.
+     */
+    void addEntries(const QList<PatchEntry> &entries);
+
     void addGamePath(TreeInformation *baseItem, const QString &string);
     TreeInformation *addIndexPath(const QString &string);
 
+    /**
+     * @brief Appends @p child to @p parent, notifying any views.
+     */
+    void appendChild(TreeInformation *parent, TreeInformation *child);
+    QModelIndex indexForItem(TreeInformation *item) const;
+
     physis_SqPackResource *gameData = nullptr;
     TreeInformation *rootItem = nullptr;
     HashDatabase &m_database;
     QHash<uint32_t, TreeInformation *> m_knownDirHashes;
     QHash<uint32_t, TreeInformation *> m_knownIndexHashes;
-    std::optional<physis_ZiPatch> m_patch;
+    QHash<QString, TreeInformation *> m_indexItems;
+
+    // Tree items point into the mapped patch, so this has to outlive them
+    std::unique_ptr<ZiPatchReader> m_reader;
+    QFutureWatcher<QList<PatchEntry>> *m_watcher = nullptr;
 };
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <QLineEdit>
+#include <QProgressBar>
 #include <QSortFilterProxyModel>
 #include <QTreeView>
 #include <physis.hpp>
@@ -30,4 +31,5 @@ private:
     HashDatabase &m_database;
     QTreeView *m_treeWidget = nullptr;
     QLineEdit *m_searchEdit = nullptr;
+    QProgressBar *m_progressBar = nullptr;
 };
@@ -22,6 +22,9 @@ public:
 private:
     void setupActions();
     void openPatch(const QUrl &url);
+    void extractBlocks();
+    void compareWithGame();
+    void showPatchHistory();
 
     physis_SqPackResource m_data;
     FileCache m_cache;
@@ -29,4 +32,7 @@ private:
     DiffTreeWidget *m_diffTreeWidget = nullptr;
     KRecentFilesMenu *m_recentFilesMenu = nullptr;
     HexPart *m_hexPart = nullptr;
+    QString m_patchPath;
+    QAction *m_extractAction = nullptr;
+    QAction *m_compareAction = nullptr;
 };
@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
+#include <QTreeWidget>
+
+#include "patchchainindex.h"
+
+/**
+ * @brief Lists which patches in a directory touched a given file, using a PatchChainIndex.
+ */
+class PatchChainDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    PatchChainDialog(const QString &directory, const QString &gameDirectory, Platform platform, QWidget *parent = nullptr);
+    ~PatchChainDialog() override;
+
+Q_SIGNALS:
+    void patchActivated(const QString &path);
+
+private:
+    void updateResults();
+
+    QString m_directory;
+    QFutureWatcher<PatchChainIndex> *m_watcher = nullptr;
+    std::optional<PatchChainIndex> m_index;
+
+    QLineEdit *m_pathEdit = nullptr;
+    QLabel *m_statusLabel = nullptr;
+    QTreeWidget *m_results = nullptr;
+};
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <physis.hpp>
+
+#include <optional>
+#include <vector>
+
+/**
+ * @brief Answers "which patch last touched this file?" for a directory of patches.
+ *
+ * Patches are ordered by their filename, which is how the official ones are named. File hashes are resolved against the installed game's index files,
+ * so blocks written by much older patches may resolve to whatever lives at that offset today.
+ */
+class PatchChainIndex
+{
+public:
+    struct Touch {
+        QString patch;
+        qint64 offset = 0; // of the chunk in the patch file
+
+        /**
+         * @brief 0 for data blocks, otherwise the SqpkFileOperation command (A, D, R or M.)
+         */
+        char operation = 0;
+    };
+
+    /**
+     * @brief Returns every patch that touched @p path, oldest first. @p path is either a game path or one relative to the game directory.
+     */
+    QList<Touch> touches(const QString &path) const;
+
+    /**
+     * @brief Returns the most recent patch that touched @p path, if any.
+     */
+    std::optional<Touch> lastTouch(const QString &path) const;
+
+    qsizetype patchCount() const;
+
+    /**
+     * @return The path where the index for @p directory and @p gameVersion is stored.
+     */
+    static QString cachePath(const QString &directory, const QString &gameVersion);
+
+    static std::optional<PatchChainIndex> load(const QString &path);
+    bool save(const QString &path) const;
+
+    /**
+     * @brief Scans every patch in @p directory, in parallel.
+     */
+    static PatchChainIndex build(const QString &directory, const QString &gameDirectory, Platform platform);
+
+    /**
+     * @brief Loads the cached index for @p directory, or builds and caches a new one if any of the patches changed.
+     */
+    static PatchChainIndex loadOrBuild(const QString &directory, const QString &gameDirectory, Platform platform);
+
+private:
+    struct PatchInfo {
+        QString name;
+        qint64 size = 0;
+        qint64 lastModified = 0;
+
+        bool operator==(const PatchInfo &other) const = default;
+    };
+
+    struct Entry {
+        uint64_t fileHash = 0;
+        uint32_t patch = 0; // index into m_patches
+        qint64 offset = 0;
+        char operation = 0;
+    };
+
+    static QList<PatchInfo> listPatches(const QString &directory);
+    static std::vector<Entry> indexPatch(const QString &path, uint32_t patch, const QString &gameDirectory, Platform platform);
+
+    /**
+     * @brief Hashes @p path the same way the index files do, with the folder and filename hashed separately.
+     */
+    static uint64_t hashPath(const QString &path);
+
+    QList<PatchInfo> m_patches;
+
+    // Sorted by file hash and then patch, so lookups are a binary search
+    std::vector<Entry> m_entries;
+};
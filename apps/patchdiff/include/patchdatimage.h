@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <limits>
+#include <map>
+#include <optional>
+
+/**
+ * @brief A sparse picture of what a patch writes into the dat files, in the order the patch writes it.
+ *
+ * Only the ranges the patch touches are tracked, and they point straight into the (memory-mapped) patch, so nothing is copied until it's read back.
+ * Later writes replace whatever earlier ones left in the same range, like they would when applying the patch for real.
+ * Building it isn't thread-safe, but reading from it afterwards is.
+ */
+class PatchDatImage
+{
+public:
+    /**
+     * @brief Places @p data at @p offset in @p path. The data has to outlive the image.
+     */
+    void write(const QString &path, uint64_t offset, QByteArrayView data);
+
+    /**
+     * @brief Fills @p size bytes at @p offset in @p path with zeroes.
+     */
+    void zero(const QString &path, uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Forgets everything written to @p path, because the patch deleted or replaced it.
+     */
+    void remove(const QString &path);
+
+    /**
+     * @brief Forgets everything written to files in @p folder.
+     */
+    void removeFolder(const QString &folder);
+
+    /**
+     * @brief Returns the bytes the patch wrote to @p path, starting at @p offset and up to the first range it didn't write.
+     *
+     * At most @p maximumSize bytes are copied, since a patch may write a whole dat in one contiguous run.
+     * Returns nullopt if nothing was written at @p offset.
+     */
+    std::optional<QByteArray> read(const QString &path, uint64_t offset, uint64_t maximumSize = std::numeric_limits<uint64_t>::max()) const;
+
+    /**
+     * @brief Normalizes paths from FileOperation chunks so they match the ones ZiPatchReader builds.
+     */
+    static QString normalizedPath(const QString &path);
+
+private:
+    struct Extent {
+        uint64_t end = 0;
+        const char *source = nullptr; // nullptr means zeroes
+    };
+
+    using Extents = std::map<uint64_t, Extent>;
+
+    /**
+     * @brief Makes room for [@p offset, @p end) by cutting down or removing any extents overlapping it.
+     */
+    static void clear(Extents &extents, uint64_t offset, uint64_t end);
+
+    QHash<QString, Extents> m_files;
+};
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "zipatchreader.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QSet>
+
+#include <atomic>
+
+/**
+ * @brief Decompresses every AddData block of a patch on the global thread pool.
+ *
+ * Blocks are identified by a hash of their decompressed contents, and identical payloads are only handed out once.
+ */
+class PatchExtractor
+{
+public:
+    struct Block {
+        QString indexPath;
+        ZiPatchReader::AddData addData;
+        QByteArray contentHash;
+
+        // Only valid for the duration of the callback, and empty for duplicates
+        QByteArrayView data;
+        bool duplicate = false;
+    };
+
+    /**
+     * @brief Called once per block, from whichever worker thread decompressed it.
+     */
+    using BlockCallback = std::function<void(const Block &block)>;
+
+    struct Statistics {
+        qsizetype blockCount = 0;
+        qsizetype uniqueBlockCount = 0;
+        qint64 compressedBytes = 0;
+        qint64 decompressedBytes = 0;
+
+        /**
+         * @brief Decompressed bytes per second so far.
+         */
+        double throughput = 0.0;
+    };
+
+    PatchExtractor(const QString &patchPath, Platform platform);
+    ~PatchExtractor();
+
+    /**
+     * @brief Starts walking the patch and decompressing every block on the global thread pool, calling @p callback for each one.
+     *
+     * Progress is reported per block, once the walk has found them all.
+     */
+    QFuture<void> extract(const BlockCallback &callback);
+
+    /**
+     * @brief Same as extract, but writes every unique block to @p directory, named after its content hash.
+     *
+     * Call writeManifest afterwards to record which block went where.
+     */
+    QFuture<void> extractToDirectory(const QString &directory);
+
+    /**
+     * @brief Writes a manifest.json to @p directory, listing the index path, file, offset and content hash of every block extracted so far.
+     */
+    bool writeManifest(const QString &directory) const;
+
+    Statistics statistics() const;
+
+private:
+    struct PendingBlock {
+        QString indexPath;
+        ZiPatchReader::AddData addData;
+    };
+
+    struct ManifestEntry {
+        QString indexPath;
+        ZiPatchReader::AddData addData;
+        QByteArray contentHash;
+    };
+
+    void extractBlock(const PendingBlock &pending, const BlockCallback &callback);
+
+    ZiPatchReader m_reader;
+    Platform m_platform;
+    QFuture<void> m_future;
+    QElapsedTimer m_timer;
+
+    mutable QMutex m_mutex;
+    QSet<QByteArray> m_seenHashes;
+    QList<ManifestEntry> m_manifest;
+
+    std::atomic<qsizetype> m_blockCount = 0;
+    std::atomic<qsizetype> m_uniqueBlockCount = 0;
+    std::atomic<qint64> m_compressedBytes = 0;
+    std::atomic<qint64> m_decompressedBytes = 0;
+};
@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patchdatimage.h"
+#include "zipatchreader.h"
+
+#include <QFuture>
+#include <QString>
+
+#include <limits>
+#include <memory>
+
+class FileCache;
+class HashDatabase;
+
+/**
+ * @brief Compares the files a patch writes against the ones currently installed.
+ *
+ * Files are compared by splitting both versions into content-defined chunks, so an insertion only shows up as one changed range instead of shifting the
+ * rest of the file. Some formats also get a summary of what changed inside them, like added Excel rows or different texture dimensions.
+ */
+class PatchFileDiffer
+{
+public:
+    enum class Status {
+        Unchanged,
+        Added,
+        Changed,
+        UnknownPath, // The hash isn't in the database, so there's nothing to compare against
+        Failed,
+    };
+
+    struct ByteRange {
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    struct FileDiff {
+        QString indexPath;
+        QString path;
+        uint32_t hash = 0;
+        Status status = Status::Failed;
+        qint64 oldSize = 0;
+        qint64 newSize = 0;
+
+        /**
+         * @brief Ranges of the new file that don't appear anywhere in the old one.
+         */
+        QList<ByteRange> changedRanges;
+
+        /**
+         * @brief A short, format-specific description of the change. Empty for formats we don't know about.
+         */
+        QString summary;
+    };
+
+    PatchFileDiffer(const QString &patchPath, const QString &gameDirectory, HashDatabase &database, Platform platform);
+    ~PatchFileDiffer();
+
+    /**
+     * @brief Starts comparing every file in the patch on the global thread pool. One result is reported per file.
+     */
+    QFuture<FileDiff> diff();
+
+    /**
+     * @brief Writes @p diffs as a JSON report to @p path.
+     */
+    static bool writeReport(const QList<FileDiff> &diffs, const QString &path);
+
+    static QString statusName(Status status);
+
+private:
+    struct PendingFile {
+        QString indexPath;
+        QString path;
+        uint32_t hash = 0;
+        QString datPath;
+        uint64_t offset = 0; // where the file starts in the dat
+        uint64_t maximumSize = std::numeric_limits<uint64_t>::max(); // up to the next file in the same dat
+    };
+
+    /**
+     * @brief Walks the patch, applying every write to m_image and figuring out which files start where.
+     */
+    QList<PendingFile> collectFiles();
+
+    FileDiff diffFile(const PendingFile &pending) const;
+
+    ZiPatchReader m_reader;
+    PatchDatImage m_image;
+    QString m_gameDirectory;
+    HashDatabase &m_database;
+    Platform m_platform;
+    std::unique_ptr<FileCache> m_cache;
+    QFuture<FileDiff> m_future;
+};
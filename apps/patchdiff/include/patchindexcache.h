@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDir>
+#include <QHash>
+#include <physis.hpp>
+
+#include <optional>
+
+/**
+ * @brief Resolves AddData block offsets to the files they belong to, using the game's index files.
+ *
+ * Each index file is parsed once per (main_id, sub_id) and kept around, since most AddData chunks in a patch point into the same few.
+ * This isn't thread-safe, use one per thread.
+ */
+class PatchIndexCache
+{
+public:
+    PatchIndexCache(Platform platform, const QString &gameDirectory);
+    ~PatchIndexCache();
+
+    PatchIndexCache(const PatchIndexCache &) = delete;
+    PatchIndexCache &operator=(const PatchIndexCache &) = delete;
+
+    /**
+     * @brief Looks up which file is at @p offset in the index at @p indexPath (relative to the game directory.)
+     *
+     * Returns nullopt if the index couldn't be read.
+     */
+    std::optional<Hash> hashFromOffset(const QString &indexPath, uint32_t mainId, uint32_t subId, uint32_t offset);
+
+    /**
+     * @brief Frees every parsed index. Needed when the patch target changes, as the same IDs may refer to a different index then.
+     */
+    void clear();
+
+private:
+    struct CachedIndex {
+        physis_IndexEntries entries{};
+        QHash<uint32_t, Hash> hashesByOffset;
+    };
+
+    Platform m_platform;
+    QDir m_gameDirectory;
+    QHash<std::pair<uint32_t, uint32_t>, CachedIndex> m_indices;
+};
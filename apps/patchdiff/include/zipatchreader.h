@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <physis.hpp>
+
+#include <functional>
+#include <variant>
+
+/**
+ * @brief Walks the chunks of a ZiPatch file without reading it into memory.
+ *
+ * Unlike physis_patch_parse, the file is memory-mapped and only the location of each block is recorded.
+ * Blocks are only touched (and paged in) when something actually asks for their data.
+ */
+class ZiPatchReader
+{
+public:
+    struct TargetInfo {
+        uint16_t platform = 0;
+        int16_t region = 0;
+    };
+
+    struct AddData {
+        uint16_t mainId = 0;
+        uint16_t subId = 0;
+        uint32_t fileId = 0;
+        uint64_t blockOffset = 0;
+        uint64_t blockSize = 0;
+        uint64_t blockDeleteSize = 0;
+        qint64 dataOffset = 0; // where the block starts in the patch file
+    };
+
+    /**
+     * @brief DeleteData and ExpandData, which both fill a range of a dat file with empty blocks.
+     */
+    struct EmptyData {
+        uint16_t mainId = 0;
+        uint16_t subId = 0;
+        uint32_t fileId = 0;
+        uint64_t blockOffset = 0;
+        uint64_t blockSize = 0;
+    };
+
+    struct FileOperation {
+        char operation = 0;
+        uint64_t fileOffset = 0;
+        uint64_t fileSize = 0;
+        uint16_t expansionId = 0;
+        QString path;
+    };
+
+    using Chunk = std::variant<TargetInfo, AddData, EmptyData, FileOperation>;
+
+    explicit ZiPatchReader(const QString &path);
+
+    /**
+     * @brief Maps the file and checks that it's actually a ZiPatch.
+     */
+    bool open();
+
+    /**
+     * @return The size of the patch file in bytes.
+     */
+    qint64 size() const;
+
+    /**
+     * @brief Calls @p callback for every chunk we understand, in order, along with the offset of the chunk.
+     *
+     * Stops early if @p callback returns false. Returns false if the patch is truncated or malformed.
+     */
+    bool forEachChunk(const std::function<bool(const Chunk &chunk, qint64 offset)> &callback) const;
+
+    /**
+     * @brief Returns the (still compressed) block data for @p addData. This points into the mapped file, so it's only valid as long as this reader is.
+     */
+    physis_Buffer blockData(const AddData &addData) const;
+
+    /**
+     * @brief Returns the path of the index file @p mainId and @p subId refer to, relative to the game directory.
+     */
+    static QString indexPath(const TargetInfo &targetInfo, uint16_t mainId, uint16_t subId);
+
+    /**
+     * @brief Returns the path of the dat file that AddData and EmptyData chunks write to, relative to the game directory.
+     */
+    static QString datPath(const TargetInfo &targetInfo, uint16_t mainId, uint16_t subId, uint32_t fileId);
+
+    /**
+     * @brief Returns the folder that a RemoveAll file operation for @p expansionId empties, relative to the game directory.
+     */
+    static QString expansionFolder(uint16_t expansionId);
+
+private:
+    static QString sqpackBasePath(const TargetInfo &targetInfo, uint16_t mainId, uint16_t subId);
+
+    bool readSqpk(qint64 offset, uint32_t size, const std::function<bool(const Chunk &chunk, qint64 offset)> &callback, bool &keepGoing) const;
+
+    QFile m_file;
+    uchar *m_data = nullptr;
+    qint64 m_size = 0;
+};
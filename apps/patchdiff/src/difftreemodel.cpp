@@ -3,6 +3,7 @@
 
 #include "difftreemodel.h"
 #include "filetypes.h"
+#include "patchindexcache.h"
 #include "physis.hpp"
 #include "settings.h"
 
@@ -10,6 +11,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QIcon>
+#include <QtConcurrent>
 
 void deleteTree(const TreeInformation *node)
 {
@@ -27,17 +29,25 @@ DiffTreeModel::DiffTreeModel(HashDatabase &database, physis_SqPackResource *data
 {
     rootItem = new TreeInformation();
     rootItem->type = TreeType::Root;
+
+    m_watcher = new QFutureWatcher<QList<PatchEntry>>(this);
+    connect(m_watcher, &QFutureWatcherBase::resultsReadyAt, this, [this](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            addEntries(m_watcher->resultAt(i));
+        }
+    });
+    connect(m_watcher, &QFutureWatcherBase::progressValueChanged, this, &DiffTreeModel::loadingProgress);
+    connect(m_watcher, &QFutureWatcherBase::finished, this, &DiffTreeModel::loadingFinished);
 }
 
 DiffTreeModel::~DiffTreeModel()
 {
+    m_watcher->cancel();
+    m_watcher->waitForFinished();
+
     deleteTree(rootItem);
     delete rootItem;
     rootItem = nullptr;
-
-    if (m_patch) {
-        physis_patch_free(&*m_patch);
-    }
 }
 
 int DiffTreeModel::rowCount(const QModelIndex &parent) const
@@ -164,6 +174,10 @@ QVariant DiffTreeModel::headerData(const int section, const Qt::Orientation orie
 
 void DiffTreeModel::openPatch(const QString &path)
 {
+    // Let any previous patch finish up first, it's still using the tree and mapping
+    m_watcher->cancel();
+    m_watcher->waitForFinished();
+
     beginResetModel();
 
     if (rootItem) {
@@ -175,83 +189,118 @@ void DiffTreeModel::openPatch(const QString &path)
     rootItem = new TreeInformation();
     rootItem->type = TreeType::Root;
 
-    m_patch = physis_patch_parse(path.toStdString().c_str());
-
-    SqpkTargetInfo targetInfo{};
-
-    for (uint32_t i = 0; i < m_patch->num_chunks; i++) {
-        const auto chunk = m_patch->chunks[i];
-        switch (chunk.chunk_type.tag) {
-        case physis_ZiPatchChunkType::Tag::Sqpk: {
-            const auto sqpk = chunk.chunk_type.sqpk._0;
-            switch (sqpk.operation.tag) {
-            case physis_ZiPatchSqpkOperation::Tag::AddData: {
-                const auto addData = sqpk.operation.add_data._0;
-
-                const auto indexPath = physis_patch_index_path(targetInfo, addData.main_id, addData.sub_id, 0); // don't need the file ID for index files
-                const auto baseItem = addIndexPath(QString::fromStdString(indexPath));
-                const auto indexGamePath = QDir(getGameDirectory()).absoluteFilePath(QString::fromStdString(indexPath));
-                physis_free_string(indexPath);
-
-                auto indexFile = physis_index_parse(gameData->platform, indexGamePath.toStdString().c_str());
-                if (indexFile.p_ptr) {
-                    auto hash = physis_index_hash_from_offset(indexFile, addData.block_offset);
-
-                    // Add parent folder
-                    if (const auto folderName = m_database.getFolder(hash.split_path.path); !folderName.isEmpty()) {
-                        addGamePath(baseItem, folderName);
-                    } else {
-                        auto pathItem = new TreeInformation();
-                        pathItem->parent = baseItem;
-                        pathItem->type = TreeType::Folder;
-                        pathItem->row = baseItem->children.size();
-                        pathItem->hash = hash.split_path.path;
-
-                        baseItem->children.push_back(pathItem);
-                        m_knownDirHashes[hash.split_path.path] = baseItem;
-                    }
-
-                    const auto completeHash =
-                        static_cast<uint32_t>(static_cast<uint64_t>(hash.split_path.path) << 32 | static_cast<uint64_t>(hash.split_path.name));
-
-                    const auto parentItem = m_knownDirHashes.value(hash.split_path.path);
-                    if (parentItem) {
-                        // Actual file item
-                        auto pathItem = new TreeInformation();
-                        pathItem->name = m_database.getFilename(completeHash);
-                        pathItem->parent = parentItem;
-                        pathItem->type = TreeType::File;
-                        pathItem->row = parentItem->children.size();
-                        pathItem->hash = completeHash; // FIXME: is this the correct/useful thing to show?
-                        pathItem->buffer.size = addData.block_data_size;
-                        pathItem->buffer.data = addData.block_data;
-
-                        parentItem->children.push_back(pathItem);
-                    } else {
-                        qWarning() << "Could not find parent item for" << hash.split_path.path << "item will not be added!";
-                    }
-
-                    physis_index_free(&indexFile);
-                } else {
-                    qWarning() << "Could not read index file" << indexGamePath;
-                }
-            } break;
-            case physis_ZiPatchSqpkOperation::Tag::FileOperation:
-                addIndexPath(QString::fromStdString(sqpk.operation.file_operation._0.path));
-                break;
-            case physis_ZiPatchSqpkOperation::Tag::TargetInfo:
-                targetInfo = sqpk.operation.target_info._0;
-                break;
-            case physis_ZiPatchSqpkOperation::Tag::Unknown:
-                break;
-            }
-        } break;
-        case physis_ZiPatchChunkType::Tag::Unknown:
-            break;
+    // These all pointed into the old tree
+    m_knownDirHashes.clear();
+    m_knownIndexHashes.clear();
+    m_indexItems.clear();
+
+    endResetModel();
+
+    m_reader = std::make_unique<ZiPatchReader>(path);
+    if (!m_reader->open()) {
+        m_reader.reset();
+        Q_EMIT loadingFinished();
+        return;
+    }
+
+    m_watcher->setFuture(QtConcurrent::run([this](QPromise<QList<PatchEntry>> &promise) {
+        readPatch(promise);
+    }));
+}
+
+void DiffTreeModel::readPatch(QPromise<QList<PatchEntry>> &promise)
+{
+    // Hand over entries in batches, so the view isn't flooded with signals
+    constexpr qsizetype batchSize = 1024;
+
+    promise.setProgressRange(0, 1000);
+
+    PatchIndexCache indexCache(gameData->platform, getGameDirectory());
+    const qint64 patchSize = m_reader->size();
+
+    ZiPatchReader::TargetInfo targetInfo{};
+    QList<PatchEntry> batch;
+
+    m_reader->forEachChunk([&](const ZiPatchReader::Chunk &chunk, const qint64 offset) {
+        if (promise.isCanceled()) {
+            return false;
         }
+
+        if (const auto addData = std::get_if<ZiPatchReader::AddData>(&chunk)) {
+            PatchEntry entry;
+            entry.indexPath = ZiPatchReader::indexPath(targetInfo, addData->mainId, addData->subId);
+            entry.buffer = m_reader->blockData(*addData);
+
+            entry.hash = indexCache.hashFromOffset(entry.indexPath, addData->mainId, addData->subId, static_cast<uint32_t>(addData->blockOffset));
+
+            batch.push_back(entry);
+        } else if (const auto fileOperation = std::get_if<ZiPatchReader::FileOperation>(&chunk)) {
+            batch.push_back(PatchEntry{.indexPath = fileOperation->path});
+        } else if (const auto newTargetInfo = std::get_if<ZiPatchReader::TargetInfo>(&chunk)) {
+            targetInfo = *newTargetInfo;
+
+            // The index paths depend on the target, so anything we parsed before may be the wrong file now
+            indexCache.clear();
+        }
+
+        if (batch.size() >= batchSize) {
+            promise.addResult(std::exchange(batch, {}));
+            promise.setProgressValue(static_cast<int>(offset * 1000 / patchSize));
+        }
+
+        return true;
+    });
+
+    if (!batch.isEmpty()) {
+        promise.addResult(batch);
     }
+    promise.setProgressValue(1000);
+}
 
-    endResetModel();
+void DiffTreeModel::addEntries(const QList<PatchEntry> &entries)
+{
+    for (const auto &entry : entries) {
+        auto baseItem = m_indexItems.value(entry.indexPath);
+        if (!baseItem) {
+            baseItem = addIndexPath(entry.indexPath);
+            m_indexItems.insert(entry.indexPath, baseItem);
+        }
+
+        // File operations only touch the index path
+        if (!entry.hash) {
+            continue;
+        }
+
+        const auto hash = *entry.hash;
+
+        // Add parent folder
+        if (const auto folderName = m_database.getFolder(hash.split_path.path); !folderName.isEmpty()) {
+            addGamePath(baseItem, folderName);
+        } else if (!m_knownDirHashes.contains(hash.split_path.path)) {
+            auto pathItem = new TreeInformation();
+            pathItem->type = TreeType::Folder;
+            pathItem->hash = hash.split_path.path;
+
+            appendChild(baseItem, pathItem);
+            m_knownDirHashes[hash.split_path.path] = pathItem;
+        }
+
+        const auto completeHash = static_cast<uint32_t>(static_cast<uint64_t>(hash.split_path.path) << 32 | static_cast<uint64_t>(hash.split_path.name));
+
+        const auto parentItem = m_knownDirHashes.value(hash.split_path.path);
+        if (parentItem) {
+            // Actual file item
+            auto pathItem = new TreeInformation();
+            pathItem->name = m_database.getFilename(completeHash);
+            pathItem->type = TreeType::File;
+            pathItem->hash = completeHash; // FIXME: is this the correct/useful thing to show?
+            pathItem->buffer = entry.buffer;
+
+            appendChild(parentItem, pathItem);
+        } else {
+            qWarning() << "Could not find parent item for" << hash.split_path.path << "item will not be added!";
+        }
+    }
 }
 
 void DiffTreeModel::addGamePath(TreeInformation *baseItem, const QString &string)
@@ -274,10 +323,8 @@ void DiffTreeModel::addGamePath(TreeInformation *baseItem, const QString &string
             auto folderItem = new TreeInformation();
             folderItem->name = children[i];
             folderItem->type = TreeType::Folder;
-            folderItem->parent = parentItem;
-            folderItem->row = parentItem->children.size();
             folderItem->hash = hash;
-            parentItem->children.push_back(folderItem);
+            appendChild(parentItem, folderItem);
             parentItem = folderItem;
             m_knownDirHashes.insert(folderItem->hash, folderItem);
         }
@@ -304,10 +351,8 @@ TreeInformation *DiffTreeModel::addIndexPath(const QString &string)
             auto folderItem = new TreeInformation();
             folderItem->name = children[i];
             folderItem->type = TreeType::Folder;
-            folderItem->parent = parentItem;
-            folderItem->row = parentItem->children.size();
             folderItem->hash = hash;
-            parentItem->children.push_back(folderItem);
+            appendChild(parentItem, folderItem);
             parentItem = folderItem;
             m_knownIndexHashes.insert(folderItem->hash, folderItem);
         }
@@ -316,4 +361,24 @@ TreeInformation *DiffTreeModel::addIndexPath(const QString &string)
     return parentItem;
 }
 
+void DiffTreeModel::appendChild(TreeInformation *parent, TreeInformation *child)
+{
+    const int row = static_cast<int>(parent->children.size());
+
+    beginInsertRows(indexForItem(parent), row, row);
+    child->parent = parent;
+    child->row = row;
+    parent->children.push_back(child);
+    endInsertRows();
+}
+
+QModelIndex DiffTreeModel::indexForItem(TreeInformation *item) const
+{
+    if (item == rootItem) {
+        return {};
+    }
+
+    return createIndex(item->row, 0, item);
+}
+
 #include "moc_difftreemodel.cpp"
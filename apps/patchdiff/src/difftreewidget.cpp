@@ -45,6 +45,12 @@ DiffTreeWidget::DiffTreeWidget(HashDatabase &database, physis_SqPackResource *da
     m_treeWidget->setModel(m_searchModel);
     layout->addWidget(m_treeWidget);
 
+    m_progressBar = new QProgressBar();
+    m_progressBar->setRange(0, 1000);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+    layout->addWidget(m_progressBar);
+
     connect(m_treeWidget, &QTreeView::activated, [this](const QModelIndex &item) {
         if (item.isValid()) {
             const auto buffer = m_searchModel->data(item, DiffTreeModel::CustomRoles::BufferRole).value<physis_Buffer>();
@@ -59,11 +65,15 @@ void DiffTreeWidget::refreshModel()
 {
     // TODO: this should really be handled by the proxy
     m_fileModel = new DiffTreeModel(m_database, m_data, this);
+    connect(m_fileModel, &DiffTreeModel::loadingProgress, m_progressBar, &QProgressBar::setValue);
+    connect(m_fileModel, &DiffTreeModel::loadingFinished, m_progressBar, &QProgressBar::hide);
     m_searchModel->setSourceModel(m_fileModel);
 }
 
 void DiffTreeWidget::openPatch(const QString &path) const
 {
+    m_progressBar->setValue(0);
+    m_progressBar->show();
     m_fileModel->openPatch(path);
 }
 
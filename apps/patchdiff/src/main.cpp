@@ -7,9 +7,11 @@
 
 #include "aboutdata.h"
 #include "mainwindow.h"
+#include "patchchainindex.h"
 #include "settings.h"
 
 #include <QCommandLineParser>
+#include <QTextStream>
 
 int main(int argc, char *argv[])
 {
@@ -26,13 +28,42 @@ int main(int argc, char *argv[])
     parser.addHelpOption();
     parser.addVersionOption();
 
+    const QCommandLineOption patchDirectoryOption(QStringLiteral("patch-directory"),
+                                                  i18n("Directory of patches to search with --last-touched"),
+                                                  QStringLiteral("directory"));
+    parser.addOption(patchDirectoryOption);
+
+    const QCommandLineOption lastTouchedOption(QStringLiteral("last-touched"),
+                                               i18n("Print which patches touched a file, oldest first, and exit"),
+                                               QStringLiteral("path"));
+    parser.addOption(lastTouchedOption);
+
     const QString gameDir = processCommandLine(parser, app);
     if (gameDir.isEmpty()) {
         return 0;
     }
 
     const std::string gameDirStd{gameDir.toStdString()};
-    const auto window = new MainWindow(physis_sqpack_initialize(gameDirStd.c_str()));
+    const auto resource = physis_sqpack_initialize(gameDirStd.c_str());
+
+    if (parser.isSet(lastTouchedOption)) {
+        if (!parser.isSet(patchDirectoryOption)) {
+            qWarning() << "--last-touched requires --patch-directory";
+            return 1;
+        }
+
+        const auto index = PatchChainIndex::loadOrBuild(parser.value(patchDirectoryOption), gameDir, resource.platform);
+        const auto touches = index.touches(parser.value(lastTouchedOption));
+
+        QTextStream out(stdout);
+        for (const auto &touch : touches) {
+            out << touch.patch << '\t' << touch.offset << '\n';
+        }
+
+        return touches.isEmpty() ? 1 : 0;
+    }
+
+    const auto window = new MainWindow(resource);
     window->show();
 
     return QApplication::exec();
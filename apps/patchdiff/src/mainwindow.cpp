@@ -14,11 +14,19 @@
 #include <KRecentFilesMenu>
 #include <QApplication>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QListWidget>
+#include <QLocale>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QTimer>
 #include <physis.hpp>
 
 #include "hexpart.h"
 #include "openinwidget.h"
+#include "patchchaindialog.h"
+#include "patchextractor.h"
+#include "patchfilediffer.h"
 #include "settings.h"
 
 #include <QHBoxLayout>
@@ -75,6 +83,23 @@ void MainWindow::setupActions()
         },
         actionCollection());
 
+    m_extractAction = new QAction(i18nc("@action:inmenu", "Extract All Blocks…"), this);
+    m_extractAction->setIcon(QIcon::fromTheme(QStringLiteral("archive-extract-symbolic")));
+    m_extractAction->setEnabled(false); // Enabled once a patch is open
+    connect(m_extractAction, &QAction::triggered, this, &MainWindow::extractBlocks);
+    actionCollection()->addAction(QStringLiteral("extract_blocks"), m_extractAction);
+
+    m_compareAction = new QAction(i18nc("@action:inmenu", "Compare With Installed Game…"), this);
+    m_compareAction->setIcon(QIcon::fromTheme(QStringLiteral("document-compare-symbolic")));
+    m_compareAction->setEnabled(false); // Enabled once a patch is open
+    connect(m_compareAction, &QAction::triggered, this, &MainWindow::compareWithGame);
+    actionCollection()->addAction(QStringLiteral("compare_installed"), m_compareAction);
+
+    const auto patchHistoryAction = new QAction(i18nc("@action:inmenu", "Patch History…"), this);
+    patchHistoryAction->setIcon(QIcon::fromTheme(QStringLiteral("view-history-symbolic")));
+    connect(patchHistoryAction, &QAction::triggered, this, &MainWindow::showPatchHistory);
+    actionCollection()->addAction(QStringLiteral("patch_history"), patchHistoryAction);
+
     m_recentFilesMenu = new KRecentFilesMenu(this);
     actionCollection()->addAction(QStringLiteral("open_recent"), m_recentFilesMenu->menuAction());
     connect(m_recentFilesMenu, &KRecentFilesMenu::urlTriggered, this, &MainWindow::openPatch);
@@ -91,8 +116,127 @@ void MainWindow::setupActions()
 
 void MainWindow::openPatch(const QUrl &url)
 {
-    m_diffTreeWidget->openPatch(url.toLocalFile());
-    setPlainCaption(url.toLocalFile());
+    m_patchPath = url.toLocalFile();
+    m_diffTreeWidget->openPatch(m_patchPath);
+    m_extractAction->setEnabled(true);
+    m_compareAction->setEnabled(true);
+    setPlainCaption(m_patchPath);
+}
+
+void MainWindow::extractBlocks()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, i18nc("@title:window", "Extract Blocks To"));
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    const auto extractor = std::make_shared<PatchExtractor>(m_patchPath, m_data.platform);
+
+    const auto progressDialog = new QProgressDialog(i18n("Extracting blocks…"), i18n("Cancel"), 0, 0, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+
+    // Show how fast it's going, since this can take a while for big patches
+    const auto statisticsTimer = new QTimer(progressDialog);
+    statisticsTimer->setInterval(250);
+    connect(statisticsTimer, &QTimer::timeout, progressDialog, [progressDialog, extractor] {
+        const auto statistics = extractor->statistics();
+        progressDialog->setLabelText(i18n("Extracting blocks… %1 unique of %2, %3/s",
+                                          statistics.uniqueBlockCount,
+                                          statistics.blockCount,
+                                          QLocale().formattedDataSize(static_cast<qint64>(statistics.throughput))));
+    });
+    statisticsTimer->start();
+
+    const auto watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcherBase::progressRangeChanged, progressDialog, &QProgressDialog::setRange);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcherBase::cancel);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, progressDialog, extractor, directory] {
+        progressDialog->deleteLater();
+        watcher->deleteLater();
+
+        if (watcher->isCanceled()) {
+            return;
+        }
+
+        extractor->writeManifest(directory);
+
+        const auto statistics = extractor->statistics();
+        QMessageBox::information(this,
+                                 i18nc("@title:window", "Extract All Blocks"),
+                                 i18n("Extracted %1 unique blocks out of %2 (%3 decompressed).",
+                                      statistics.uniqueBlockCount,
+                                      statistics.blockCount,
+                                      QLocale().formattedDataSize(statistics.decompressedBytes)));
+    });
+    watcher->setFuture(extractor->extractToDirectory(directory));
+}
+
+void MainWindow::compareWithGame()
+{
+    const QString reportPath =
+        QFileDialog::getSaveFileName(this, i18nc("@title:window", "Save Comparison Report"), QStringLiteral("report.json"), i18n("JSON files (*.json)"));
+    if (reportPath.isEmpty()) {
+        return;
+    }
+
+    const auto differ = std::make_shared<PatchFileDiffer>(m_patchPath, getGameDirectory(), m_database, m_data.platform);
+
+    const auto progressDialog = new QProgressDialog(i18n("Comparing files…"), i18n("Cancel"), 0, 0, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+
+    const auto watcher = new QFutureWatcher<PatchFileDiffer::FileDiff>(this);
+    connect(watcher, &QFutureWatcherBase::progressRangeChanged, progressDialog, &QProgressDialog::setRange);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcherBase::cancel);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, progressDialog, differ, reportPath] {
+        progressDialog->deleteLater();
+        watcher->deleteLater();
+
+        if (watcher->isCanceled()) {
+            return;
+        }
+
+        const auto diffs = watcher->future().results();
+        if (!PatchFileDiffer::writeReport(diffs, reportPath)) {
+            QMessageBox::warning(this, i18nc("@title:window", "Compare With Installed Game"), i18n("Failed to write the report to %1.", reportPath));
+            return;
+        }
+
+        const auto countStatus = [&diffs](const PatchFileDiffer::Status status) {
+            return std::count_if(diffs.cbegin(), diffs.cend(), [status](const PatchFileDiffer::FileDiff &fileDiff) {
+                return fileDiff.status == status;
+            });
+        };
+
+        QMessageBox::information(this,
+                                 i18nc("@title:window", "Compare With Installed Game"),
+                                 i18n("Compared %1 files: %2 changed, %3 added, %4 unchanged and %5 with unknown paths.",
+                                      diffs.size(),
+                                      countStatus(PatchFileDiffer::Status::Changed),
+                                      countStatus(PatchFileDiffer::Status::Added),
+                                      countStatus(PatchFileDiffer::Status::Unchanged),
+                                      countStatus(PatchFileDiffer::Status::UnknownPath)));
+    });
+    watcher->setFuture(differ->diff());
+}
+
+void MainWindow::showPatchHistory()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, i18nc("@title:window", "Select Patch Directory"));
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    const auto dialog = new PatchChainDialog(directory, getGameDirectory(), m_data.platform, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dialog, &PatchChainDialog::patchActivated, this, [this](const QString &path) {
+        openPatch(QUrl::fromLocalFile(path));
+        m_recentFilesMenu->addUrl(QUrl::fromLocalFile(path));
+    });
+    dialog->show();
 }
 
 #include "moc_mainwindow.cpp"
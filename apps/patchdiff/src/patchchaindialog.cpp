@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchchaindialog.h"
+
+#include <KLocalizedString>
+#include <QDir>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+enum TouchColumn {
+    PatchColumn,
+    OffsetColumn,
+    OperationColumn,
+};
+
+static QString operationName(const char operation)
+{
+    switch (operation) {
+    case 0:
+        return i18n("Add data");
+    case 'A':
+        return i18n("Add file");
+    case 'D':
+        return i18n("Delete file");
+    case 'R':
+        return i18n("Remove all");
+    case 'M':
+        return i18n("Make directory tree");
+    default:
+        return QString(QLatin1Char(operation));
+    }
+}
+
+PatchChainDialog::PatchChainDialog(const QString &directory, const QString &gameDirectory, const Platform platform, QWidget *parent)
+    : QDialog(parent)
+    , m_directory(directory)
+{
+    setWindowTitle(i18nc("@title:window", "Patch History"));
+    resize(640, 480);
+
+    const auto layout = new QVBoxLayout();
+    setLayout(layout);
+
+    m_pathEdit = new QLineEdit();
+    m_pathEdit->setPlaceholderText(i18n("Game path, e.g. exd/root.exl"));
+    m_pathEdit->setClearButtonEnabled(true);
+    connect(m_pathEdit, &QLineEdit::textChanged, this, &PatchChainDialog::updateResults);
+    layout->addWidget(m_pathEdit);
+
+    m_statusLabel = new QLabel();
+    layout->addWidget(m_statusLabel);
+
+    m_results = new QTreeWidget();
+    m_results->setRootIsDecorated(false);
+    m_results->setUniformRowHeights(true);
+    m_results->setHeaderLabels({
+        i18nc("@title:column", "Patch"),
+        i18nc("@title:column", "Offset"),
+        i18nc("@title:column", "Operation"),
+    });
+    m_results->header()->setStretchLastSection(false);
+    m_results->header()->setSectionResizeMode(PatchColumn, QHeaderView::Stretch);
+    connect(m_results, &QTreeWidget::itemActivated, this, [this](const QTreeWidgetItem *item) {
+        Q_EMIT patchActivated(QDir(m_directory).absoluteFilePath(item->text(PatchColumn)));
+    });
+    layout->addWidget(m_results);
+
+    m_watcher = new QFutureWatcher<PatchChainIndex>(this);
+    connect(m_watcher, &QFutureWatcherBase::finished, this, [this] {
+        m_index = m_watcher->result();
+        updateResults();
+    });
+    m_watcher->setFuture(QtConcurrent::run([directory, gameDirectory, platform] {
+        return PatchChainIndex::loadOrBuild(directory, gameDirectory, platform);
+    }));
+
+    updateResults();
+}
+
+PatchChainDialog::~PatchChainDialog()
+{
+    m_watcher->waitForFinished();
+}
+
+void PatchChainDialog::updateResults()
+{
+    m_results->clear();
+
+    if (!m_index) {
+        m_statusLabel->setText(i18n("Indexing patches…"));
+        return;
+    }
+
+    const QString path = m_pathEdit->text().trimmed();
+    if (path.isEmpty()) {
+        m_statusLabel->setText(i18np("1 patch indexed", "%1 patches indexed", m_index->patchCount()));
+        return;
+    }
+
+    const auto touches = m_index->touches(path);
+
+    // Most recent first, since that's usually what you're looking for
+    QList<QTreeWidgetItem *> items;
+    items.reserve(touches.size());
+    for (auto it = touches.crbegin(); it != touches.crend(); ++it) {
+        const auto item = new QTreeWidgetItem();
+        item->setText(PatchColumn, it->patch);
+        item->setText(OffsetColumn, QStringLiteral("0x%1").arg(it->offset, 0, 16));
+        item->setText(OperationColumn, operationName(it->operation));
+        items.push_back(item);
+    }
+    m_results->addTopLevelItems(items);
+
+    if (touches.isEmpty()) {
+        m_statusLabel->setText(i18n("No patch touched this file."));
+    } else {
+        m_statusLabel->setText(i18n("Last touched by %1", touches.last().patch));
+    }
+}
+
+#include "moc_patchchaindialog.cpp"
@@ -0,0 +1,254 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchchainindex.h"
+
+#include "patchindexcache.h"
+#include "settings.h"
+#include "zipatchreader.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <numeric>
+
+static constexpr quint32 indexMagic = 0x4E50434E; // NPCN
+static constexpr quint32 indexVersion = 1;
+
+QList<PatchChainIndex::Touch> PatchChainIndex::touches(const QString &path) const
+{
+    const uint64_t fileHash = hashPath(path);
+    const auto [begin, end] = std::equal_range(m_entries.cbegin(), m_entries.cend(), Entry{.fileHash = fileHash}, [](const Entry &a, const Entry &b) {
+        return a.fileHash < b.fileHash;
+    });
+
+    QList<Touch> touches;
+    for (auto it = begin; it != end; ++it) {
+        touches.push_back(Touch{
+            .patch = m_patches[it->patch].name,
+            .offset = it->offset,
+            .operation = it->operation,
+        });
+    }
+
+    return touches;
+}
+
+std::optional<PatchChainIndex::Touch> PatchChainIndex::lastTouch(const QString &path) const
+{
+    const auto allTouches = touches(path);
+    if (allTouches.isEmpty()) {
+        return std::nullopt;
+    }
+
+    return allTouches.last();
+}
+
+qsizetype PatchChainIndex::patchCount() const
+{
+    return m_patches.size();
+}
+
+QString PatchChainIndex::cachePath(const QString &directory, const QString &gameVersion)
+{
+    const QDir dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const QDir indexDir = dataDir.absoluteFilePath(QStringLiteral("patchchain"));
+
+    const QByteArray directoryHash = QCryptographicHash::hash(QDir(directory).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return indexDir.absoluteFilePath(QStringLiteral("%1-%2.idx").arg(QString::fromLatin1(directoryHash), gameVersion));
+}
+
+std::optional<PatchChainIndex> PatchChainIndex::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) {
+        return std::nullopt;
+    }
+
+    PatchChainIndex index;
+
+    quint32 patchCount = 0;
+    stream >> patchCount;
+    index.m_patches.resize(patchCount);
+    for (auto &patch : index.m_patches) {
+        stream >> patch.name >> patch.size >> patch.lastModified;
+    }
+
+    quint32 entryCount = 0;
+    stream >> entryCount;
+    index.m_entries.resize(entryCount);
+    for (auto &entry : index.m_entries) {
+        qint8 operation = 0;
+        stream >> entry.fileHash >> entry.patch >> entry.offset >> operation;
+        entry.operation = static_cast<char>(operation);
+
+        if (entry.patch >= patchCount) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Patch chain index at" << path << "is corrupt and will be rebuilt";
+        return std::nullopt;
+    }
+
+    return index;
+}
+
+bool PatchChainIndex::save(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write patch chain index to" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << indexMagic << indexVersion;
+
+    stream << static_cast<quint32>(m_patches.size());
+    for (const auto &patch : m_patches) {
+        stream << patch.name << patch.size << patch.lastModified;
+    }
+
+    stream << static_cast<quint32>(m_entries.size());
+    for (const auto &entry : m_entries) {
+        stream << entry.fileHash << entry.patch << entry.offset << static_cast<qint8>(entry.operation);
+    }
+
+    return file.commit();
+}
+
+PatchChainIndex PatchChainIndex::build(const QString &directory, const QString &gameDirectory, const Platform platform)
+{
+    PatchChainIndex index;
+    index.m_patches = listPatches(directory);
+
+    QList<uint32_t> patchIndices(index.m_patches.size());
+    std::iota(patchIndices.begin(), patchIndices.end(), 0);
+
+    const QDir patchDir(directory);
+    const QList<std::vector<Entry>> patchEntries =
+        QtConcurrent::blockingMapped(patchIndices, [&index, &patchDir, &gameDirectory, platform](const uint32_t patch) {
+            return indexPatch(patchDir.absoluteFilePath(index.m_patches[patch].name), patch, gameDirectory, platform);
+        });
+
+    for (const auto &entries : patchEntries) {
+        index.m_entries.insert(index.m_entries.end(), entries.cbegin(), entries.cend());
+    }
+
+    // Stable, so touches within the same patch stay in the order they happen
+    std::stable_sort(index.m_entries.begin(), index.m_entries.end(), [](const Entry &a, const Entry &b) {
+        return std::tie(a.fileHash, a.patch) < std::tie(b.fileHash, b.patch);
+    });
+
+    return index;
+}
+
+PatchChainIndex PatchChainIndex::loadOrBuild(const QString &directory, const QString &gameDirectory, const Platform platform)
+{
+    const QString gameVersion = getGameVersion(gameDirectory);
+    if (gameVersion.isEmpty()) {
+        return build(directory, gameDirectory, platform);
+    }
+
+    const QString path = cachePath(directory, gameVersion);
+    if (const auto cached = load(path)) {
+        // Patches may have been added, removed or re-downloaded since
+        if (cached->m_patches == listPatches(directory)) {
+            return *cached;
+        }
+    }
+
+    qInfo() << "Building patch chain index for" << directory;
+
+    const auto index = build(directory, gameDirectory, platform);
+    index.save(path);
+
+    return index;
+}
+
+QList<PatchChainIndex::PatchInfo> PatchChainIndex::listPatches(const QString &directory)
+{
+    QList<PatchInfo> patches;
+
+    const auto entries = QDir(directory).entryInfoList({QStringLiteral("*.patch")}, QDir::Files, QDir::Name);
+    for (const auto &entry : entries) {
+        patches.push_back(PatchInfo{
+            .name = entry.fileName(),
+            .size = entry.size(),
+            .lastModified = entry.lastModified().toMSecsSinceEpoch(),
+        });
+    }
+
+    return patches;
+}
+
+std::vector<PatchChainIndex::Entry>
+PatchChainIndex::indexPatch(const QString &path, const uint32_t patch, const QString &gameDirectory, const Platform platform)
+{
+    ZiPatchReader reader(path);
+    if (!reader.open()) {
+        return {};
+    }
+
+    PatchIndexCache indexCache(platform, gameDirectory);
+
+    std::vector<Entry> entries;
+    ZiPatchReader::TargetInfo targetInfo{};
+    reader.forEachChunk([&](const ZiPatchReader::Chunk &chunk, const qint64 offset) {
+        if (const auto addData = std::get_if<ZiPatchReader::AddData>(&chunk)) {
+            const QString indexPath = ZiPatchReader::indexPath(targetInfo, addData->mainId, addData->subId);
+            const auto hash = indexCache.hashFromOffset(indexPath, addData->mainId, addData->subId, static_cast<uint32_t>(addData->blockOffset));
+            if (hash) {
+                entries.push_back(Entry{
+                    .fileHash = static_cast<uint64_t>(hash->split_path.path) << 32 | static_cast<uint64_t>(hash->split_path.name),
+                    .patch = patch,
+                    .offset = offset,
+                });
+            }
+        } else if (const auto fileOperation = std::get_if<ZiPatchReader::FileOperation>(&chunk)) {
+            entries.push_back(Entry{
+                .fileHash = hashPath(fileOperation->path),
+                .patch = patch,
+                .offset = offset,
+                .operation = fileOperation->operation,
+            });
+        } else if (const auto newTargetInfo = std::get_if<ZiPatchReader::TargetInfo>(&chunk)) {
+            targetInfo = *newTargetInfo;
+            indexCache.clear();
+        }
+
+        return true;
+    });
+
+    return entries;
+}
+
+uint64_t PatchChainIndex::hashPath(const QString &path)
+{
+    const QString normalizedPath = path.toLower();
+    const qsizetype separator = normalizedPath.lastIndexOf(QLatin1Char('/'));
+
+    const std::string folder = normalizedPath.left(std::max<qsizetype>(separator, 0)).toStdString();
+    const std::string filename = normalizedPath.mid(separator + 1).toStdString();
+
+    return static_cast<uint64_t>(physis_generate_partial_hash(folder.c_str())) << 32 | static_cast<uint64_t>(physis_generate_partial_hash(filename.c_str()));
+}
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchdatimage.h"
+
+#include <QDir>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+void PatchDatImage::write(const QString &path, const uint64_t offset, const QByteArrayView data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    auto &extents = m_files[path];
+    const uint64_t end = offset + static_cast<uint64_t>(data.size());
+
+    clear(extents, offset, end);
+    extents.emplace(offset, Extent{.end = end, .source = data.data()});
+}
+
+void PatchDatImage::zero(const QString &path, const uint64_t offset, const uint64_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    auto &extents = m_files[path];
+
+    clear(extents, offset, offset + size);
+    extents.emplace(offset, Extent{.end = offset + size, .source = nullptr});
+}
+
+void PatchDatImage::remove(const QString &path)
+{
+    m_files.remove(path);
+}
+
+void PatchDatImage::removeFolder(const QString &folder)
+{
+    const QString prefix = folder + QLatin1Char('/');
+    m_files.removeIf([&prefix](const auto &file) {
+        return file.key().startsWith(prefix);
+    });
+}
+
+std::optional<QByteArray> PatchDatImage::read(const QString &path, const uint64_t offset, const uint64_t maximumSize) const
+{
+    const auto file = m_files.constFind(path);
+    if (file == m_files.cend()) {
+        return std::nullopt;
+    }
+
+    // Find the extent containing the offset, which is the last one starting at or before it
+    auto it = file->upper_bound(offset);
+    if (it == file->cbegin()) {
+        return std::nullopt;
+    }
+    --it;
+    if (it->second.end <= offset) {
+        return std::nullopt;
+    }
+
+    // Extents never overlap, so contiguous ones can be appended as-is
+    const uint64_t limit = maximumSize > std::numeric_limits<uint64_t>::max() - offset ? std::numeric_limits<uint64_t>::max() : offset + maximumSize;
+    uint64_t end = it->second.end;
+    for (auto next = std::next(it); end < limit && next != file->cend() && next->first == end; ++next) {
+        end = next->second.end;
+    }
+    end = std::min(end, limit);
+
+    QByteArray data(static_cast<qsizetype>(end - offset), Qt::Uninitialized);
+
+    uint64_t position = offset;
+    for (; position < end; ++it) {
+        const auto length = static_cast<qsizetype>(std::min(it->second.end, end) - position);
+        char *destination = data.data() + (position - offset);
+        if (it->second.source) {
+            memcpy(destination, it->second.source + (position - it->first), length);
+        } else {
+            memset(destination, 0, length);
+        }
+        position += length;
+    }
+
+    return data;
+}
+
+QString PatchDatImage::normalizedPath(const QString &path)
+{
+    QString normalized = QDir::cleanPath(QDir::fromNativeSeparators(path));
+    while (normalized.startsWith(QLatin1Char('/'))) {
+        normalized.remove(0, 1);
+    }
+
+    return normalized;
+}
+
+void PatchDatImage::clear(Extents &extents, const uint64_t offset, const uint64_t end)
+{
+    // Start from the extent before the range, in case it reaches into it
+    auto it = extents.lower_bound(offset);
+    if (it != extents.begin()) {
+        const auto previous = std::prev(it);
+        if (previous->second.end > offset) {
+            it = previous;
+        }
+    }
+
+    while (it != extents.end() && it->first < end) {
+        const uint64_t extentStart = it->first;
+        const Extent extent = it->second;
+        it = extents.erase(it);
+
+        // Keep whatever sticks out on either side
+        if (extentStart < offset) {
+            extents.emplace(extentStart, Extent{.end = offset, .source = extent.source});
+        }
+        if (extent.end > end) {
+            const char *source = extent.source ? extent.source + (end - extentStart) : nullptr;
+            it = extents.emplace(end, Extent{.end = extent.end, .source = source}).first;
+            break;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchextractor.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+
+PatchExtractor::PatchExtractor(const QString &patchPath, const Platform platform)
+    : m_reader(patchPath)
+    , m_platform(platform)
+{
+}
+
+PatchExtractor::~PatchExtractor()
+{
+    m_future.cancel();
+    m_future.waitForFinished();
+}
+
+QFuture<void> PatchExtractor::extract(const BlockCallback &callback)
+{
+    m_timer.start();
+    m_future = QtConcurrent::run([this, callback](QPromise<void> &promise) {
+        if (!m_reader.open()) {
+            return;
+        }
+
+        // Only the chunk headers are read here, but on a multi-GB patch that still pages in a lot
+        QList<PendingBlock> blocks;
+        ZiPatchReader::TargetInfo targetInfo{};
+        m_reader.forEachChunk([&promise, &blocks, &targetInfo](const ZiPatchReader::Chunk &chunk, qint64) {
+            if (const auto addData = std::get_if<ZiPatchReader::AddData>(&chunk)) {
+                blocks.push_back(PendingBlock{
+                    .indexPath = ZiPatchReader::indexPath(targetInfo, addData->mainId, addData->subId),
+                    .addData = *addData,
+                });
+            } else if (const auto newTargetInfo = std::get_if<ZiPatchReader::TargetInfo>(&chunk)) {
+                targetInfo = *newTargetInfo;
+            }
+            return !promise.isCanceled();
+        });
+
+        promise.setProgressRange(0, static_cast<int>(blocks.size()));
+
+        // Decompress in batches, so cancelling doesn't have to wait for the whole patch
+        const qsizetype batchSize = QThread::idealThreadCount() * 16;
+        for (qsizetype i = 0; i < blocks.size(); i += batchSize) {
+            if (promise.isCanceled()) {
+                return;
+            }
+
+            const auto batch = blocks.sliced(i, std::min(batchSize, blocks.size() - i));
+            QtConcurrent::blockingMap(batch, [this, &callback](const PendingBlock &pending) {
+                extractBlock(pending, callback);
+            });
+
+            promise.setProgressValue(static_cast<int>(i + batch.size()));
+        }
+    });
+
+    return m_future;
+}
+
+QFuture<void> PatchExtractor::extractToDirectory(const QString &directory)
+{
+    const QDir blockDir = QDir(directory).absoluteFilePath(QStringLiteral("blocks"));
+    QDir().mkpath(blockDir.absolutePath());
+
+    return extract([blockDir](const Block &block) {
+        if (block.duplicate) {
+            return;
+        }
+
+        QSaveFile file(blockDir.absoluteFilePath(QStringLiteral("%1.bin").arg(QString::fromLatin1(block.contentHash.toHex()))));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Failed to write block" << file.fileName();
+            return;
+        }
+        file.write(block.data.data(), block.data.size());
+        file.commit();
+    });
+}
+
+bool PatchExtractor::writeManifest(const QString &directory) const
+{
+    QJsonArray blocks;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const auto &entry : m_manifest) {
+            blocks.push_back(QJsonObject{
+                {QStringLiteral("index"), entry.indexPath},
+                {QStringLiteral("fileId"), static_cast<qint64>(entry.addData.fileId)},
+                {QStringLiteral("offset"), static_cast<qint64>(entry.addData.blockOffset)},
+                {QStringLiteral("hash"), QString::fromLatin1(entry.contentHash.toHex())},
+            });
+        }
+    }
+
+    QSaveFile file(QDir(directory).absoluteFilePath(QStringLiteral("manifest.json")));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write manifest to" << file.fileName();
+        return false;
+    }
+
+    file.write(QJsonDocument(QJsonObject{{QStringLiteral("blocks"), blocks}}).toJson());
+
+    return file.commit();
+}
+
+PatchExtractor::Statistics PatchExtractor::statistics() const
+{
+    Statistics statistics;
+    statistics.blockCount = m_blockCount;
+    statistics.uniqueBlockCount = m_uniqueBlockCount;
+    statistics.compressedBytes = m_compressedBytes;
+    statistics.decompressedBytes = m_decompressedBytes;
+
+    if (m_timer.isValid() && m_timer.elapsed() > 0) {
+        statistics.throughput = static_cast<double>(statistics.decompressedBytes) * 1000.0 / static_cast<double>(m_timer.elapsed());
+    }
+
+    return statistics;
+}
+
+void PatchExtractor::extractBlock(const PendingBlock &pending, const BlockCallback &callback)
+{
+    const auto compressed = m_reader.blockData(pending.addData);
+
+    auto decompressed = physis_sqpack_read_block(m_platform, compressed);
+    m_compressedBytes += compressed.size;
+    m_blockCount++;
+
+    if (!decompressed.data) {
+        qWarning() << "Failed to decompress block at" << pending.addData.blockOffset << "in" << pending.indexPath;
+        return;
+    }
+
+    const QByteArrayView data(decompressed.data, decompressed.size);
+    const QByteArray contentHash = QCryptographicHash::hash(data, QCryptographicHash::Blake2b_256);
+
+    bool duplicate = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        duplicate = m_seenHashes.contains(contentHash);
+        if (!duplicate) {
+            m_seenHashes.insert(contentHash);
+        }
+        m_manifest.push_back(ManifestEntry{
+            .indexPath = pending.indexPath,
+            .addData = pending.addData,
+            .contentHash = contentHash,
+        });
+    }
+
+    m_decompressedBytes += decompressed.size;
+    if (!duplicate) {
+        m_uniqueBlockCount++;
+    }
+
+    callback(Block{
+        .indexPath = pending.indexPath,
+        .addData = pending.addData,
+        .contentHash = contentHash,
+        .data = duplicate ? QByteArrayView() : data,
+        .duplicate = duplicate,
+    });
+
+    physis_free_file(&decompressed);
+}
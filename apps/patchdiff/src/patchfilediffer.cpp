@@ -0,0 +1,488 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchfilediffer.h"
+
+#include "filecache.h"
+#include "hashdatabase.h"
+#include "patchindexcache.h"
+
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <algorithm>
+#include <array>
+
+using ByteRange = PatchFileDiffer::ByteRange;
+
+// Content-defined chunking parameters, which gives chunks of about 2 KiB
+static constexpr qsizetype minimumChunkSize = 256;
+static constexpr qsizetype maximumChunkSize = 16 * 1024;
+static constexpr uint64_t chunkMask = 0x7FFull << 53;
+
+// Random values for the gear hash, generated with splitmix64 so they're the same every run
+static const std::array<uint64_t, 256> gearTable = [] {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0;
+    for (auto &value : table) {
+        state += 0x9E3779B97F4A7C15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+/**
+ * @brief Splits @p data wherever the rolling hash says so, so boundaries only depend on the bytes around them and not their position in the file.
+ */
+static QList<ByteRange> splitIntoChunks(const QByteArrayView data)
+{
+    QList<ByteRange> chunks;
+
+    qsizetype start = 0;
+    uint64_t hash = 0;
+    for (qsizetype i = 0; i < data.size(); i++) {
+        hash = (hash << 1) + gearTable[static_cast<uint8_t>(data[i])];
+
+        const qsizetype length = i - start + 1;
+        if ((length >= minimumChunkSize && (hash & chunkMask) == 0) || length >= maximumChunkSize) {
+            chunks.push_back(ByteRange{.offset = start, .length = length});
+            start = i + 1;
+            hash = 0;
+        }
+    }
+
+    if (start < data.size()) {
+        chunks.push_back(ByteRange{.offset = start, .length = data.size() - start});
+    }
+
+    return chunks;
+}
+
+/**
+ * @brief Returns the ranges of @p newData that don't exist anywhere in @p oldData, merging neighbouring ones.
+ */
+static QList<ByteRange> findChangedRanges(const QByteArrayView oldData, const QByteArrayView newData)
+{
+    QMultiHash<size_t, ByteRange> oldChunks;
+    for (const auto &chunk : splitIntoChunks(oldData)) {
+        oldChunks.insert(qHash(oldData.sliced(chunk.offset, chunk.length)), chunk);
+    }
+
+    QList<ByteRange> changedRanges;
+    for (const auto &chunk : splitIntoChunks(newData)) {
+        const auto content = newData.sliced(chunk.offset, chunk.length);
+
+        // Hashes can collide, so make sure the contents actually match
+        const auto [begin, end] = oldChunks.equal_range(qHash(content));
+        const bool found = std::any_of(begin, end, [&oldData, &content](const ByteRange &oldChunk) {
+            return oldChunk.length == content.size() && memcmp(oldData.data() + oldChunk.offset, content.data(), content.size()) == 0;
+        });
+        if (found) {
+            continue;
+        }
+
+        if (!changedRanges.isEmpty() && changedRanges.last().offset + changedRanges.last().length == chunk.offset) {
+            changedRanges.last().length += chunk.length;
+        } else {
+            changedRanges.push_back(chunk);
+        }
+    }
+
+    return changedRanges;
+}
+
+static physis_Buffer toBuffer(const QByteArrayView data)
+{
+    physis_Buffer buffer{};
+    buffer.size = static_cast<uint32_t>(data.size());
+    buffer.data = reinterpret_cast<uint8_t *>(const_cast<char *>(data.data()));
+
+    return buffer;
+}
+
+/**
+ * @brief Returns the contents of every row in an EXD page, keyed by row ID.
+ */
+static QHash<uint32_t, QByteArrayView> readExdRows(const QByteArrayView data)
+{
+    // EXDF header, the row offset table comes right after it
+    constexpr qsizetype headerSize = 0x20;
+    // Rows start with their size and subrow count
+    constexpr qsizetype rowHeaderSize = 6;
+
+    QHash<uint32_t, QByteArrayView> rows;
+    if (data.size() < headerSize || data.first(4) != QByteArrayView("EXDF")) {
+        return rows;
+    }
+
+    const qsizetype offsetTableSize = qFromBigEndian<quint32>(data.data() + 8);
+    if (headerSize + offsetTableSize > data.size()) {
+        return rows;
+    }
+
+    for (qsizetype entry = headerSize; entry + 8 <= headerSize + offsetTableSize; entry += 8) {
+        const auto rowId = qFromBigEndian<quint32>(data.data() + entry);
+        const qsizetype offset = qFromBigEndian<quint32>(data.data() + entry + 4);
+        if (offset + rowHeaderSize > data.size()) {
+            continue;
+        }
+
+        const qsizetype rowSize = qFromBigEndian<quint32>(data.data() + offset);
+        if (offset + rowHeaderSize + rowSize > data.size()) {
+            continue;
+        }
+
+        rows.insert(rowId, data.sliced(offset + rowHeaderSize, rowSize));
+    }
+
+    return rows;
+}
+
+static QString summarizeExd(const QByteArrayView oldData, const QByteArrayView newData)
+{
+    const auto oldRows = readExdRows(oldData);
+    const auto newRows = readExdRows(newData);
+
+    int added = 0;
+    int changed = 0;
+    for (const auto [rowId, row] : newRows.asKeyValueRange()) {
+        const auto oldRow = oldRows.constFind(rowId);
+        if (oldRow == oldRows.cend()) {
+            added++;
+        } else if (*oldRow != row) {
+            changed++;
+        }
+    }
+
+    const auto removed = std::count_if(oldRows.keyBegin(), oldRows.keyEnd(), [&newRows](const uint32_t rowId) {
+        return !newRows.contains(rowId);
+    });
+
+    return QStringLiteral("%1 -> %2 rows (%3 added, %4 removed, %5 changed)").arg(oldRows.size()).arg(newRows.size()).arg(added).arg(removed).arg(changed);
+}
+
+static QString describeModel(const Platform platform, const QByteArrayView data)
+{
+    auto mdl = physis_mdl_parse(platform, toBuffer(data));
+    if (mdl.p_ptr == nullptr) {
+        return {};
+    }
+
+    QString description;
+    if (mdl.num_lod > 0) {
+        const auto &lod = mdl.lods[0];
+
+        uint32_t vertices = 0;
+        uint32_t indices = 0;
+        for (uint32_t i = 0; i < lod.num_parts; i++) {
+            vertices += lod.parts[i].num_vertices;
+            indices += lod.parts[i].num_indices;
+        }
+
+        description = QStringLiteral("%1 LODs, %2 parts, %3 vertices and %4 indices in LOD0").arg(mdl.num_lod).arg(lod.num_parts).arg(vertices).arg(indices);
+    }
+
+    physis_mdl_free(&mdl);
+
+    return description;
+}
+
+static QString describeTexture(const Platform platform, const QByteArrayView data)
+{
+    auto tex = physis_texture_parse(platform, toBuffer(data));
+    if (tex.width == 0 && tex.height == 0) {
+        return {};
+    }
+
+    const auto description = QStringLiteral("%1x%2x%3, %4 mips").arg(tex.width).arg(tex.height).arg(tex.depth).arg(tex.mip_levels);
+
+    physis_tex_free(&tex);
+
+    return description;
+}
+
+/**
+ * @brief Describes what changed inside the file, based on its extension.
+ */
+static QString summarize(const Platform platform, const QString &path, const QByteArrayView oldData, const QByteArrayView newData)
+{
+    const QString suffix = QFileInfo(path).suffix();
+    if (suffix == QStringLiteral("exd")) {
+        return summarizeExd(oldData, newData);
+    }
+
+    std::function<QString(Platform, QByteArrayView)> describe;
+    if (suffix == QStringLiteral("mdl")) {
+        describe = describeModel;
+    } else if (suffix == QStringLiteral("tex")) {
+        describe = describeTexture;
+    } else {
+        return {};
+    }
+
+    const QString newDescription = describe(platform, newData);
+    if (oldData.isEmpty()) {
+        return newDescription;
+    }
+
+    const QString oldDescription = describe(platform, oldData);
+    if (oldDescription == newDescription) {
+        return oldDescription;
+    }
+
+    return QStringLiteral("%1 -> %2").arg(oldDescription, newDescription);
+}
+
+PatchFileDiffer::PatchFileDiffer(const QString &patchPath, const QString &gameDirectory, HashDatabase &database, const Platform platform)
+    : m_reader(patchPath)
+    , m_gameDirectory(gameDirectory)
+    , m_database(database)
+    , m_platform(platform)
+{
+    // Our own cache, since every file is only read once and then evicted
+    const std::string gameDirectoryStd = gameDirectory.toStdString();
+    m_cache = std::make_unique<FileCache>(physis_sqpack_initialize(gameDirectoryStd.c_str()));
+}
+
+PatchFileDiffer::~PatchFileDiffer()
+{
+    m_future.cancel();
+    m_future.waitForFinished();
+}
+
+QFuture<PatchFileDiffer::FileDiff> PatchFileDiffer::diff()
+{
+    m_future = QtConcurrent::run([this](QPromise<FileDiff> &promise) {
+        if (!m_reader.open()) {
+            return;
+        }
+
+        const auto files = collectFiles();
+        promise.setProgressRange(0, static_cast<int>(files.size()));
+
+        // Compare in batches, so cancelling doesn't have to wait for the whole patch
+        const qsizetype batchSize = QThread::idealThreadCount() * 16;
+        for (qsizetype i = 0; i < files.size(); i += batchSize) {
+            if (promise.isCanceled()) {
+                return;
+            }
+
+            const auto diffs = QtConcurrent::blockingMapped(files.sliced(i, std::min(batchSize, files.size() - i)), [this](const PendingFile &pending) {
+                return diffFile(pending);
+            });
+            for (const auto &fileDiff : diffs) {
+                promise.addResult(fileDiff);
+            }
+
+            promise.setProgressValue(static_cast<int>(i + diffs.size()));
+        }
+    });
+
+    return m_future;
+}
+
+bool PatchFileDiffer::writeReport(const QList<FileDiff> &diffs, const QString &path)
+{
+    QJsonArray files;
+    for (const auto &fileDiff : diffs) {
+        QJsonArray changedRanges;
+        for (const auto &range : fileDiff.changedRanges) {
+            changedRanges.push_back(QJsonArray{range.offset, range.length});
+        }
+
+        files.push_back(QJsonObject{
+            {QStringLiteral("index"), fileDiff.indexPath},
+            {QStringLiteral("path"), fileDiff.path},
+            {QStringLiteral("hash"), static_cast<qint64>(fileDiff.hash)},
+            {QStringLiteral("status"), statusName(fileDiff.status)},
+            {QStringLiteral("oldSize"), fileDiff.oldSize},
+            {QStringLiteral("newSize"), fileDiff.newSize},
+            {QStringLiteral("changedRanges"), changedRanges},
+            {QStringLiteral("summary"), fileDiff.summary},
+        });
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write diff report to" << path;
+        return false;
+    }
+
+    file.write(QJsonDocument(QJsonObject{{QStringLiteral("files"), files}}).toJson());
+
+    return file.commit();
+}
+
+QString PatchFileDiffer::statusName(const Status status)
+{
+    switch (status) {
+    case Status::Unchanged:
+        return QStringLiteral("unchanged");
+    case Status::Added:
+        return QStringLiteral("added");
+    case Status::Changed:
+        return QStringLiteral("changed");
+    case Status::UnknownPath:
+        return QStringLiteral("unknown-path");
+    case Status::Failed:
+        return QStringLiteral("failed");
+    }
+
+    Q_UNREACHABLE();
+}
+
+QList<PatchFileDiffer::PendingFile> PatchFileDiffer::collectFiles()
+{
+    PatchIndexCache indexCache(m_platform, m_gameDirectory);
+
+    QList<PendingFile> files;
+    QHash<std::pair<QString, uint64_t>, qsizetype> fileIndices;
+
+    ZiPatchReader::TargetInfo targetInfo{};
+    m_reader.forEachChunk([&](const ZiPatchReader::Chunk &chunk, qint64) {
+        if (const auto addData = std::get_if<ZiPatchReader::AddData>(&chunk)) {
+            const QString datPath = ZiPatchReader::datPath(targetInfo, addData->mainId, addData->subId, addData->fileId);
+
+            // Blocks are raw writes into the dat, so a file can span several of them and they only make sense once the whole patch is applied
+            const auto data = m_reader.blockData(*addData);
+            m_image.write(datPath, addData->blockOffset, QByteArrayView(data.data, data.size));
+            m_image.zero(datPath, addData->blockOffset + data.size, addData->blockDeleteSize);
+
+            PendingFile pending;
+            pending.indexPath = ZiPatchReader::indexPath(targetInfo, addData->mainId, addData->subId);
+            pending.datPath = datPath;
+            pending.offset = addData->blockOffset;
+
+            // Only blocks at the start of a file are in the index, the rest continue one
+            const auto hash = indexCache.hashFromOffset(pending.indexPath, addData->mainId, addData->subId, static_cast<uint32_t>(addData->blockOffset));
+            if (!hash) {
+                return true;
+            }
+
+            const auto fullHash = static_cast<uint64_t>(hash->split_path.path) << 32 | static_cast<uint64_t>(hash->split_path.name);
+            pending.hash = static_cast<uint32_t>(fullHash);
+
+            const QString folder = m_database.getFolder(hash->split_path.path);
+            const QString filename = m_database.getFilename(pending.hash);
+            if (!folder.isEmpty() && !filename.isEmpty()) {
+                pending.path = folder + QStringLiteral("/") + filename;
+            }
+
+            // If a patch writes the same file more than once, only the last write matters
+            const auto key = std::pair{pending.indexPath, fullHash};
+            if (const auto existing = fileIndices.constFind(key); existing != fileIndices.cend()) {
+                files[*existing] = pending;
+            } else {
+                fileIndices.insert(key, files.size());
+                files.push_back(pending);
+            }
+        } else if (const auto emptyData = std::get_if<ZiPatchReader::EmptyData>(&chunk)) {
+            const QString datPath = ZiPatchReader::datPath(targetInfo, emptyData->mainId, emptyData->subId, emptyData->fileId);
+            m_image.zero(datPath, emptyData->blockOffset, emptyData->blockSize);
+        } else if (const auto fileOperation = std::get_if<ZiPatchReader::FileOperation>(&chunk)) {
+            // Only these throw away what's already in a file, AddFile past the start appends to it
+            switch (fileOperation->operation) {
+            case 'A':
+                if (fileOperation->fileOffset == 0) {
+                    m_image.remove(PatchDatImage::normalizedPath(fileOperation->path));
+                }
+                break;
+            case 'D':
+                m_image.remove(PatchDatImage::normalizedPath(fileOperation->path));
+                break;
+            case 'R':
+                m_image.removeFolder(ZiPatchReader::expansionFolder(fileOperation->expansionId));
+                break;
+            default:
+                break;
+            }
+        } else if (const auto newTargetInfo = std::get_if<ZiPatchReader::TargetInfo>(&chunk)) {
+            targetInfo = *newTargetInfo;
+            indexCache.clear();
+        }
+
+        return true;
+    });
+
+    // Files are packed one after another, so the next one written to the same dat is where this one ends at the latest
+    QHash<QString, std::vector<uint64_t>> offsetsByDat;
+    for (const auto &pending : std::as_const(files)) {
+        offsetsByDat[pending.datPath].push_back(pending.offset);
+    }
+    for (auto &offsets : offsetsByDat) {
+        std::ranges::sort(offsets);
+    }
+
+    for (auto &pending : files) {
+        const auto &offsets = offsetsByDat[pending.datPath];
+        if (const auto next = std::ranges::upper_bound(offsets, pending.offset); next != offsets.cend()) {
+            pending.maximumSize = *next - pending.offset;
+        }
+    }
+
+    return files;
+}
+
+PatchFileDiffer::FileDiff PatchFileDiffer::diffFile(const PendingFile &pending) const
+{
+    FileDiff fileDiff;
+    fileDiff.indexPath = pending.indexPath;
+    fileDiff.path = pending.path;
+    fileDiff.hash = pending.hash;
+
+    // Nothing is left at the offset if the patch deleted or replaced the dat afterwards
+    const auto entry = m_image.read(pending.datPath, pending.offset, pending.maximumSize);
+    if (!entry) {
+        qWarning() << "Nothing written at" << pending.offset << "in" << pending.datPath;
+        return fileDiff;
+    }
+
+    auto decompressed = physis_sqpack_read_block(m_platform, toBuffer(*entry));
+    if (!decompressed.data) {
+        qWarning() << "Failed to decompress file at" << pending.offset << "in" << pending.datPath;
+        return fileDiff;
+    }
+
+    const QByteArrayView newData(decompressed.data, decompressed.size);
+    fileDiff.newSize = newData.size();
+
+    if (pending.path.isEmpty()) {
+        fileDiff.status = Status::UnknownPath;
+    } else {
+        // Copy it out and evict right away, there's no reason to keep the old version of the whole patch in memory
+        QByteArray oldData;
+        if (m_cache->exists(pending.path)) {
+            const auto &buffer = m_cache->read(pending.path);
+            oldData = QByteArray(reinterpret_cast<const char *>(buffer.data), buffer.size);
+            m_cache->evict(pending.path);
+        }
+
+        fileDiff.oldSize = oldData.size();
+        if (oldData.isEmpty()) {
+            fileDiff.status = Status::Added;
+            fileDiff.changedRanges = {ByteRange{.offset = 0, .length = newData.size()}};
+        } else if (oldData == newData) {
+            fileDiff.status = Status::Unchanged;
+        } else {
+            fileDiff.status = Status::Changed;
+            fileDiff.changedRanges = findChangedRanges(oldData, newData);
+        }
+
+        if (fileDiff.status != Status::Unchanged) {
+            fileDiff.summary = summarize(m_platform, pending.path, oldData, newData);
+        }
+    }
+
+    physis_free_file(&decompressed);
+
+    return fileDiff;
+}
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patchindexcache.h"
+
+#include <QDebug>
+
+PatchIndexCache::PatchIndexCache(const Platform platform, const QString &gameDirectory)
+    : m_platform(platform)
+    , m_gameDirectory(gameDirectory)
+{
+}
+
+PatchIndexCache::~PatchIndexCache()
+{
+    clear();
+}
+
+std::optional<Hash> PatchIndexCache::hashFromOffset(const QString &indexPath, const uint32_t mainId, const uint32_t subId, const uint32_t offset)
+{
+    const auto key = std::pair{mainId, subId};
+
+    auto it = m_indices.find(key);
+    if (it == m_indices.end()) {
+        const std::string indexGamePath = m_gameDirectory.absoluteFilePath(indexPath).toStdString();
+
+        CachedIndex index;
+        index.entries = physis_index_parse(m_platform, indexGamePath.c_str());
+        if (!index.entries.p_ptr) {
+            qWarning() << "Could not read index file" << indexGamePath;
+        }
+
+        it = m_indices.insert(key, index);
+    }
+
+    if (!it->entries.p_ptr) {
+        return std::nullopt;
+    }
+
+    // Looking up an offset searches the whole index, so remember what we already found
+    if (const auto hash = it->hashesByOffset.constFind(offset); hash != it->hashesByOffset.cend()) {
+        return *hash;
+    }
+
+    const auto hash = physis_index_hash_from_offset(it->entries, offset);
+    it->hashesByOffset.insert(offset, hash);
+
+    return hash;
+}
+
+void PatchIndexCache::clear()
+{
+    for (auto &index : m_indices) {
+        if (index.entries.p_ptr) {
+            physis_index_free(&index.entries);
+        }
+    }
+    m_indices.clear();
+}
@@ -0,0 +1,233 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "zipatchreader.h"
+
+#include <QDebug>
+#include <QtEndian>
+
+static constexpr uchar patchMagic[] = {0x91, 'Z', 'I', 'P', 'A', 'T', 'C', 'H', 0x0D, 0x0A, 0x1A, 0x0A};
+
+// Every chunk is its size, a four letter type, the payload and then a CRC32
+static constexpr qint64 chunkHeaderSize = 8;
+static constexpr qint64 chunkFooterSize = 4;
+
+// SQPK chunks start with their own (redundant) size and a command letter
+static constexpr qint64 sqpkHeaderSize = 5;
+
+// Block sizes and offsets are stored in units of 128 bytes
+static constexpr int blockShift = 7;
+
+ZiPatchReader::ZiPatchReader(const QString &path)
+    : m_file(path)
+{
+}
+
+bool ZiPatchReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open patch" << m_file.fileName();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < static_cast<qint64>(sizeof(patchMagic))) {
+        qWarning() << m_file.fileName() << "is too small to be a patch";
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "Failed to map patch" << m_file.fileName();
+        return false;
+    }
+
+    if (memcmp(m_data, patchMagic, sizeof(patchMagic)) != 0) {
+        qWarning() << m_file.fileName() << "is not a ZiPatch file";
+        m_file.unmap(m_data);
+        m_data = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+qint64 ZiPatchReader::size() const
+{
+    return m_size;
+}
+
+bool ZiPatchReader::forEachChunk(const std::function<bool(const Chunk &chunk, qint64 offset)> &callback) const
+{
+    if (!m_data) {
+        return false;
+    }
+
+    qint64 offset = sizeof(patchMagic);
+    while (offset + chunkHeaderSize <= m_size) {
+        const auto size = qFromBigEndian<quint32>(m_data + offset);
+        const auto type = QByteArrayView(reinterpret_cast<const char *>(m_data + offset + 4), 4);
+        const qint64 payload = offset + chunkHeaderSize;
+
+        if (payload + size + chunkFooterSize > m_size) {
+            qWarning() << "Chunk at" << offset << "goes past the end of the patch, it's probably truncated";
+            return false;
+        }
+
+        if (type == QByteArrayView("EOF_")) {
+            return true;
+        }
+
+        if (type == QByteArrayView("SQPK")) {
+            bool keepGoing = true;
+            if (!readSqpk(payload, size, callback, keepGoing)) {
+                qWarning() << "Malformed SQPK chunk at" << offset;
+                return false;
+            }
+            if (!keepGoing) {
+                return true;
+            }
+        }
+
+        offset = payload + size + chunkFooterSize;
+    }
+
+    return true;
+}
+
+physis_Buffer ZiPatchReader::blockData(const AddData &addData) const
+{
+    physis_Buffer buffer{};
+    buffer.size = static_cast<uint32_t>(addData.blockSize);
+    buffer.data = m_data + addData.dataOffset;
+
+    return buffer;
+}
+
+QString ZiPatchReader::indexPath(const TargetInfo &targetInfo, const uint16_t mainId, const uint16_t subId)
+{
+    return sqpackBasePath(targetInfo, mainId, subId) + QStringLiteral(".index");
+}
+
+QString ZiPatchReader::datPath(const TargetInfo &targetInfo, const uint16_t mainId, const uint16_t subId, const uint32_t fileId)
+{
+    return sqpackBasePath(targetInfo, mainId, subId) + QStringLiteral(".dat%1").arg(fileId);
+}
+
+QString ZiPatchReader::expansionFolder(const uint16_t expansionId)
+{
+    return expansionId == 0 ? QStringLiteral("sqpack/ffxiv") : QStringLiteral("sqpack/ex%1").arg(expansionId);
+}
+
+QString ZiPatchReader::sqpackBasePath(const TargetInfo &targetInfo, const uint16_t mainId, const uint16_t subId)
+{
+    QString platform;
+    switch (targetInfo.platform) {
+    case 1:
+        platform = QStringLiteral("ps3");
+        break;
+    case 2:
+        platform = QStringLiteral("ps4");
+        break;
+    default:
+        platform = QStringLiteral("win32");
+        break;
+    }
+
+    return QStringLiteral("%1/%2%3.%4")
+        .arg(expansionFolder(subId >> 8))
+        .arg(mainId, 2, 16, QLatin1Char('0'))
+        .arg(subId, 4, 16, QLatin1Char('0'))
+        .arg(platform);
+}
+
+bool ZiPatchReader::readSqpk(const qint64 offset,
+                             const uint32_t size,
+                             const std::function<bool(const Chunk &chunk, qint64 offset)> &callback,
+                             bool &keepGoing) const
+{
+    if (size < sqpkHeaderSize) {
+        return false;
+    }
+
+    const uchar *data = m_data + offset;
+    const char command = static_cast<char>(data[4]);
+
+    switch (command) {
+    case 'A': {
+        // 3 bytes of padding after the command
+        if (size < 28) {
+            return false;
+        }
+
+        AddData addData;
+        addData.mainId = qFromBigEndian<quint16>(data + 8);
+        addData.subId = qFromBigEndian<quint16>(data + 10);
+        addData.fileId = qFromBigEndian<quint32>(data + 12);
+        addData.blockOffset = static_cast<uint64_t>(qFromBigEndian<quint32>(data + 16)) << blockShift;
+        addData.blockSize = static_cast<uint64_t>(qFromBigEndian<quint32>(data + 20)) << blockShift;
+        addData.blockDeleteSize = static_cast<uint64_t>(qFromBigEndian<quint32>(data + 24)) << blockShift;
+        addData.dataOffset = offset + 28;
+
+        if (28 + addData.blockSize > size) {
+            return false;
+        }
+
+        keepGoing = callback(addData, offset);
+    } break;
+    case 'D':
+    case 'E': {
+        // Same layout as AddData, minus the data
+        if (size < 28) {
+            return false;
+        }
+
+        EmptyData emptyData;
+        emptyData.mainId = qFromBigEndian<quint16>(data + 8);
+        emptyData.subId = qFromBigEndian<quint16>(data + 10);
+        emptyData.fileId = qFromBigEndian<quint32>(data + 12);
+        emptyData.blockOffset = static_cast<uint64_t>(qFromBigEndian<quint32>(data + 16)) << blockShift;
+        emptyData.blockSize = static_cast<uint64_t>(qFromBigEndian<quint32>(data + 20)) << blockShift;
+
+        keepGoing = callback(emptyData, offset);
+    } break;
+    case 'F': {
+        if (size < 32) {
+            return false;
+        }
+
+        FileOperation fileOperation;
+        fileOperation.operation = static_cast<char>(data[5]);
+        fileOperation.fileOffset = qFromBigEndian<quint64>(data + 8);
+        fileOperation.fileSize = qFromBigEndian<quint64>(data + 16);
+        const auto pathLength = qFromBigEndian<quint32>(data + 24);
+        fileOperation.expansionId = qFromBigEndian<quint16>(data + 28);
+
+        if (32 + static_cast<qint64>(pathLength) > size) {
+            return false;
+        }
+
+        // The path is null-terminated within its fixed length
+        const auto path = reinterpret_cast<const char *>(data + 32);
+        fileOperation.path = QString::fromLatin1(path, static_cast<qsizetype>(strnlen(path, pathLength)));
+
+        keepGoing = callback(fileOperation, offset);
+    } break;
+    case 'T': {
+        if (size < 12) {
+            return false;
+        }
+
+        TargetInfo targetInfo;
+        targetInfo.platform = qFromBigEndian<quint16>(data + 8);
+        targetInfo.region = qFromBigEndian<qint16>(data + 10);
+
+        keepGoing = callback(targetInfo, offset);
+    } break;
+    default:
+        // Nothing else affects which files are touched
+        break;
+    }
+
+    return true;
+}
@@ -23,6 +23,11 @@ public:
     [[nodiscard]] physis_Buffer &read(const QString &path);
     [[nodiscard]] physis_ExcelSheet readExcelSheet(const QString &name, const physis_EXH *exh, Language language) const;
 
+    /**
+     * @brief Frees the cached contents of @p path, if any. Buffers previously returned by read() for this path become invalid.
+     */
+    void evict(const QString &path);
+
     [[nodiscard]] Platform platform() const;
 
     // NOTE: This is only a porting aid, and usages should eventually be removed!
@@ -26,6 +26,13 @@ NOVUSCOMMON_EXPORT QString getGameUUID();
 NOVUSCOMMON_EXPORT bool addNewInstall();
 NOVUSCOMMON_EXPORT Language getLanguage();
 
+/**
+ * @brief Returns the version of the game installed at @p gameDirectory, suitable for keying on-disk caches.
+ *
+ * Returns an empty string if the version file can't be read.
+ */
+NOVUSCOMMON_EXPORT QString getGameVersion(const QString &gameDirectory);
+
 struct GameMod {
     QUuid uuid;
     QString path;
@@ -96,6 +96,17 @@ physis_ExcelSheet FileCache::readExcelSheet(const QString &name, const physis_EX
     return physis_custom_read_excel_sheet(&m_customResource, name.toStdString().c_str(), exh, language);
 }
 
+void FileCache::evict(const QString &path)
+{
+    QMutexLocker locker(&m_bufferMutex);
+
+    const QString normalizedPath = path.toLower();
+    if (m_cachedBuffers.contains(normalizedPath)) {
+        physis_free_file(&m_cachedBuffers[normalizedPath]);
+        m_cachedBuffers.remove(normalizedPath);
+    }
+}
+
 Platform FileCache::platform() const
 {
     return m_data.platform;
@@ -12,6 +12,7 @@
 #include <KSharedConfig>
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QFile>
 #include <QFileDialog>
 #include <QMessageBox>
 
@@ -124,6 +125,16 @@ Language getLanguage()
     Q_UNREACHABLE(); // if you hit this, you did something wrong
 }
 
+QString getGameVersion(const QString &gameDirectory)
+{
+    QFile versionFile(QDir(gameDirectory).absoluteFilePath(QStringLiteral("ffxivgame.ver")));
+    if (!versionFile.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    return QString::fromLatin1(versionFile.readAll()).trimmed();
+}
+
 QList<GameMod> getGameMods()
 {
     KConfig config(QStringLiteral("novusrc"));
@@ -85,12 +85,11 @@ QVariant ExcelModel::data(const QModelIndex &index, const int role) const
     }
     if (role == Qt::FontRole) {
         const auto mappedIndex = m_sortedColumnIndices.indexOf(index.column());
-        const auto columnName = m_schema.nameForColumn(mappedIndex);
 
         QFont font;
 
         // Make font bold to make the display field more obvious.
-        font.setBold(m_schema.isDisplayField(columnName));
+        font.setBold(m_schema.displayFieldIndex() == mappedIndex);
 
         // Show an underline to make the resolved column more obvious.
         const auto resolvedSheet = data(index, ResolvedSheetRole).toString();
@@ -476,10 +475,8 @@ std::optional<QVariant> ExcelModel::contextFor(const uint32_t row, const uint32_
 {
     // NOTE: This assumes the condition switch exists as a top-level field i guess
 
-    const auto contextName = m_schema.neededContextForColumn(column);
-    if (!contextName.isEmpty()) {
-        const uint32_t column = m_schema.indexForName(contextName).value();
-        const uint32_t unsortedColumn = m_sortedColumnIndices[column];
+    if (const auto contextColumn = m_schema.neededContextIndexForColumn(column)) {
+        const uint32_t unsortedColumn = m_sortedColumnIndices[*contextColumn];
         return data(index(row, unsortedColumn), Qt::DisplayRole);
     }
     return {};
@@ -53,6 +53,11 @@ public:
      */
     int displayFieldColumn() const;
 
+    /**
+     * @brief Returns a nice edit display for a given column data.
+     */
+    static QVariant editForData(const physis_Field &data);
+
 Q_SIGNALS:
     void modified();
 
@@ -67,11 +72,6 @@ private:
      */
     static QVariant displayForData(const physis_Field &data);
 
-    /**
-     * @brief Returns a nice edit display for a given column data.
-     */
-    static QVariant editForData(const physis_Field &data);
-
     /**
      * @brief Returns the column data for a given QModelIndex.
      */
@@ -0,0 +1,385 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "excelreferenceindex.h"
+
+#include "excelmodel.h"
+#include "filecache.h"
+#include "schema.h"
+#include "settings.h"
+#include "utility.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <numeric>
+
+// Bump this whenever the on-disk format changes, so old indices get rebuilt
+static constexpr quint32 indexMagic = 0x4E524546; // NREF
+static constexpr quint32 indexVersion = 1;
+
+namespace
+{
+/**
+ * @brief Links are numeric, so it doesn't matter which language we read as long as it has data.
+ */
+Language languageForLinks(const physis_EXH &exh)
+{
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        if (exh.languages[i] == getLanguage()) {
+            return exh.languages[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        if (exh.languages[i] != Language::None) {
+            return exh.languages[i];
+        }
+    }
+
+    return Language::None;
+}
+}
+
+QString ExcelReferenceIndex::Reference::rowQuery() const
+{
+    if (sheetHasSubrows) {
+        return QStringLiteral("%1.%2").arg(row).arg(subrow);
+    }
+    return QString::number(row);
+}
+
+QList<ExcelReferenceIndex::Reference> ExcelReferenceIndex::referencesTo(const QString &sheet, const uint32_t row) const
+{
+    const auto sheetIndex = m_sheetIndices.constFind(sheet);
+    if (sheetIndex == m_sheetIndices.cend()) {
+        return {};
+    }
+
+    const auto matches = std::ranges::equal_range(m_entries, std::pair{*sheetIndex, row}, {}, [](const Entry &entry) {
+        return std::pair{entry.targetSheet, entry.targetRow};
+    });
+
+    QList<Reference> references;
+    references.reserve(std::ranges::distance(matches));
+    for (const auto &entry : matches) {
+        references.push_back(Reference{
+            .sheet = m_sheets[entry.sourceSheet],
+            .row = entry.sourceRow,
+            .subrow = entry.sourceSubrow,
+            .column = m_columns[entry.column],
+            .sheetHasSubrows = m_sheetHasSubrows[entry.sourceSheet],
+        });
+    }
+
+    return references;
+}
+
+QString ExcelReferenceIndex::cachePath(const QString &gameVersion)
+{
+    const QDir dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const QDir indexDir = dataDir.absoluteFilePath(QStringLiteral("referenceindex"));
+
+    return indexDir.absoluteFilePath(QStringLiteral("%1-%2.idx").arg(gameVersion, schemaFingerprint()));
+}
+
+std::optional<ExcelReferenceIndex> ExcelReferenceIndex::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) {
+        return std::nullopt;
+    }
+
+    ExcelReferenceIndex index;
+    stream >> index.m_sheets >> index.m_sheetHasSubrows >> index.m_columns;
+
+    quint32 entryCount = 0;
+    stream >> entryCount;
+    index.m_entries.resize(entryCount);
+    for (auto &entry : index.m_entries) {
+        stream >> entry.targetSheet >> entry.targetRow >> entry.sourceSheet >> entry.sourceRow >> entry.sourceSubrow >> entry.column;
+    }
+
+    if (stream.status() != QDataStream::Ok || index.m_sheetHasSubrows.size() != index.m_sheets.size()) {
+        qWarning() << "Reference index at" << path << "is corrupt and will be rebuilt";
+        return std::nullopt;
+    }
+
+    for (qsizetype i = 0; i < index.m_sheets.size(); i++) {
+        index.m_sheetIndices.insert(index.m_sheets[i], static_cast<uint32_t>(i));
+    }
+
+    return index;
+}
+
+bool ExcelReferenceIndex::save(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write reference index to" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << indexMagic << indexVersion;
+    stream << m_sheets << m_sheetHasSubrows << m_columns;
+
+    stream << static_cast<quint32>(m_entries.size());
+    for (const auto &entry : m_entries) {
+        stream << entry.targetSheet << entry.targetRow << entry.sourceSheet << entry.sourceRow << entry.sourceSubrow << entry.column;
+    }
+
+    return file.commit();
+}
+
+ExcelReferenceIndex ExcelReferenceIndex::build(FileCache &cache, const QStringList &names)
+{
+    ExcelReferenceIndex index;
+    index.m_sheets = names;
+    for (qsizetype i = 0; i < names.size(); i++) {
+        index.m_sheetIndices.insert(names[i], static_cast<uint32_t>(i));
+    }
+
+    // Links can point to any sheet, so we need to know every sheet's rows before resolving any of them
+    const QList<RowRanges> ranges = QtConcurrent::blockingMapped(names, [&cache](const QString &name) {
+        return readRowRanges(cache, name);
+    });
+
+    QList<uint32_t> sheetIndices(names.size());
+    std::iota(sheetIndices.begin(), sheetIndices.end(), 0);
+
+    const QList<SheetLinks> sheetLinks = QtConcurrent::blockingMapped(sheetIndices, [&cache, &names, &index, &ranges](const uint32_t sheetIndex) {
+        return indexSheet(cache, names[sheetIndex], sheetIndex, index.m_sheetIndices, ranges);
+    });
+
+    QHash<QString, uint32_t> columnIndices;
+    for (const auto &links : sheetLinks) {
+        index.m_sheetHasSubrows.push_back(links.hasSubrows);
+
+        // Column names are shared between sheets, so only store each one once
+        QList<uint32_t> columnMapping;
+        for (const auto &column : links.columns) {
+            if (!columnIndices.contains(column)) {
+                columnIndices.insert(column, static_cast<uint32_t>(index.m_columns.size()));
+                index.m_columns.push_back(column);
+            }
+            columnMapping.push_back(columnIndices[column]);
+        }
+
+        for (auto entry : links.entries) {
+            entry.column = columnMapping[entry.column];
+            index.m_entries.push_back(entry);
+        }
+    }
+
+    std::ranges::sort(index.m_entries, {}, [](const Entry &entry) {
+        return std::tie(entry.targetSheet, entry.targetRow, entry.sourceSheet, entry.sourceRow, entry.sourceSubrow, entry.column);
+    });
+
+    return index;
+}
+
+ExcelReferenceIndex ExcelReferenceIndex::loadOrBuild(FileCache &cache, const QStringList &names, const QString &gameVersion)
+{
+    if (gameVersion.isEmpty()) {
+        return build(cache, names);
+    }
+
+    const QString path = cachePath(gameVersion);
+    if (const auto cached = load(path)) {
+        // Make sure the sheet list didn't change underneath us (e.g. mods adding new sheets)
+        if (cached->m_sheets == names) {
+            return *cached;
+        }
+    }
+
+    qInfo() << "Building reference index for" << gameVersion;
+
+    const auto index = build(cache, names);
+    index.save(path);
+
+    return index;
+}
+
+ExcelReferenceIndex::RowRanges ExcelReferenceIndex::readRowRanges(FileCache &cache, const QString &name)
+{
+    const auto path = QStringLiteral("exd/%1.exh").arg(name.toLower());
+    if (!cache.exists(path)) {
+        return {};
+    }
+
+    auto exh = physis_exh_parse(cache.platform(), cache.read(path));
+    if (!exh.p_ptr) {
+        return {};
+    }
+
+    RowRanges ranges;
+    for (uint32_t i = 0; i < exh.page_count; i++) {
+        ranges.push_back({exh.pages[i].start_id, exh.pages[i].start_id + exh.pages[i].row_count});
+    }
+
+    physis_exh_free(&exh);
+
+    return ranges;
+}
+
+ExcelReferenceIndex::SheetLinks ExcelReferenceIndex::indexSheet(FileCache &cache,
+                                                                const QString &name,
+                                                                const uint32_t sheetIndex,
+                                                                const QHash<QString, uint32_t> &sheetIndices,
+                                                                const QList<RowRanges> &ranges)
+{
+    SheetLinks links;
+
+    const Schema schema(Schema::getPath(name));
+
+    const auto exhPath = QStringLiteral("exd/%1.exh").arg(name.toLower());
+    if (!cache.exists(exhPath)) {
+        return links;
+    }
+
+    auto exh = physis_exh_parse(cache.platform(), cache.read(exhPath));
+    if (!exh.p_ptr) {
+        qWarning() << "Failed to parse" << exhPath;
+        return links;
+    }
+
+    // Schema indices are sorted by column offset
+    QList<std::pair<uint16_t, uint32_t>> sortedColumns;
+    for (uint32_t i = 0; i < exh.column_count; i++) {
+        sortedColumns.push_back({exh.column_definitions[i].offset, i});
+    }
+    std::ranges::sort(sortedColumns);
+
+    struct LinkColumn {
+        uint32_t schemaIndex = 0;
+        uint32_t column = 0;
+        std::optional<uint32_t> contextColumn;
+        uint32_t nameIndex = 0; // index into links.columns
+    };
+
+    QList<LinkColumn> linkColumns;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(sortedColumns.size()); i++) {
+        LinkColumn linkColumn{.schemaIndex = i, .column = sortedColumns[i].second};
+
+        // NOTE: This assumes the condition switch exists as a top-level field, like ExcelModel does
+        if (!schema.neededContextForColumn(i).isEmpty()) {
+            const auto contextIndex = schema.neededContextIndexForColumn(i);
+            if (!contextIndex || *contextIndex >= sortedColumns.size()) {
+                continue;
+            }
+            linkColumn.contextColumn = sortedColumns[*contextIndex].second;
+        } else if (schema.targetSheetsForColumn(i, std::nullopt).isEmpty()) {
+            continue;
+        }
+
+        linkColumn.nameIndex = static_cast<uint32_t>(links.columns.size());
+        links.columns.push_back(schema.nameForColumn(i));
+        linkColumns.push_back(linkColumn);
+    }
+
+    if (!linkColumns.isEmpty()) {
+        const auto language = languageForLinks(exh);
+
+        auto sheet = cache.readExcelSheet(name, &exh, language);
+        if (sheet.p_ptr) {
+            for (uint32_t i = 0; i < sheet.page_count; i++) {
+                const auto &page = sheet.pages[i];
+                for (uint32_t j = 0; j < page.entry_count; j++) {
+                    const auto &entry = page.entries[j];
+                    if (entry.subrow_count > 1) {
+                        links.hasSubrows = true;
+                    }
+
+                    for (uint32_t k = 0; k < entry.subrow_count; k++) {
+                        const auto &columns = entry.subrows[k].columns;
+
+                        for (const auto &linkColumn : std::as_const(linkColumns)) {
+                            bool ok = false;
+                            const qlonglong targetRow = ExcelModel::editForData(columns[linkColumn.column]).toLongLong(&ok);
+                            if (!ok || targetRow <= 0 || targetRow > std::numeric_limits<uint32_t>::max()) {
+                                continue;
+                            }
+
+                            std::optional<QVariant> context;
+                            if (linkColumn.contextColumn) {
+                                context = ExcelModel::editForData(columns[*linkColumn.contextColumn]);
+                            }
+
+                            // Same as resolving the link forward, the first sheet that has the row wins
+                            for (const auto &targetSheet : schema.targetSheetsForColumn(linkColumn.schemaIndex, context)) {
+                                const auto targetIndex = sheetIndices.constFind(targetSheet);
+                                if (targetIndex == sheetIndices.cend()) {
+                                    continue;
+                                }
+
+                                const bool hasRow = std::ranges::any_of(ranges[*targetIndex], [targetRow](const auto &range) {
+                                    return targetRow >= range.first && targetRow < range.second;
+                                });
+                                if (hasRow) {
+                                    links.entries.push_back(Entry{
+                                        .targetSheet = *targetIndex,
+                                        .targetRow = static_cast<uint32_t>(targetRow),
+                                        .sourceSheet = sheetIndex,
+                                        .sourceRow = entry.row_id,
+                                        .sourceSubrow = static_cast<uint16_t>(k),
+                                        .column = linkColumn.nameIndex,
+                                    });
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            physis_sqpack_free_excel_sheet(&sheet);
+        }
+
+        const std::string nameStd = name.toStdString();
+        for (uint32_t i = 0; i < exh.page_count; i++) {
+            QString pagePath = fromCString(physis_exd_calculate_filename(nameStd.c_str(), &exh, language, i)).toLower();
+            if (!pagePath.startsWith(QStringLiteral("exd/"))) {
+                pagePath.prepend(QStringLiteral("exd/"));
+            }
+            cache.evict(pagePath);
+        }
+    }
+
+    physis_exh_free(&exh);
+    cache.evict(exhPath);
+
+    return links;
+}
+
+QString ExcelReferenceIndex::schemaFingerprint()
+{
+    const QDir dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const QDir schemaDir = dataDir.absoluteFilePath(QStringLiteral("schema"));
+
+    QStringList files;
+    QDirIterator it(schemaDir.absolutePath(), {QStringLiteral("*.yml")}, QDir::Files);
+    while (it.hasNext()) {
+        const auto info = it.nextFileInfo();
+        files.push_back(QStringLiteral("%1:%2:%3").arg(info.fileName()).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch()));
+    }
+    files.sort();
+
+    return QString::fromLatin1(QCryptographicHash::hash(files.join(QLatin1Char('\n')).toUtf8(), QCryptographicHash::Sha1).toHex().left(16));
+}
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QHash>
+#include <QStringList>
+
+#include <optional>
+
+class FileCache;
+
+/**
+ * @brief Answers "what links to this row?" for every sheet, based on the link columns in the schema.
+ *
+ * Links are resolved the same way ExcelModel does it, including condition switches, and the first target sheet containing the row wins.
+ * Links to row 0 aren't indexed, as that's what almost every sheet uses for "nothing".
+ */
+class ExcelReferenceIndex
+{
+public:
+    struct Reference {
+        QString sheet;
+        uint32_t row = 0;
+        uint16_t subrow = 0;
+        QString column;
+        bool sheetHasSubrows = false;
+
+        /**
+         * @return The row query understood by EXDPart::goToRow.
+         */
+        QString rowQuery() const;
+    };
+
+    /**
+     * @brief Returns every row that links to @p row in @p sheet.
+     */
+    QList<Reference> referencesTo(const QString &sheet, uint32_t row) const;
+
+    /**
+     * @return The path where the index for this game version and the currently installed schema is stored.
+     */
+    static QString cachePath(const QString &gameVersion);
+
+    static std::optional<ExcelReferenceIndex> load(const QString &path);
+    bool save(const QString &path) const;
+
+    /**
+     * @brief Reads every sheet in @p names and collects their links, in parallel.
+     *
+     * @note Sheet data is evicted from @p cache once it's been read, so don't pass a cache that's being used elsewhere.
+     */
+    static ExcelReferenceIndex build(FileCache &cache, const QStringList &names);
+
+    /**
+     * @brief Loads the cached index for @p gameVersion, or builds and caches a new one if needed.
+     */
+    static ExcelReferenceIndex loadOrBuild(FileCache &cache, const QStringList &names, const QString &gameVersion);
+
+private:
+    struct Entry {
+        uint32_t targetSheet = 0;
+        uint32_t targetRow = 0;
+        uint32_t sourceSheet = 0;
+        uint32_t sourceRow = 0;
+        uint16_t sourceSubrow = 0;
+        uint32_t column = 0; // index into m_columns
+    };
+
+    /**
+     * @brief The links found in a single sheet. Sheets are referred to by their index in the list of names.
+     */
+    struct SheetLinks {
+        bool hasSubrows = false;
+        QStringList columns;
+        std::vector<Entry> entries;
+    };
+
+    /**
+     * @brief The row ranges of a sheet's pages, used to figure out which target sheet a link resolves to.
+     */
+    using RowRanges = QList<std::pair<uint32_t, uint32_t>>;
+
+    static RowRanges readRowRanges(FileCache &cache, const QString &name);
+    static SheetLinks
+    indexSheet(FileCache &cache, const QString &name, uint32_t sheetIndex, const QHash<QString, uint32_t> &sheetIndices, const QList<RowRanges> &ranges);
+
+    /**
+     * @return A hash over the installed schema files, so the index is rebuilt when they change.
+     */
+    static QString schemaFingerprint();
+
+    QStringList m_sheets;
+    QHash<QString, uint32_t> m_sheetIndices;
+    QList<bool> m_sheetHasSubrows;
+    QStringList m_columns;
+
+    // Sorted by target, so lookups are a binary search
+    std::vector<Entry> m_entries;
+};
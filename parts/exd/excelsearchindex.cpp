@@ -0,0 +1,478 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "excelsearchindex.h"
+
+#include "filecache.h"
+#include "settings.h"
+#include "utility.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QtConcurrent>
+
+// Bump this whenever the shard format or tokenizer changes, so old shards get rebuilt
+static constexpr quint32 shardMagic = 0x4E534958; // NSIX
+static constexpr quint32 shardVersion = 2;
+
+bool ExcelSearchIndex::postingLess(const Posting &a, const Posting &b)
+{
+    return std::tie(a.sheet, a.location.row, a.location.subrow, a.location.column, a.location.language)
+        < std::tie(b.sheet, b.location.row, b.location.subrow, b.location.column, b.location.language);
+}
+
+QString ExcelSearchIndex::Hit::rowQuery() const
+{
+    if (sheetHasSubrows) {
+        return QStringLiteral("%1.%2").arg(row).arg(subrow);
+    }
+    return QString::number(row);
+}
+
+ExcelSearchIndex::ExcelSearchIndex(const QString &gameDirectory, const bool indexNumbers)
+    : m_gameDirectory(gameDirectory)
+    , m_indexNumbers(indexNumbers)
+{
+    // Without a version, there's no way to tell when the index goes stale, so don't store it at all
+    if (const QString gameVersion = getGameVersion(gameDirectory); !gameVersion.isEmpty()) {
+        const QDir dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        const QDir indexDir = dataDir.absoluteFilePath(QStringLiteral("searchindex/%1").arg(gameVersion));
+
+        m_cacheDirectory = indexDir.absoluteFilePath(m_indexNumbers ? QStringLiteral("numbers") : QStringLiteral("text"));
+    }
+}
+
+ExcelSearchIndex::~ExcelSearchIndex()
+{
+    m_buildFuture.cancel();
+    m_buildFuture.waitForFinished();
+}
+
+QFuture<void> ExcelSearchIndex::build()
+{
+    // Only build once
+    if (m_cache) {
+        return m_buildFuture;
+    }
+
+    const std::string gameDirectoryStd = m_gameDirectory.toStdString();
+    m_cache = std::make_unique<FileCache>(physis_sqpack_initialize(gameDirectoryStd.c_str()));
+
+    const auto names = physis_sqpack_get_all_sheet_names(&m_cache->resource());
+    for (uint32_t i = 0; i < names.name_count; i++) {
+        m_sheetNames.push_back(QString::fromStdString(names.names[i]));
+    }
+    physis_sqpack_free_all_sheet_names(names);
+
+    if (!m_cacheDirectory.isEmpty()) {
+        QDir().mkpath(m_cacheDirectory);
+    }
+
+    m_buildFuture = QtConcurrent::map(m_sheetNames, [this](const QString &name) {
+        auto shard = loadShard(name);
+        if (!shard) {
+            shard = indexSheet(name);
+            saveShard(name, *shard);
+        }
+
+        mergeShard(name, *shard);
+    });
+
+    return m_buildFuture;
+}
+
+QList<ExcelSearchIndex::Hit> ExcelSearchIndex::search(const QString &query, const qsizetype limit) const
+{
+    QReadLocker locker(&m_lock);
+
+    std::vector<Posting> results;
+
+    const auto tokens = tokenize(query);
+    if (!tokens.isEmpty()) {
+        std::vector<const std::vector<Posting> *> lists;
+        for (const auto &token : tokens) {
+            const auto it = m_tokens.constFind(token);
+            if (it == m_tokens.cend()) {
+                // Every word has to match, so one missing word means no results
+                lists.clear();
+                break;
+            }
+            lists.push_back(&*it);
+        }
+
+        if (!lists.empty()) {
+            // Start with the rarest word, to keep the intersections small
+            std::ranges::sort(lists, {}, &std::vector<Posting>::size);
+
+            // The lists are already sorted, so a cursor into each of the others only ever moves forward
+            std::vector<std::vector<Posting>::const_iterator> cursors;
+            cursors.reserve(lists.size() - 1);
+            for (size_t i = 1; i < lists.size(); i++) {
+                cursors.push_back(lists[i]->cbegin());
+            }
+
+            for (const auto &posting : *lists[0]) {
+                if (static_cast<qsizetype>(results.size()) >= limit) {
+                    break;
+                }
+
+                bool matches = true;
+                for (size_t i = 0; i < cursors.size() && matches; i++) {
+                    cursors[i] = std::lower_bound(cursors[i], lists[i + 1]->cend(), posting, postingLess);
+                    matches = cursors[i] != lists[i + 1]->cend() && !postingLess(posting, *cursors[i]);
+                }
+
+                if (matches) {
+                    results.push_back(posting);
+                }
+            }
+        }
+    }
+
+    if (m_indexNumbers) {
+        bool ok = false;
+        const qint64 value = query.trimmed().toLongLong(&ok);
+        if (ok) {
+            if (const auto it = m_numbers.constFind(value); it != m_numbers.cend()) {
+                const auto count = std::min(static_cast<qsizetype>(it->size()), std::max(limit - static_cast<qsizetype>(results.size()), qsizetype(0)));
+                results.insert(results.end(), it->cbegin(), it->cbegin() + count);
+            }
+        }
+    }
+
+    QList<Hit> hits;
+    hits.reserve(std::min(static_cast<qsizetype>(results.size()), limit));
+    for (const auto &posting : results) {
+        if (hits.size() >= limit) {
+            break;
+        }
+
+        hits.push_back(Hit{
+            .sheet = m_indexedSheets[posting.sheet],
+            .row = posting.location.row,
+            .subrow = posting.location.subrow,
+            .column = posting.location.column,
+            .language = static_cast<Language>(posting.location.language),
+            .sheetHasSubrows = m_sheetHasSubrows[posting.sheet],
+        });
+    }
+
+    return hits;
+}
+
+bool ExcelSearchIndex::indexesNumbers() const
+{
+    return m_indexNumbers;
+}
+
+QStringList ExcelSearchIndex::tokenize(const QString &text)
+{
+    QStringList tokens;
+    QString word;
+    QString ideographs;
+
+    const auto flushWord = [&tokens, &word] {
+        if (!word.isEmpty()) {
+            tokens.push_back(word);
+            word.clear();
+        }
+    };
+    const auto flushIdeographs = [&tokens, &ideographs] {
+        if (ideographs.size() == 1) {
+            tokens.push_back(ideographs);
+        } else {
+            for (qsizetype i = 0; i + 1 < ideographs.size(); i++) {
+                tokens.push_back(ideographs.mid(i, 2));
+            }
+        }
+        ideographs.clear();
+    };
+
+    for (const QChar c : text) {
+        const auto script = c.script();
+        if (script == QChar::Script_Han || script == QChar::Script_Hiragana || script == QChar::Script_Katakana) {
+            flushWord();
+            ideographs.append(c);
+        } else if (c.isLetterOrNumber()) {
+            flushIdeographs();
+            word.append(c.toLower());
+        } else {
+            flushWord();
+            flushIdeographs();
+        }
+    }
+    flushWord();
+    flushIdeographs();
+
+    tokens.removeDuplicates();
+
+    return tokens;
+}
+
+ExcelSearchIndex::SheetShard ExcelSearchIndex::indexSheet(const QString &name) const
+{
+    SheetShard shard;
+
+    const auto exhPath = QStringLiteral("exd/%1.exh").arg(name.toLower());
+    if (!m_cache->exists(exhPath)) {
+        return shard;
+    }
+
+    auto exh = physis_exh_parse(m_cache->platform(), m_cache->read(exhPath));
+    if (!exh.p_ptr) {
+        qWarning() << "Failed to parse" << exhPath;
+        return shard;
+    }
+
+    // Localized sheets also report None, but there's never any data in it
+    bool localized = false;
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        localized |= exh.languages[i] != Language::None;
+    }
+
+    const std::string nameStd = name.toStdString();
+
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        const auto language = exh.languages[i];
+        if (localized && language == Language::None) {
+            continue;
+        }
+
+        auto sheet = m_cache->readExcelSheet(name, &exh, language);
+        if (!sheet.p_ptr) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < sheet.page_count; j++) {
+            const auto &page = sheet.pages[j];
+            for (uint32_t k = 0; k < page.entry_count; k++) {
+                const auto &entry = page.entries[k];
+                if (entry.subrow_count > 1) {
+                    shard.hasSubrows = true;
+                }
+
+                for (uint32_t l = 0; l < entry.subrow_count; l++) {
+                    for (uint32_t column = 0; column < page.column_count; column++) {
+                        const ShardPosting posting{
+                            .row = entry.row_id,
+                            .subrow = static_cast<uint16_t>(l),
+                            .column = static_cast<uint16_t>(column),
+                            .language = static_cast<uint8_t>(language),
+                        };
+
+                        const auto &field = entry.subrows[l].columns[column];
+
+                        std::optional<qint64> number;
+                        switch (field.tag) {
+                        case physis_Field::Tag::String:
+                            for (const auto &token : tokenize(QString::fromUtf8(field.string._0))) {
+                                shard.tokens[token].push_back(posting);
+                            }
+                            break;
+                        case physis_Field::Tag::Int8:
+                            number = field.int8._0;
+                            break;
+                        case physis_Field::Tag::UInt8:
+                            number = field.u_int8._0;
+                            break;
+                        case physis_Field::Tag::Int16:
+                            number = field.int16._0;
+                            break;
+                        case physis_Field::Tag::UInt16:
+                            number = field.u_int16._0;
+                            break;
+                        case physis_Field::Tag::Int32:
+                            number = field.int32._0;
+                            break;
+                        case physis_Field::Tag::UInt32:
+                            number = field.u_int32._0;
+                            break;
+                        case physis_Field::Tag::Int64:
+                            number = field.int64._0;
+                            break;
+                        case physis_Field::Tag::UInt64:
+                            number = static_cast<qint64>(field.u_int64._0);
+                            break;
+                        default:
+                            break;
+                        }
+
+                        // Zero is everywhere, and indexing it would only waste memory
+                        if (m_indexNumbers && number.value_or(0) != 0) {
+                            shard.numbers[*number].push_back(posting);
+                        }
+                    }
+                }
+            }
+        }
+
+        physis_sqpack_free_excel_sheet(&sheet);
+
+        // Nobody else reads these pages, so we can drop them right away
+        for (uint32_t j = 0; j < exh.page_count; j++) {
+            QString pagePath = fromCString(physis_exd_calculate_filename(nameStd.c_str(), &exh, language, j)).toLower();
+            if (!pagePath.startsWith(QStringLiteral("exd/"))) {
+                pagePath.prepend(QStringLiteral("exd/"));
+            }
+            m_cache->evict(pagePath);
+        }
+    }
+
+    physis_exh_free(&exh);
+    m_cache->evict(exhPath);
+
+    // Languages are walked one after another, so put the postings back into row order for mergeShard
+    const auto shardPostingLess = [](const ShardPosting &a, const ShardPosting &b) {
+        return std::tie(a.row, a.subrow, a.column, a.language) < std::tie(b.row, b.subrow, b.column, b.language);
+    };
+    for (auto &postings : shard.tokens) {
+        std::ranges::sort(postings, shardPostingLess);
+    }
+    for (auto &postings : shard.numbers) {
+        std::ranges::sort(postings, shardPostingLess);
+    }
+
+    return shard;
+}
+
+std::optional<ExcelSearchIndex::SheetShard> ExcelSearchIndex::loadShard(const QString &name) const
+{
+    if (m_cacheDirectory.isEmpty()) {
+        return std::nullopt;
+    }
+
+    QFile file(shardPath(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != shardMagic || version != shardVersion) {
+        return std::nullopt;
+    }
+
+    // Row, subrow, column and language, as written by saveShard
+    constexpr qint64 serializedPostingSize = sizeof(quint32) + sizeof(quint16) + sizeof(quint16) + sizeof(quint8);
+
+    const auto readPostings = [&stream] {
+        quint32 count = 0;
+        stream >> count;
+
+        // Don't trust the count before allocating, a truncated file could ask for gigabytes
+        if (count > stream.device()->bytesAvailable() / serializedPostingSize) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            return std::vector<ShardPosting>();
+        }
+
+        std::vector<ShardPosting> postings(count);
+        for (auto &posting : postings) {
+            stream >> posting.row >> posting.subrow >> posting.column >> posting.language;
+        }
+        return postings;
+    };
+
+    SheetShard shard;
+    stream >> shard.hasSubrows;
+
+    quint32 tokenCount = 0;
+    stream >> tokenCount;
+    for (quint32 i = 0; i < tokenCount && stream.status() == QDataStream::Ok; i++) {
+        QString token;
+        stream >> token;
+        shard.tokens.insert(token, readPostings());
+    }
+
+    quint32 numberCount = 0;
+    stream >> numberCount;
+    for (quint32 i = 0; i < numberCount && stream.status() == QDataStream::Ok; i++) {
+        qint64 number = 0;
+        stream >> number;
+        shard.numbers.insert(number, readPostings());
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Search index for" << name << "is corrupt and will be rebuilt";
+        return std::nullopt;
+    }
+
+    return shard;
+}
+
+void ExcelSearchIndex::saveShard(const QString &name, const SheetShard &shard) const
+{
+    if (m_cacheDirectory.isEmpty()) {
+        return;
+    }
+
+    // Written through QSaveFile, so a cancelled build never leaves half a shard behind
+    QSaveFile file(shardPath(name));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write search index for" << name;
+        return;
+    }
+
+    QDataStream stream(&file);
+
+    const auto writePostings = [&stream](const std::vector<ShardPosting> &postings) {
+        stream << static_cast<quint32>(postings.size());
+        for (const auto &posting : postings) {
+            stream << posting.row << posting.subrow << posting.column << posting.language;
+        }
+    };
+
+    stream << shardMagic << shardVersion;
+    stream << shard.hasSubrows;
+
+    stream << static_cast<quint32>(shard.tokens.size());
+    for (const auto &[token, postings] : shard.tokens.asKeyValueRange()) {
+        stream << token;
+        writePostings(postings);
+    }
+
+    stream << static_cast<quint32>(shard.numbers.size());
+    for (const auto &[number, postings] : shard.numbers.asKeyValueRange()) {
+        stream << number;
+        writePostings(postings);
+    }
+
+    file.commit();
+}
+
+void ExcelSearchIndex::mergeShard(const QString &name, const SheetShard &shard)
+{
+    QWriteLocker locker(&m_lock);
+
+    // Shards are sorted already, and each one gets a higher sheet index than the last, so appending keeps every list sorted
+    const auto sheetIndex = static_cast<uint32_t>(m_indexedSheets.size());
+    m_indexedSheets.push_back(name);
+    m_sheetHasSubrows.push_back(shard.hasSubrows);
+
+    for (const auto &[token, postings] : shard.tokens.asKeyValueRange()) {
+        auto &list = m_tokens[token];
+        list.reserve(list.size() + postings.size());
+        for (const auto &posting : postings) {
+            list.push_back(Posting{.sheet = sheetIndex, .location = posting});
+        }
+    }
+
+    for (const auto &[number, postings] : shard.numbers.asKeyValueRange()) {
+        auto &list = m_numbers[number];
+        list.reserve(list.size() + postings.size());
+        for (const auto &posting : postings) {
+            list.push_back(Posting{.sheet = sheetIndex, .location = posting});
+        }
+    }
+}
+
+QString ExcelSearchIndex::shardPath(const QString &name) const
+{
+    // Sheet names can contain slashes (e.g. quest/000/ClsHrv001_00003)
+    return QDir(m_cacheDirectory).absoluteFilePath(QString::fromLatin1(QUrl::toPercentEncoding(name)) + QStringLiteral(".idx"));
+}
@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QFuture>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QStringList>
+
+#include <memory>
+#include <optional>
+
+#include <physis.hpp>
+
+class FileCache;
+
+/**
+ * @brief An inverted index over the string (and optionally integer) cells of every sheet and language.
+ *
+ * Each sheet is indexed once per game version and stored under AppDataLocation, so subsequent builds only load it from disk.
+ * The index can be queried while it's still being built, returning hits for whatever sheets are done so far.
+ */
+class ExcelSearchIndex
+{
+public:
+    struct Hit {
+        QString sheet;
+        uint32_t row = 0;
+        uint16_t subrow = 0;
+        uint16_t column = 0;
+        Language language = Language::None;
+        bool sheetHasSubrows = false;
+
+        /**
+         * @return The row query understood by EXDPart::goToRow.
+         */
+        QString rowQuery() const;
+    };
+
+    /**
+     * @param indexNumbers Whether to also index non-zero integer cells, which uses a lot more memory and disk space.
+     */
+    ExcelSearchIndex(const QString &gameDirectory, bool indexNumbers);
+    ~ExcelSearchIndex();
+
+    /**
+     * @brief Starts building the index in the background. Progress is reported per sheet.
+     */
+    QFuture<void> build();
+
+    /**
+     * @brief Returns cells containing every word in @p query. If numbers are indexed and @p query is an integer, matching integer cells are included too.
+     */
+    QList<Hit> search(const QString &query, qsizetype limit = 1000) const;
+
+    bool indexesNumbers() const;
+
+    /**
+     * @brief Splits text into lowercase words. Runs of CJK characters are split into overlapping bigrams instead, since they aren't separated by spaces.
+     */
+    static QStringList tokenize(const QString &text);
+
+private:
+    struct ShardPosting {
+        uint32_t row = 0;
+        uint16_t subrow = 0;
+        uint16_t column = 0;
+        uint8_t language = 0;
+    };
+
+    /**
+     * @brief The index for a single sheet, which is what gets stored on disk.
+     */
+    struct SheetShard {
+        bool hasSubrows = false;
+        QHash<QString, std::vector<ShardPosting>> tokens;
+        QHash<qint64, std::vector<ShardPosting>> numbers;
+    };
+
+    struct Posting {
+        uint32_t sheet = 0;
+        ShardPosting location;
+    };
+
+    /**
+     * @brief The order every posting list is kept in, so searches can intersect them without sorting.
+     */
+    static bool postingLess(const Posting &a, const Posting &b);
+
+    SheetShard indexSheet(const QString &name) const;
+    std::optional<SheetShard> loadShard(const QString &name) const;
+    void saveShard(const QString &name, const SheetShard &shard) const;
+    void mergeShard(const QString &name, const SheetShard &shard);
+    QString shardPath(const QString &name) const;
+
+    QString m_gameDirectory;
+    QString m_cacheDirectory;
+    bool m_indexNumbers = false;
+
+    // Dedicated to indexing, so we don't fill up the application's cache with every EXD
+    std::unique_ptr<FileCache> m_cache;
+    QStringList m_sheetNames;
+    QFuture<void> m_buildFuture;
+
+    mutable QReadWriteLock m_lock;
+    QStringList m_indexedSheets;
+    QList<bool> m_sheetHasSubrows;
+    QHash<QString, std::vector<Posting>> m_tokens;
+    QHash<qint64, std::vector<Posting>> m_numbers;
+};
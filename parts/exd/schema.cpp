@@ -4,39 +4,28 @@
 #define RYML_SINGLE_HDR_DEFINE_NOW
 #include "schema.h"
 
+#include <QDataStream>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
 #include <QStandardPaths>
 
+// Bump this whenever the compiled format changes, so old compiled schemas get thrown out
+static constexpr quint32 compiledMagic = 0x4E534348; // NSCH
+static constexpr quint32 compiledVersion = 1;
+
 Schema::Schema(const QString &path)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
+    if (loadCompiled(path)) {
         return;
     }
 
-    auto bytes = file.readAll();
-    if (bytes.isEmpty()) {
-        return;
-    }
-
-    const auto tree = ryml::parse_in_place(bytes.data());
-    if (tree.has_child(tree.root_id(), "fields")) {
-        const ryml::ConstNodeRef fields = tree["fields"];
-        for (const auto &node : fields) {
-            const auto field = parseField(node);
-            if (field.type != Field::Type::Array) {
-                m_fields.push_back(field);
-            }
-        }
-
-        if (tree.has_child(tree.root_id(), "displayField")) {
-            const ryml::ConstNodeRef displayField = tree["displayField"];
-            m_displayField = QString::fromLatin1(displayField.val());
-        }
-    } else {
-        qWarning() << "Failed to load schema from" << path;
+    if (parse(path)) {
+        compile();
+        saveCompiled(path);
     }
 }
 
@@ -58,10 +47,8 @@ QString Schema::nameForColumn(const uint32_t index) const
 
 std::optional<uint32_t> Schema::indexForName(const QString &name) const
 {
-    for (size_t i = 0; i < m_fields.size(); i++) {
-        if (m_fields[i].name == name) {
-            return i;
-        }
+    if (const auto it = m_fieldIndices.constFind(name); it != m_fieldIndices.cend()) {
+        return *it;
     }
 
     return std::nullopt;
@@ -71,12 +58,13 @@ QStringList Schema::targetSheetsForColumn(const uint32_t index, const std::optio
 {
     if (index < m_fields.size()) {
         const auto &field = m_fields[index];
-        if (const auto condition = field.condition) {
+        if (const auto &condition = field.condition) {
             Q_ASSERT(context.has_value()); // We need context here to resolve sheets!
 
             const int contextValue = context.value().toInt();
-            if (condition->cases.contains(contextValue)) {
-                return condition->cases[contextValue];
+            if (const auto it = std::ranges::lower_bound(condition->caseValues, contextValue);
+                it != condition->caseValues.cend() && *it == contextValue) {
+                return condition->caseTargets[std::distance(condition->caseValues.cbegin(), it)];
             }
         }
         return field.targetSheets;
@@ -88,13 +76,24 @@ QString Schema::neededContextForColumn(const uint32_t index) const
 {
     if (index < m_fields.size()) {
         const auto &field = m_fields[index];
-        if (const auto condition = field.condition) {
+        if (const auto &condition = field.condition) {
             return condition->switchColumn;
         }
     }
     return {};
 }
 
+std::optional<uint32_t> Schema::neededContextIndexForColumn(const uint32_t index) const
+{
+    if (index < m_fields.size()) {
+        const auto &field = m_fields[index];
+        if (const auto &condition = field.condition) {
+            return condition->switchIndex;
+        }
+    }
+    return std::nullopt;
+}
+
 bool Schema::isDisplayField(const QString &name) const
 {
     return m_displayField == name;
@@ -102,13 +101,7 @@ bool Schema::isDisplayField(const QString &name) const
 
 std::optional<int> Schema::displayFieldIndex() const
 {
-    for (size_t i = 0; i < m_fields.size(); i++) {
-        if (m_fields[i].name == m_displayField) {
-            return i;
-        }
-    }
-
-    return std::nullopt;
+    return m_displayFieldIndex;
 }
 
 QString Schema::comment(const uint32_t index) const
@@ -119,6 +112,45 @@ QString Schema::comment(const uint32_t index) const
     return {};
 }
 
+QString Schema::compiledPath(const QString &path)
+{
+    return QStringLiteral("%1.bin").arg(path);
+}
+
+bool Schema::parse(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    auto bytes = file.readAll();
+    if (bytes.isEmpty()) {
+        return false;
+    }
+
+    const auto tree = ryml::parse_in_place(bytes.data());
+    if (!tree.has_child(tree.root_id(), "fields")) {
+        qWarning() << "Failed to load schema from" << path;
+        return false;
+    }
+
+    const ryml::ConstNodeRef fields = tree["fields"];
+    for (const auto &node : fields) {
+        const auto field = parseField(node);
+        if (field.type != Field::Type::Array) {
+            m_fields.push_back(field);
+        }
+    }
+
+    if (tree.has_child(tree.root_id(), "displayField")) {
+        const ryml::ConstNodeRef displayField = tree["displayField"];
+        m_displayField = QString::fromLatin1(displayField.val());
+    }
+
+    return true;
+}
+
 Schema::Field Schema::parseField(ryml::ConstNodeRef node)
 {
     Field field;
@@ -145,14 +177,20 @@ Schema::Field Schema::parseField(ryml::ConstNodeRef node)
                 Condition condition;
                 condition.switchColumn = QString::fromLatin1(conditionField["switch"].val());
 
+                QMap<int, QStringList> cases;
+
                 ryml::ConstNodeRef casesField = conditionField["cases"];
                 for (const auto &switchCase : casesField) {
                     const int caseValue = std::atoi(switchCase.key().data());
                     for (const auto &targetSheet : casesField[switchCase.key()]) {
-                        condition.cases[caseValue].push_back(QString::fromLatin1(targetSheet.val()));
+                        cases[caseValue].push_back(QString::fromLatin1(targetSheet.val()));
                     }
                 }
 
+                // QMap is already sorted by key, which is what the lookup expects
+                condition.caseValues = cases.keys();
+                condition.caseTargets = cases.values();
+
                 field.condition = condition;
             }
         } else if (typeName == QStringLiteral("array")) {
@@ -195,3 +233,120 @@ Schema::Field Schema::parseField(ryml::ConstNodeRef node)
 
     return field;
 }
+
+void Schema::compile()
+{
+    m_fieldIndices.clear();
+    m_fieldIndices.reserve(m_fields.size());
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        // Keep the first one, like the old linear search did
+        if (!m_fieldIndices.contains(m_fields[i].name)) {
+            m_fieldIndices.insert(m_fields[i].name, static_cast<uint32_t>(i));
+        }
+    }
+
+    m_displayFieldIndex.reset();
+    if (const auto index = indexForName(m_displayField)) {
+        m_displayFieldIndex = static_cast<int>(*index);
+    }
+
+    for (auto &field : m_fields) {
+        if (field.condition) {
+            field.condition->switchIndex = indexForName(field.condition->switchColumn);
+        }
+    }
+}
+
+bool Schema::loadCompiled(const QString &path)
+{
+    const QFileInfo sourceInfo(path);
+    if (!sourceInfo.exists()) {
+        return false;
+    }
+
+    QFile file(compiledPath(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0, version = 0;
+    qint64 sourceSize = 0, sourceModified = 0;
+    stream >> magic >> version >> sourceSize >> sourceModified;
+
+    // Throw it out if the YAML was edited since
+    if (magic != compiledMagic || version != compiledVersion || sourceSize != sourceInfo.size()
+        || sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+
+    quint32 fieldCount = 0;
+    stream >> fieldCount;
+
+    std::vector<Field> fields(fieldCount);
+    for (auto &field : fields) {
+        quint8 type = 0;
+        bool hasCondition = false;
+        stream >> field.name >> type >> field.comment >> field.targetSheets >> hasCondition;
+        field.type = static_cast<Field::Type>(type);
+
+        if (hasCondition) {
+            Condition condition;
+            bool hasSwitchIndex = false;
+            quint32 switchIndex = 0;
+            stream >> condition.switchColumn >> hasSwitchIndex >> switchIndex >> condition.caseValues >> condition.caseTargets;
+            if (hasSwitchIndex) {
+                condition.switchIndex = switchIndex;
+            }
+            field.condition = condition;
+        }
+    }
+
+    QString displayField;
+    QHash<QString, quint32> fieldIndices;
+    bool hasDisplayFieldIndex = false;
+    qint32 displayFieldIndex = 0;
+    stream >> displayField >> fieldIndices >> hasDisplayFieldIndex >> displayFieldIndex;
+
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    m_fields = std::move(fields);
+    m_displayField = displayField;
+    m_fieldIndices = fieldIndices;
+    if (hasDisplayFieldIndex) {
+        m_displayFieldIndex = displayFieldIndex;
+    }
+
+    return true;
+}
+
+void Schema::saveCompiled(const QString &path) const
+{
+    const QFileInfo sourceInfo(path);
+
+    QSaveFile file(compiledPath(path));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write compiled schema for" << path;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << compiledMagic << compiledVersion << static_cast<qint64>(sourceInfo.size()) << sourceInfo.lastModified().toMSecsSinceEpoch();
+
+    stream << static_cast<quint32>(m_fields.size());
+    for (const auto &field : m_fields) {
+        stream << field.name << static_cast<quint8>(field.type) << field.comment << field.targetSheets << field.condition.has_value();
+
+        if (const auto &condition = field.condition) {
+            stream << condition->switchColumn << condition->switchIndex.has_value() << static_cast<quint32>(condition->switchIndex.value_or(0))
+                   << condition->caseValues << condition->caseTargets;
+        }
+    }
+
+    stream << m_displayField << m_fieldIndices << m_displayFieldIndex.has_value() << static_cast<qint32>(m_displayFieldIndex.value_or(0));
+
+    file.commit();
+}
@@ -3,12 +3,19 @@
 
 #pragma once
 
+#include <QHash>
 #include <QVariant>
 
 #ifndef _RYML_SINGLE_HEADER_AMALGAMATED_HPP_
 #include <rapidyaml-0.10.0.hpp>
 #endif
 
+/**
+ * @brief An EXDSchema sheet definition.
+ *
+ * The YAML is only parsed the first time a schema is used, after which a compiled copy is stored next to it and loaded instead.
+ * Lookups by name, the display field and condition cases are all resolved when compiling, since they are used for every cell.
+ */
 class Schema
 {
 public:
@@ -43,6 +50,11 @@ public:
      */
     QString neededContextForColumn(uint32_t index) const;
 
+    /**
+     * @brief Same as neededContextForColumn, but returns the index of the column instead of its name.
+     */
+    std::optional<uint32_t> neededContextIndexForColumn(uint32_t index) const;
+
     /**
      * @brief Returns true if this column name is supposed to be the main display field.
      */
@@ -60,10 +72,19 @@ public:
      */
     QString comment(uint32_t index) const;
 
+    /**
+     * @return The path where the compiled form of the schema at @p path is stored.
+     */
+    static QString compiledPath(const QString &path);
+
 private:
     struct Condition {
         QString switchColumn;
-        QHash<int, QList<QString>> cases; // TODO: is it only ints supported in cases? I think so...
+        std::optional<uint32_t> switchIndex;
+
+        // Sorted, and caseTargets[i] belongs to caseValues[i]
+        QList<int> caseValues; // TODO: is it only ints supported in cases? I think so...
+        QList<QStringList> caseTargets;
     };
 
     struct Field {
@@ -82,8 +103,20 @@ private:
         std::optional<Condition> condition;
     };
 
+    bool parse(const QString &path);
     Field parseField(ryml::ConstNodeRef node);
 
+    /**
+     * @brief Resolves everything that would otherwise need a search by name.
+     */
+    void compile();
+
+    bool loadCompiled(const QString &path);
+    void saveCompiled(const QString &path) const;
+
     std::vector<Field> m_fields;
     QString m_displayField;
+
+    QHash<QString, uint32_t> m_fieldIndices;
+    std::optional<int> m_displayFieldIndex;
 };
@@ -0,0 +1,357 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "sheetdiff.h"
+
+#include "excelmodel.h"
+#include "filecache.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtConcurrent>
+#include <magic_enum.hpp>
+
+namespace
+{
+/**
+ * @brief Owns the EXH and sheet data for one side of the diff, and evicts their files from the cache once it's done.
+ */
+struct LoadedSheet {
+    FileCache *cache = nullptr;
+    QString name;
+    physis_EXH exh{};
+    physis_ExcelSheet sheet{};
+    Language language = Language::None;
+
+    LoadedSheet() = default;
+    LoadedSheet(const LoadedSheet &) = delete;
+    LoadedSheet &operator=(const LoadedSheet &) = delete;
+
+    ~LoadedSheet()
+    {
+        physis_sqpack_free_excel_sheet(&sheet);
+
+        if (cache && exh.p_ptr) {
+            const std::string nameStd = name.toStdString();
+            for (uint32_t i = 0; i < exh.page_count; i++) {
+                QString pagePath = fromCString(physis_exd_calculate_filename(nameStd.c_str(), &exh, language, i)).toLower();
+                if (!pagePath.startsWith(QStringLiteral("exd/"))) {
+                    pagePath.prepend(QStringLiteral("exd/"));
+                }
+                cache->evict(pagePath);
+            }
+        }
+
+        physis_exh_free(&exh);
+
+        if (cache) {
+            cache->evict(QStringLiteral("exd/%1.exh").arg(name.toLower()));
+        }
+    }
+};
+
+struct RowReference {
+    uint32_t rowId = 0;
+    uint16_t subrowId = 0;
+    const physis_Field *columns = nullptr;
+
+    std::pair<uint32_t, uint16_t> key() const
+    {
+        return {rowId, subrowId};
+    }
+};
+
+/**
+ * @brief Flattens every (sub)row of the sheet into a list sorted by row and subrow ID.
+ */
+std::vector<RowReference> collectRows(const physis_ExcelSheet &sheet)
+{
+    std::vector<RowReference> rows;
+    for (uint32_t i = 0; i < sheet.page_count; i++) {
+        const auto &page = sheet.pages[i];
+        for (uint32_t j = 0; j < page.entry_count; j++) {
+            const auto &entry = page.entries[j];
+            for (uint32_t k = 0; k < entry.subrow_count; k++) {
+                rows.push_back(RowReference{
+                    .rowId = entry.row_id,
+                    .subrowId = static_cast<uint16_t>(k),
+                    .columns = entry.subrows[k].columns,
+                });
+            }
+        }
+    }
+
+    // Pages are already stored in row order, so this is usually a no-op
+    if (!std::ranges::is_sorted(rows, {}, &RowReference::key)) {
+        std::ranges::sort(rows, {}, &RowReference::key);
+    }
+
+    return rows;
+}
+
+bool fieldsEqual(const physis_Field &a, const physis_Field &b)
+{
+    if (a.tag != b.tag) {
+        return false;
+    }
+
+    switch (a.tag) {
+    case physis_Field::Tag::String:
+        return std::strcmp(a.string._0, b.string._0) == 0;
+    case physis_Field::Tag::Bool:
+        return a.bool_._0 == b.bool_._0;
+    case physis_Field::Tag::Int8:
+        return a.int8._0 == b.int8._0;
+    case physis_Field::Tag::UInt8:
+        return a.u_int8._0 == b.u_int8._0;
+    case physis_Field::Tag::Int16:
+        return a.int16._0 == b.int16._0;
+    case physis_Field::Tag::UInt16:
+        return a.u_int16._0 == b.u_int16._0;
+    case physis_Field::Tag::Int32:
+        return a.int32._0 == b.int32._0;
+    case physis_Field::Tag::UInt32:
+        return a.u_int32._0 == b.u_int32._0;
+    case physis_Field::Tag::Float32:
+        // Compare the bits, so NaNs don't show up as changes
+        return std::memcmp(&a.float32._0, &b.float32._0, sizeof(float)) == 0;
+    case physis_Field::Tag::Int64:
+        return a.int64._0 == b.int64._0;
+    case physis_Field::Tag::UInt64:
+        return a.u_int64._0 == b.u_int64._0;
+    }
+
+    return false;
+}
+
+QString enumName(const auto value)
+{
+    return QString::fromUtf8(magic_enum::enum_name(value));
+}
+}
+
+ExcelSheetDiffer::ExcelSheetDiffer(const physis_SqPackResource oldData, const physis_SqPackResource newData)
+    : m_oldCache(std::make_unique<FileCache>(oldData))
+    , m_newCache(std::make_unique<FileCache>(newData))
+{
+}
+
+ExcelSheetDiffer::~ExcelSheetDiffer()
+{
+    // The workers use this differ and its caches
+    m_future.cancel();
+    m_future.waitForFinished();
+}
+
+SheetDiff ExcelSheetDiffer::diffSheet(const QString &name, const Language language) const
+{
+    SheetDiff diff;
+    diff.name = name;
+
+    const auto path = QStringLiteral("exd/%1.exh").arg(name.toLower());
+
+    const auto loadSheet = [&name, &path, language](FileCache &cache, LoadedSheet &loaded) {
+        if (!cache.exists(path)) {
+            return false;
+        }
+
+        loaded.cache = &cache;
+        loaded.name = name;
+
+        loaded.exh = physis_exh_parse(cache.platform(), cache.read(path));
+        if (!loaded.exh.p_ptr) {
+            return false;
+        }
+
+        loaded.language = getSuitableLanguage(loaded.exh, language);
+        loaded.sheet = cache.readExcelSheet(name, &loaded.exh, loaded.language);
+
+        return loaded.sheet.p_ptr != nullptr;
+    };
+
+    LoadedSheet oldSheet, newSheet;
+    const bool hasOld = loadSheet(*m_oldCache, oldSheet);
+    const bool hasNew = loadSheet(*m_newCache, newSheet);
+
+    if (!hasOld && !hasNew) {
+        qWarning() << "Failed to load" << name << "from either installation";
+        return diff;
+    }
+
+    diff.language = hasNew ? newSheet.language : oldSheet.language;
+    diff.oldColumnCount = hasOld ? oldSheet.exh.column_count : 0;
+    diff.newColumnCount = hasNew ? newSheet.exh.column_count : 0;
+
+    const auto oldRows = hasOld ? collectRows(oldSheet.sheet) : std::vector<RowReference>{};
+    const auto newRows = hasNew ? collectRows(newSheet.sheet) : std::vector<RowReference>{};
+
+    const uint32_t sharedColumnCount = std::min(diff.oldColumnCount, diff.newColumnCount);
+
+    // Both lists are sorted, so we can walk them side-by-side
+    size_t i = 0, j = 0;
+    while (i < oldRows.size() || j < newRows.size()) {
+        if (j == newRows.size() || (i < oldRows.size() && oldRows[i].key() < newRows[j].key())) {
+            diff.rows.push_back(SheetDiffRow{
+                .rowId = oldRows[i].rowId,
+                .subrowId = oldRows[i].subrowId,
+                .status = SheetDiffRow::Status::Removed,
+            });
+            i++;
+        } else if (i == oldRows.size() || newRows[j].key() < oldRows[i].key()) {
+            diff.rows.push_back(SheetDiffRow{
+                .rowId = newRows[j].rowId,
+                .subrowId = newRows[j].subrowId,
+                .status = SheetDiffRow::Status::Added,
+            });
+            j++;
+        } else {
+            const auto &oldRow = oldRows[i];
+            const auto &newRow = newRows[j];
+
+            SheetDiffRow row{
+                .rowId = newRow.rowId,
+                .subrowId = newRow.subrowId,
+                .status = SheetDiffRow::Status::Changed,
+            };
+
+            for (uint32_t column = 0; column < sharedColumnCount; column++) {
+                const auto &oldField = oldRow.columns[column];
+                const auto &newField = newRow.columns[column];
+                if (!fieldsEqual(oldField, newField)) {
+                    row.cells.push_back(SheetDiffCell{
+                        .column = column,
+                        .oldType = oldField.tag,
+                        .newType = newField.tag,
+                        .oldValue = ExcelModel::editForData(oldField),
+                        .newValue = ExcelModel::editForData(newField),
+                    });
+                }
+            }
+
+            if (!row.cells.isEmpty()) {
+                diff.rows.push_back(std::move(row));
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    if (!hasOld) {
+        diff.status = SheetDiff::Status::Added;
+    } else if (!hasNew) {
+        diff.status = SheetDiff::Status::Removed;
+    } else if (!diff.rows.empty() || diff.oldColumnCount != diff.newColumnCount) {
+        diff.status = SheetDiff::Status::Changed;
+    }
+
+    return diff;
+}
+
+QFuture<SheetDiff> ExcelSheetDiffer::diffAllSheets(const Language language)
+{
+    m_future = QtConcurrent::mapped(allSheetNames(), [this, language](const QString &name) {
+        return diffSheet(name, language);
+    });
+
+    return m_future;
+}
+
+QStringList ExcelSheetDiffer::allSheetNames() const
+{
+    QStringList list;
+
+    for (const auto cache : {m_oldCache.get(), m_newCache.get()}) {
+        const auto names = physis_sqpack_get_all_sheet_names(&cache->resource());
+        for (uint32_t i = 0; i < names.name_count; i++) {
+            list.push_back(QString::fromStdString(names.names[i]));
+        }
+        physis_sqpack_free_all_sheet_names(names);
+    }
+
+    list.sort();
+    list.removeDuplicates();
+
+    return list;
+}
+
+QJsonObject ExcelSheetDiffer::toJson(const SheetDiff &diff)
+{
+    QJsonArray rows;
+    for (const auto &row : diff.rows) {
+        QJsonObject rowObject{
+            {QStringLiteral("row"), static_cast<qint64>(row.rowId)},
+            {QStringLiteral("subrow"), row.subrowId},
+            {QStringLiteral("status"), enumName(row.status)},
+        };
+
+        if (row.status == SheetDiffRow::Status::Changed) {
+            QJsonArray cells;
+            for (const auto &cell : row.cells) {
+                cells.push_back(QJsonObject{
+                    {QStringLiteral("column"), static_cast<qint64>(cell.column)},
+                    {QStringLiteral("oldType"), enumName(cell.oldType)},
+                    {QStringLiteral("newType"), enumName(cell.newType)},
+                    {QStringLiteral("old"), QJsonValue::fromVariant(cell.oldValue)},
+                    {QStringLiteral("new"), QJsonValue::fromVariant(cell.newValue)},
+                });
+            }
+            rowObject[QStringLiteral("cells")] = cells;
+        }
+
+        rows.push_back(rowObject);
+    }
+
+    return QJsonObject{
+        {QStringLiteral("name"), diff.name},
+        {QStringLiteral("language"), enumName(diff.language)},
+        {QStringLiteral("status"), enumName(diff.status)},
+        {QStringLiteral("oldColumnCount"), static_cast<qint64>(diff.oldColumnCount)},
+        {QStringLiteral("newColumnCount"), static_cast<qint64>(diff.newColumnCount)},
+        {QStringLiteral("rows"), rows},
+    };
+}
+
+bool ExcelSheetDiffer::writeReport(const QList<SheetDiff> &diffs, const QString &path)
+{
+    QJsonArray sheets;
+    for (const auto &diff : diffs) {
+        if (diff.status != SheetDiff::Status::Unchanged) {
+            sheets.push_back(toJson(diff));
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write sheet diff report to" << path;
+        return false;
+    }
+
+    file.write(QJsonDocument(QJsonObject{{QStringLiteral("sheets"), sheets}}).toJson());
+
+    return true;
+}
+
+Language ExcelSheetDiffer::getSuitableLanguage(const physis_EXH &exh, const Language preferredLanguage)
+{
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        if (exh.languages[i] == preferredLanguage) {
+            return preferredLanguage;
+        }
+    }
+
+    // Unlocalized sheets only have None
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        if (exh.languages[i] == Language::None) {
+            return Language::None;
+        }
+    }
+
+    if (exh.language_count > 0) {
+        return exh.languages[0];
+    }
+
+    return Language::None;
+}
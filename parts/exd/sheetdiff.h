@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QFuture>
+#include <QJsonObject>
+#include <QVariant>
+
+#include <memory>
+
+#include <physis.hpp>
+
+class FileCache;
+
+/**
+ * @brief A single cell that differs between the old and new version of a row.
+ */
+struct SheetDiffCell {
+    uint32_t column = 0;
+    physis_Field::Tag oldType;
+    physis_Field::Tag newType;
+    QVariant oldValue;
+    QVariant newValue;
+};
+
+struct SheetDiffRow {
+    enum class Status {
+        Added,
+        Removed,
+        Changed,
+    };
+
+    uint32_t rowId = 0;
+    uint16_t subrowId = 0;
+    Status status = Status::Changed;
+
+    // Only filled for changed rows
+    QList<SheetDiffCell> cells;
+};
+
+struct SheetDiff {
+    enum class Status {
+        Unchanged,
+        Added,
+        Removed,
+        Changed,
+    };
+
+    QString name;
+    Language language = Language::None;
+    Status status = Status::Unchanged;
+    uint32_t oldColumnCount = 0;
+    uint32_t newColumnCount = 0;
+    std::vector<SheetDiffRow> rows;
+};
+
+/**
+ * @brief Compares Excel sheets between two game installations.
+ *
+ * Rows are matched by row and subrow ID, and columns by their index in the EXH.
+ * If the column layout changed between versions, only the columns both versions share are compared.
+ * Each installation is read through a cache owned by the differ, and each sheet is evicted once it's been compared.
+ */
+class ExcelSheetDiffer
+{
+public:
+    /**
+     * @brief Takes ownership of both resources.
+     */
+    ExcelSheetDiffer(physis_SqPackResource oldData, physis_SqPackResource newData);
+    ~ExcelSheetDiffer();
+
+    /**
+     * @brief Diffs a single sheet. If the sheet has no data for @p language, it falls back to Language::None.
+     */
+    SheetDiff diffSheet(const QString &name, Language language) const;
+
+    /**
+     * @brief Diffs every sheet known to either installation in parallel.
+     *
+     * Destroying the differ cancels the diff and waits for it.
+     */
+    QFuture<SheetDiff> diffAllSheets(Language language);
+
+    /**
+     * @return The names of every sheet in either installation, sorted.
+     */
+    QStringList allSheetNames() const;
+
+    static QJsonObject toJson(const SheetDiff &diff);
+
+    /**
+     * @brief Writes a JSON report to @p path, skipping any unchanged sheets.
+     */
+    static bool writeReport(const QList<SheetDiff> &diffs, const QString &path);
+
+private:
+    static Language getSuitableLanguage(const physis_EXH &exh, Language preferredLanguage);
+
+    std::unique_ptr<FileCache> m_oldCache;
+    std::unique_ptr<FileCache> m_newCache;
+    QFuture<SheetDiff> m_future;
+};
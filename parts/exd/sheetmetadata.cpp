@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "sheetmetadata.h"
+
+#include "filecache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <magic_enum.hpp>
+
+// Bump this whenever the on-disk format changes, so old indices get rebuilt
+static constexpr int formatVersion = 1;
+
+bool SheetMetadata::isLocalized() const
+{
+    return std::ranges::any_of(languages, [](const Language language) {
+        return language != Language::None;
+    });
+}
+
+QString SheetMetadataIndex::cachePath(const QString &gameVersion)
+{
+    const QDir dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const QDir indexDir = dataDir.absoluteFilePath(QStringLiteral("sheetmetadata"));
+
+    return indexDir.absoluteFilePath(QStringLiteral("%1.json").arg(gameVersion));
+}
+
+std::optional<QList<SheetMetadata>> SheetMetadataIndex::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    const auto document = QJsonDocument::fromJson(file.readAll());
+    if (document.object()[QStringLiteral("formatVersion")].toInt() != formatVersion) {
+        return std::nullopt;
+    }
+
+    QList<SheetMetadata> metadata;
+    for (const auto &value : document.object()[QStringLiteral("sheets")].toArray()) {
+        const auto object = value.toObject();
+
+        SheetMetadata sheet;
+        sheet.name = object[QStringLiteral("name")].toString();
+        sheet.pageCount = object[QStringLiteral("pages")].toInt();
+        sheet.rowCount = object[QStringLiteral("rows")].toInteger();
+        for (const auto &columnType : object[QStringLiteral("columns")].toArray()) {
+            sheet.columnTypes.push_back(columnType.toString());
+        }
+        for (const auto &language : object[QStringLiteral("languages")].toArray()) {
+            sheet.languages.push_back(static_cast<Language>(language.toInt()));
+        }
+
+        metadata.push_back(sheet);
+    }
+
+    return metadata;
+}
+
+bool SheetMetadataIndex::save(const QList<SheetMetadata> &metadata, const QString &path)
+{
+    QJsonArray sheets;
+    for (const auto &sheet : metadata) {
+        QJsonArray languages;
+        for (const auto language : sheet.languages) {
+            languages.push_back(static_cast<int>(language));
+        }
+
+        sheets.push_back(QJsonObject{
+            {QStringLiteral("name"), sheet.name},
+            {QStringLiteral("pages"), static_cast<qint64>(sheet.pageCount)},
+            {QStringLiteral("rows"), static_cast<qint64>(sheet.rowCount)},
+            {QStringLiteral("columns"), QJsonArray::fromStringList(sheet.columnTypes)},
+            {QStringLiteral("languages"), languages},
+        });
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write sheet metadata to" << path;
+        return false;
+    }
+
+    const QJsonObject root{
+        {QStringLiteral("formatVersion"), formatVersion},
+        {QStringLiteral("sheets"), sheets},
+    };
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+
+    return true;
+}
+
+QList<SheetMetadata> SheetMetadataIndex::build(FileCache &cache, const QStringList &names)
+{
+    return QtConcurrent::blockingMapped(names, [&cache](const QString &name) {
+        return indexSheet(cache, name);
+    });
+}
+
+QList<SheetMetadata> SheetMetadataIndex::loadOrBuild(FileCache &cache, const QStringList &names, const QString &gameVersion)
+{
+    if (gameVersion.isEmpty()) {
+        return build(cache, names);
+    }
+
+    const QString path = cachePath(gameVersion);
+    if (const auto cached = load(path)) {
+        // Make sure the sheet list didn't change underneath us (e.g. mods adding new sheets)
+        QStringList cachedNames;
+        for (const auto &sheet : *cached) {
+            cachedNames.push_back(sheet.name);
+        }
+
+        if (cachedNames == names) {
+            return *cached;
+        }
+    }
+
+    qInfo() << "Building sheet metadata index for" << gameVersion;
+
+    const auto metadata = build(cache, names);
+    save(metadata, path);
+
+    return metadata;
+}
+
+SheetMetadata SheetMetadataIndex::indexSheet(FileCache &cache, const QString &name)
+{
+    SheetMetadata metadata;
+    metadata.name = name;
+
+    const auto path = QStringLiteral("exd/%1.exh").arg(name.toLower());
+    if (!cache.exists(path)) {
+        return metadata;
+    }
+
+    auto exh = physis_exh_parse(cache.platform(), cache.read(path));
+    if (!exh.p_ptr) {
+        qWarning() << "Failed to parse" << path;
+        return metadata;
+    }
+
+    metadata.pageCount = exh.page_count;
+    for (uint32_t i = 0; i < exh.page_count; i++) {
+        metadata.rowCount += exh.pages[i].row_count;
+    }
+    for (uint32_t i = 0; i < exh.column_count; i++) {
+        metadata.columnTypes.push_back(QString::fromUtf8(magic_enum::enum_name(exh.column_definitions[i].data_type)));
+    }
+    for (uint32_t i = 0; i < exh.language_count; i++) {
+        metadata.languages.push_back(exh.languages[i]);
+    }
+
+    physis_exh_free(&exh);
+
+    return metadata;
+}
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include <physis.hpp>
+
+class FileCache;
+
+/**
+ * @brief Information about a sheet that can be gathered from its EXH alone.
+ */
+struct SheetMetadata {
+    QString name;
+    uint32_t pageCount = 0;
+    uint32_t rowCount = 0;
+    QStringList columnTypes;
+    QList<Language> languages;
+
+    /**
+     * @return True if this sheet has data for any language other than None.
+     */
+    bool isLocalized() const;
+};
+
+/**
+ * @brief Builds and caches metadata for every sheet, so it only has to be parsed once per game version.
+ */
+class SheetMetadataIndex
+{
+public:
+    /**
+     * @return Where the index for this game version is stored.
+     */
+    static QString cachePath(const QString &gameVersion);
+
+    /**
+     * @brief Loads a previously saved index. Returns nothing if it doesn't exist or is unreadable.
+     */
+    static std::optional<QList<SheetMetadata>> load(const QString &path);
+
+    static bool save(const QList<SheetMetadata> &metadata, const QString &path);
+
+    /**
+     * @brief Parses the EXH for each sheet in parallel. This blocks, so call it from a worker thread.
+     */
+    static QList<SheetMetadata> build(FileCache &cache, const QStringList &names);
+
+    /**
+     * @brief Loads the cached index for @p gameVersion, or builds and saves it if it's missing.
+     *
+     * If @p gameVersion is empty, nothing is cached.
+     */
+    static QList<SheetMetadata> loadOrBuild(FileCache &cache, const QStringList &names, const QString &gameVersion);
+
+private:
+    static SheetMetadata indexSheet(FileCache &cache, const QString &name);
+};
@@ -124,7 +124,15 @@ DrawObject &MDLPart::getModel(const int index) const
 
 void MDLPart::reloadModel(const int index)
 {
-    m_renderer->reloadDrawObject(*m_vkWindow->models[index].sourceObject);
+    const auto sourceObject = m_vkWindow->models[index].sourceObject;
+    m_renderer->reloadDrawObject(*sourceObject);
+
+    // The bounding box may have changed, so every instance of it needs new world bounds
+    for (auto &model : m_vkWindow->models) {
+        if (model.sourceObject == sourceObject) {
+            model.markTransformationDirty();
+        }
+    }
 
     Q_EMIT modelChanged();
 }
@@ -173,7 +181,8 @@ void MDLPart::addModel(const physis_MDL &mdl,
     }
 
     Q_ASSERT(model != nullptr);
-    m_vkWindow->models.push_back(DrawObjectInstance{name, model, transformation, {}, clipOutDistance});
+    m_vkWindow->models.push_back(DrawObjectInstance{name, model, transformation, clipOutDistance});
+    m_renderer->scene.invalidateObjects();
 
     Q_EMIT modelChanged();
 }
@@ -228,6 +237,7 @@ void MDLPart::destroyObjects()
     m_renderer->scene.resetLights();
 
     m_vkWindow->models.clear();
+    m_renderer->scene.invalidateObjects();
     for (const auto &model : m_vkWindow->sourceModels | std::views::values) {
         m_renderer->destroyDrawObject(*model);
         delete model;
@@ -311,6 +321,8 @@ void MDLPart::reloadBoneData()
                 const int originalBoneId = boneMapping[i];
                 model->boneData[i] = deformBones[i] * boneData[originalBoneId].localTransform * boneData[originalBoneId].inversePose;
             }
+
+            model->boneDataVersion++;
         }
     }
 }
@@ -591,6 +603,7 @@ void MDLPart::removeModel(const physis_MDL &mdl)
                                                     })
                                  .begin(),
                              m_vkWindow->models.end());
+    m_renderer->scene.invalidateObjects();
     Q_EMIT modelChanged();
 }
 
@@ -633,6 +646,22 @@ int MDLPart::numModels() const
     return m_vkWindow->models.size();
 }
 
+std::optional<int> MDLPart::pickModel(const QPointF &position) const
+{
+    if (m_vkWindow->width() <= 0 || m_vkWindow->height() <= 0) {
+        return std::nullopt;
+    }
+
+    // Same convention as the screen-space math in MapView, Y goes down
+    const glm::vec2 normalizedPosition{position.x() / m_vkWindow->width() * 2.0 - 1.0, position.y() / m_vkWindow->height() * 2.0 - 1.0};
+
+    if (const auto index = m_renderer->scene.pickObject(m_renderer->camera, normalizedPosition)) {
+        return static_cast<int>(*index);
+    }
+
+    return std::nullopt;
+}
+
 RenderManager *MDLPart::manager() const
 {
     return m_renderer.get();
@@ -714,6 +743,7 @@ void MDLPart::addExistingModel(const QString &name, const Transformation &transf
 {
     const auto model = m_vkWindow->sourceModels[name];
     m_vkWindow->models.push_back(DrawObjectInstance{name, model, transformation});
+    m_renderer->scene.invalidateObjects();
 }
 
 #include "moc_mdlpart.cpp"
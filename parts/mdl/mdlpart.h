@@ -46,6 +46,9 @@ public:
 
     int numModels() const;
 
+    /// Returns the index of the model under @p position (in the part's coordinates), if any.
+    std::optional<int> pickModel(const QPointF &position) const;
+
     RenderManager *manager() const;
 
     physis_PBD pbd{};
@@ -68,6 +71,8 @@ Q_SIGNALS:
     // Called when a Vulkan context is available, and you can safely access RenderManager
     void initializeRender();
     void cameraMoved();
+    /// Emitted when a model is clicked without moving the camera.
+    void modelPicked(int index);
 
 public Q_SLOTS:
     /// Clears all stored MDLs.
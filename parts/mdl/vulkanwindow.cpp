@@ -88,17 +88,26 @@ bool VulkanWindow::event(QEvent *e)
             m_part->lastX = mouseEvent->position().x();
             m_part->lastY = mouseEvent->position().y();
             m_part->cameraMode = mouseEvent->button() == Qt::MouseButton::LeftButton ? MDLPart::CameraMode::Orbit : MDLPart::CameraMode::Move;
+            m_pressPosition = mouseEvent->position();
 
             setKeyboardGrabEnabled(true);
             setCursor(Qt::BlankCursor);
         }
     } break;
     case QEvent::MouseButtonRelease: {
+        const auto mouseEvent = dynamic_cast<QMouseEvent *>(e);
+
         if (m_part->isEnabled()) {
             m_part->cameraMode = MDLPart::CameraMode::None;
 
             setKeyboardGrabEnabled(false);
             setCursor({});
+
+            if (mouseEvent->button() == Qt::MouseButton::LeftButton && (mouseEvent->position() - m_pressPosition).manhattanLength() < 3) {
+                if (const auto index = m_part->pickModel(mouseEvent->position())) {
+                    Q_EMIT m_part->modelPicked(*index);
+                }
+            }
         }
     } break;
     case QEvent::MouseMove: {
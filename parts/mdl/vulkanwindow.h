@@ -35,5 +35,6 @@ private:
     QVulkanInstance *m_instance = nullptr;
     MDLPart *m_part = nullptr;
     bool m_pressedKeys[7] = {};
+    QPointF m_pressPosition; // to tell clicks apart from dragging the camera
     QElapsedTimer m_timer;
 };
@@ -364,33 +364,62 @@ void MapView::processLayer(ObjectScene &scene, const physis_Layer &layer, const
 
 void MapView::updateLightCulling() const
 {
-    m_mdlPart->manager()->scene.culledLights = 0;
+    auto &scene = m_mdlPart->manager()->scene;
+    scene.culledLights = 0;
+
+    // Gather the bounds of every light first, so they can be culled all at once
+    AabbBatch bounds;
+    std::vector<BoundingBox> boundingBoxes; // the same bounds, for checking them against the models
+    std::vector<int> boundsIndices(scene.lights.size(), -1); // -1 for lights without bounds
+    for (size_t i = 0; i < scene.lights.size(); i++) {
+        const auto &light = scene.lights[i];
+        if (light.id == 0) {
+            continue;
+        }
 
-    for (auto &light : m_mdlPart->manager()->scene.lights) {
-        // Update based on culling
-        if (light.id != 0) {
-            if (auto bounding_box = m_appState->checkLightBoundingBox(light.id, light.parentSgbId)) {
-                bounding_box->min[0] += light.position[0];
-                bounding_box->min[1] += light.position[1];
-                bounding_box->min[2] += light.position[2];
-                bounding_box->max[0] += light.position[0];
-                bounding_box->max[1] += light.position[1];
-                bounding_box->max[2] += light.position[2];
-                if (m_mdlPart->manager()->scene.frustumCulling && !test_aabb_frustum(m_mdlPart->manager()->camera.frustum(), *bounding_box)) {
-                    light.active = false;
-                    m_mdlPart->manager()->scene.culledLights++;
-                    break;
-                }
-                light.active = true;
+        if (auto bounding_box = m_appState->checkLightBoundingBox(light.id, light.parentSgbId)) {
+            for (int j = 0; j < 3; j++) {
+                bounding_box->min[j] += light.position[j];
+                bounding_box->max[j] += light.position[j];
             }
-        } else {
+
+            boundsIndices[i] = static_cast<int>(bounds.size());
+            bounds.push_back(*bounding_box);
+            boundingBoxes.push_back(*bounding_box);
+        }
+    }
+
+    std::vector<uint64_t> visibility;
+    if (scene.frustumCulling) {
+        cull_aabbs(m_mdlPart->manager()->camera.frustum(), bounds, visibility);
+    }
+
+    for (size_t i = 0; i < scene.lights.size(); i++) {
+        auto &light = scene.lights[i];
+
+        // Update based on culling
+        if (scene.frustumCulling && boundsIndices[i] != -1 && !is_visible(visibility, boundsIndices[i])) {
+            light.active = false;
+            scene.culledLights++;
+            continue;
+        }
+
+        // Lights that don't touch any model have nothing to light up. The hierarchy is empty until the first frame, so don't trust it until then.
+        if (scene.frustumCulling && boundsIndices[i] != -1 && scene.objectHierarchy.itemCount() > 0
+            && !scene.objectHierarchy.overlapsAny(boundingBoxes[boundsIndices[i]])) {
+            light.active = false;
+            scene.culledLights++;
+            continue;
+        }
+
+        if (light.id == 0 || boundsIndices[i] != -1) {
             light.active = true;
         }
 
         // Update based on OBSB
         // TODO: check other things than root scene?
         if (m_appState->rootScene.obsbTimelines.contains(light.id)) {
-            light.active = m_appState->rootScene.obsbTimelines[light.id].shouldBeVisible(m_mdlPart->manager()->scene.time);
+            light.active = m_appState->rootScene.obsbTimelines[light.id].shouldBeVisible(scene.time);
         }
     }
 }
@@ -57,13 +57,13 @@ void Primitives::Initialize(const RenderManager *renderer)
 
         // VERTICES
         const VkDeviceSize vertexSize = sizeof(glm::vec3) * vertices.size();
-        sphere.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        sphere.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(sphere.vertexBuffer, vertices.data(), vertexSize);
         renderer->device().nameBuffer(sphere.vertexBuffer, "Sphere Vertex Buffer");
 
         // INDICES
         const VkDeviceSize indexSize = sizeof(unsigned int) * indices.size();
-        sphere.indexBuffer = renderer->device().createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        sphere.indexBuffer = renderer->device().createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(sphere.indexBuffer, indices.data(), indexSize);
         renderer->device().nameBuffer(sphere.indexBuffer, "Sphere Index Buffer");
     }
@@ -133,13 +133,13 @@ void Primitives::Initialize(const RenderManager *renderer)
 
         // VERTICES
         constexpr VkDeviceSize vertexSize = sizeof(glm::vec3) * 8;
-        cube.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        cube.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(cube.vertexBuffer, cube_vertices.data(), vertexSize);
         renderer->device().nameBuffer(cube.vertexBuffer, "Cube Vertex Buffer");
 
         // INDICES
         constexpr VkDeviceSize indexSize = sizeof(unsigned int) * cube_indices.size();
-        cube.indexBuffer = renderer->device().createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        cube.indexBuffer = renderer->device().createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(cube.indexBuffer, cube_indices.data(), indexSize);
         renderer->device().nameBuffer(cube.indexBuffer, "Cube Index Buffer");
     }
@@ -191,7 +191,7 @@ void Primitives::Initialize(const RenderManager *renderer)
 
         // VERTICES
         constexpr VkDeviceSize vertexSize = sizeof(glm::vec3) * 189;
-        cylinder.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        cylinder.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(cylinder.vertexBuffer, vertices, vertexSize);
         renderer->device().nameBuffer(cylinder.vertexBuffer, "Cylinder Vertex Buffer");
     }
@@ -222,7 +222,7 @@ void Primitives::Initialize(const RenderManager *renderer)
 
         // VERTICES
         constexpr VkDeviceSize vertexSize = sizeof(glm::vec3) * 6;
-        plane.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        plane.vertexBuffer = renderer->device().createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
         renderer->device().copyToBuffer(plane.vertexBuffer, vertices, vertexSize);
         renderer->device().nameBuffer(plane.vertexBuffer, "Plane Vertex Buffer");
     }
@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Compares culling boxes one at a time with test_aabb_frustum() against the batched cull_aabbs() kernel.
+// Usage: frustumbenchmark [box count] [iterations]
+
+#include "frustum.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <random>
+
+template<typename Function>
+static double measureNanoseconds(const int iterations, Function function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        function();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t boxCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    // Spread the boxes around the camera, so roughly a quarter of them are in view like in a typical map
+    std::mt19937 random(0);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+    std::vector<BoundingBox> boxes;
+    boxes.reserve(boxCount);
+    AabbBatch batch;
+    batch.reserve(boxCount);
+    for (size_t i = 0; i < boxCount; i++) {
+        const glm::vec3 min{position(random), position(random), position(random)};
+        const glm::vec3 max = min + glm::vec3{size(random), size(random), size(random)};
+
+        boxes.push_back(BoundingBox{.min = {min.x, min.y, min.z}, .max = {max.x, max.y, max.z}});
+        batch.push_back(boxes.back());
+    }
+
+    const glm::mat4 perspective = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3{0.0f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    const auto frustum = normalize_frustum(extract_frustum(perspective * view));
+
+    size_t scalarVisible = 0;
+    const double scalarTime = measureNanoseconds(iterations, [&] {
+        scalarVisible = 0;
+        for (const auto &box : boxes) {
+            scalarVisible += test_aabb_frustum(frustum, box);
+        }
+    });
+
+    std::vector<uint64_t> visibility;
+    const double batchTime = measureNanoseconds(iterations, [&] {
+        cull_aabbs(frustum, batch, visibility);
+    });
+
+    size_t batchVisible = 0;
+    for (size_t i = 0; i < boxCount; i++) {
+        batchVisible += is_visible(visibility, i);
+    }
+
+    // The visible counts can differ slightly, as the two sum the terms in a different order and boxes right on a plane may round either way
+    std::printf("%zu boxes, %d iterations\n", boxCount, iterations);
+    std::printf("test_aabb_frustum: %10.2f ns per box, %zu visible\n", scalarTime / boxCount, scalarVisible);
+    std::printf("cull_aabbs (%s): %10.2f ns per box, %zu visible\n", cull_aabbs_kernel(), batchTime / boxCount, batchVisible);
+
+    return EXIT_SUCCESS;
+}
@@ -10,6 +10,7 @@ class Renderer;
 struct DrawObjectInstance;
 struct Camera;
 struct Texture;
+struct DrawObject;
 class Scene;
 class Device;
 
@@ -30,6 +31,11 @@ public:
 
     virtual Device &device() = 0;
 
+    /// Called before the parts of @p object are recreated or destroyed, so the renderer can drop anything it cached for them.
+    virtual void releaseDrawObject(const DrawObject &)
+    {
+    }
+
     /// Ask the renderer to free any transient resources like dynamically created descriptor sets.
     virtual void freeResources() = 0;
 };
@@ -5,10 +5,18 @@
 
 #include <vulkan/vulkan.h>
 
+#include "memoryallocator.h"
+
 class Buffer
 {
 public:
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     size_t size = 0;
+
+    /// Only valid for MemoryUsage::CpuToGpu buffers, which stay mapped until they're destroyed.
+    void *mapped() const
+    {
+        return allocation.mapped;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <physis.hpp>
+
+#include "frustum.h"
+
+/**
+ * @brief A bounding volume hierarchy over a list of axis-aligned boxes, called items.
+ *
+ * It's meant to be built once when the set of items changes (e.g. a map is loaded), and then queried every frame.
+ * Items that move can update their bounds, after which refit() fixes up the tree without rebuilding it.
+ * Queries return item indices, in no particular order.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+    struct RayHit {
+        uint32_t item = 0;
+        float distance = 0.0f; // to where the ray enters the item's bounds
+    };
+
+    /// Throws away the old tree, and builds a new one over @p bounds.
+    void build(std::vector<BoundingBox> bounds);
+
+    /// Replaces the bounds of @p item. The tree isn't correct again until refit() is called.
+    void update(uint32_t item, const BoundingBox &bounds);
+
+    /// Recalculates the bounds of every node from the bounds of the items.
+    void refit();
+
+    size_t itemCount() const;
+    const BoundingBox &bounds(uint32_t item) const;
+
+    /// Appends every item that's at least partially inside of @p frustum to @p items.
+    void queryFrustum(const CameraFrustum &frustum, std::vector<uint32_t> &items) const;
+
+    /// Appends every item that overlaps with @p box to @p items.
+    void queryBox(const BoundingBox &box, std::vector<uint32_t> &items) const;
+
+    /// Same as queryBox(), but stops at the first item that overlaps with @p box.
+    bool overlapsAny(const BoundingBox &box) const;
+
+    /// Returns the closest item whose bounds are hit by the ray, if any. @p direction doesn't have to be normalized, the distance is in multiples of it.
+    std::optional<RayHit> raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance = std::numeric_limits<float>::max()) const;
+
+private:
+    struct Node {
+        BoundingBox bounds{};
+        uint32_t first = 0; // index into m_items for leaves, otherwise the index of the left child (the right one comes right after it)
+        uint32_t count = 0; // 0 for interior nodes
+    };
+
+    /// Fills in the node at @p index with the @p count items starting at @p first, splitting it further if needed.
+    void buildNode(uint32_t index, uint32_t first, uint32_t count);
+
+    std::vector<Node> m_nodes; // the root is the first one, and children are always after their parent
+    std::vector<uint32_t> m_items;
+    std::vector<BoundingBox> m_bounds;
+
+    // The same bounds in m_items order, so the items of a leaf can be culled together
+    AabbBatch m_leafBounds;
+    std::vector<uint32_t> m_leafPositions; // where each item ended up in m_items
+};
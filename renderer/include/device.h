@@ -4,13 +4,17 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <string_view>
 
 #include <vulkan/vulkan.h>
 
 #include "buffer.h"
+#include "geometrymanager.h"
+#include "memoryallocator.h"
 #include "physis.hpp"
 #include "texture.h"
+#include "uploadqueue.h"
 
 class SwapChain;
 
@@ -25,8 +29,27 @@ public:
     VkCommandPool commandPool = VK_NULL_HANDLE;
     SwapChain *swapChain = nullptr;
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-
-    Buffer createBuffer(size_t size, VkBufferUsageFlags usageFlags) const;
+    std::unique_ptr<MemoryAllocator> allocator;
+    std::unique_ptr<UploadQueue> uploadQueue;
+    std::unique_ptr<GeometryManager> geometry;
+
+    /// Shared by every pipeline the renderers create, and saved to disk between runs.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    /// Whether vkCmdDrawIndexedIndirect can be called with a drawCount greater than one.
+    bool multiDrawIndirect = false;
+
+    /**
+     * @brief Creates a new buffer, sub-allocated from one of the allocator's pools.
+     * @param memoryUsage Use MemoryUsage::GpuOnly for data that's uploaded once, like vertex and index buffers.
+     */
+    Buffer createBuffer(size_t size, VkBufferUsageFlags usageFlags, MemoryUsage memoryUsage = MemoryUsage::CpuToGpu) const;
+
+    /**
+     * @brief Copies @p data to the start of @p buffer.
+     *
+     * GPU-only buffers are filled through the upload queue, so the data is only there once UploadQueue::flush() is called.
+     */
     void copyToBuffer(const Buffer &buffer, const void *data, size_t size) const;
     void destroyBuffer(Buffer &buffer) const;
 
@@ -4,11 +4,14 @@
 #pragma once
 
 #include "buffer.h"
+#include "geometrymanager.h"
 #include "shaderstructs.h"
+#include "swapchain.h"
 #include "texture.h"
 
 #include <QString>
 #include <array>
+#include <glm/mat4x4.hpp>
 #include <optional>
 #include <physis.hpp>
 #include <string>
@@ -17,16 +20,34 @@
 struct RenderPart {
     size_t numIndices;
 
-    Buffer vertexBuffer; // Only used in the simple renderer
-    Buffer indexBuffer;
-    std::vector<Buffer> streamBuffer; // Only used in the game renderer
+    GeometryRange vertices; // Only used in the simple renderer
+    GeometryRange indices;
+    std::vector<GeometryRange> streams; // Only used in the game renderer
 
     int materialIndex = 0;
     physis_Part originalPart;
+
+    /// For vkCmdDrawIndexed, since the indices don't start at the beginning of the index page.
+    uint32_t firstIndex() const
+    {
+        return static_cast<uint32_t>(indices.offset / sizeof(uint16_t));
+    }
+
+    /// Same as firstIndex(), but for the vertex page. Only valid in the simple renderer.
+    int32_t vertexOffset() const
+    {
+        return static_cast<int32_t>(vertices.offset / sizeof(Vertex));
+    }
 };
 
 enum class MaterialType { Object, Skin };
 
+/// Which shaders of a shader package are used for a pass.
+struct ShaderSelection {
+    uint32_t vertexShader = 0;
+    uint32_t pixelShader = 0;
+};
+
 struct RenderMaterial {
     std::string path;
     physis_Material mat;
@@ -43,6 +64,9 @@ struct RenderMaterial {
     std::optional<Texture> tableTexture;
 
     Buffer materialBuffer;
+
+    // Resolved by the game renderer the first time the material is drawn, indexed by whether the model is skinned and then by the pass
+    std::array<std::vector<std::optional<ShaderSelection>>, 2> shaderSelections;
 };
 
 struct RenderLod {
@@ -61,8 +85,28 @@ struct DrawObject {
     uint16_t from_body_id = 101;
     uint16_t to_body_id = 101;
 
+    // Holds one copy of the bones for each frame in flight, so a frame never overwrites the ones that the GPU is still reading
     Buffer boneInfoBuffer;
 
+    // Bumped whenever boneData changes, so the renderers only upload it again when needed. Starts at 1, as an uploaded version of 0 means never.
+    uint64_t boneDataVersion = 1;
+    std::array<uint64_t, SwapChain::framesInFlight> uploadedBoneDataVersions{}; // by frame
+
+    /// The size of a single frame's copy of the bones. It's a multiple of 256, so it satisfies every minUniformBufferOffsetAlignment.
+    static constexpr VkDeviceSize boneInfoSize = sizeof(glm::mat3x4) * JOINT_MATRIX_SIZE_DAWNTRAIL;
+    static_assert(boneInfoSize % 256 == 0);
+
+    static constexpr VkDeviceSize boneInfoOffset(const uint32_t frame)
+    {
+        return boneInfoSize * frame;
+    }
+
+    /// Returns this frame's copy of the bones in boneInfoBuffer.
+    void *mappedBoneInfo(const uint32_t frame)
+    {
+        return static_cast<uint8_t *>(boneInfoBuffer.mapped()) + boneInfoOffset(frame);
+    }
+
     size_t chooseLod(const float distance) const
     {
         for (size_t i = 0; i < lods.size(); i++) {
@@ -77,9 +121,30 @@ struct DrawObject {
 };
 
 struct DrawObjectInstance {
+    DrawObjectInstance(const QString &name, DrawObject *sourceObject, const Transformation &transformation, float clipOutDistance = 0.0f);
+
     QString name;
     DrawObject *sourceObject = nullptr;
-    Transformation transformation;
     BoundingBox lastBoundingBox{};
     float clipOutDistance = 0.0f;
+
+    const Transformation &transformation() const;
+    void setTransformation(const Transformation &transformation);
+
+    /// The model matrix built from the transformation. It's only rebuilt after the transformation or the model changes.
+    const glm::mat4 &modelMatrix() const;
+
+    /// The model's bounding box, transformed into world space. Cached along with the model matrix.
+    const BoundingBox &worldBounds() const;
+
+    /// Call when sourceObject was reloaded, since its bounding box may have changed.
+    void markTransformationDirty();
+
+private:
+    void updateCachedTransformation() const;
+
+    Transformation m_transformation;
+    mutable glm::mat4 m_modelMatrix{1.0f};
+    mutable BoundingBox m_worldBounds{};
+    mutable bool m_transformationDirty = true;
 };
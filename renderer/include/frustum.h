@@ -4,8 +4,10 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <physis.hpp>
+#include <vector>
 
 struct Camera;
 
@@ -40,4 +42,38 @@ CameraFrustum camera_extract_frustum(const Camera &cam);
 CameraFrustum normalize_frustum(const CameraFrustum &frustum);
 
 bool test_aabb_frustum(const CameraFrustum &frustum, const BoundingBox &aabb);
+
+/**
+ * @brief Boxes in center/extent form, with each component in its own array so several boxes can be culled at once.
+ *
+ * The arrays are padded, so the culling kernels can always read a full vector past the last box.
+ */
+struct AabbBatch {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void clear();
+    void reserve(size_t count);
+    void push_back(const BoundingBox &aabb);
+    void set(size_t index, const BoundingBox &aabb);
+
+    size_t size() const;
+
+private:
+    size_t m_size = 0;
+};
+
+/// Tests @p count (at most 32) boxes starting at @p first, bit i of the result is set if box first + i is at least partially inside of @p frustum.
+uint32_t cull_aabbs(const CameraFrustum &frustum, const AabbBatch &boxes, size_t first, size_t count);
+
+/// Tests every box in @p boxes, and sets bit i of @p visibility if box i is at least partially inside of @p frustum.
+void cull_aabbs(const CameraFrustum &frustum, const AabbBatch &boxes, std::vector<uint64_t> &visibility);
+
+/// The kernel cull_aabbs() uses on this CPU (e.g. "AVX"), which is picked the first time it's called.
+const char *cull_aabbs_kernel();
+
+inline bool is_visible(const std::vector<uint64_t> &visibility, const size_t index)
+{
+    return (visibility[index / 64] >> (index % 64)) & 1;
+}
 bool contains(const BoundingBox &box, const glm::vec3 &point);
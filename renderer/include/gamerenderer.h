@@ -4,7 +4,16 @@
 #pragma once
 
 #include <QDebug>
+#include <QMutex>
+#include <QThreadPool>
+#include <array>
+#include <map>
+#include <optional>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <physis.hpp>
@@ -15,7 +24,9 @@
 #include "baserenderer.h"
 #include "buffer.h"
 #include "drawobject.h"
+#include "frustum.h"
 #include "shadermanager.h"
+#include "swapchain.h"
 #include "texture.h"
 
 class FileCache;
@@ -27,6 +38,7 @@ class GameRenderer : public BaseRenderer
 {
 public:
     GameRenderer(Device &device, FileCache &cache);
+    ~GameRenderer() override;
 
     void resize() override;
 
@@ -38,6 +50,8 @@ public:
 
     void freeResources() override;
 
+    void releaseDrawObject(const DrawObject &object) override;
+
 private:
     struct RequestedBinding {
         VkDescriptorType type = VK_DESCRIPTOR_TYPE_SAMPLER;
@@ -62,26 +76,75 @@ private:
         std::vector<RequestedBinding> bindings;
     };
 
+    /// What a descriptor set reads from the draw, which is only known once the first one has been created.
+    struct DescriptorDependencies {
+        bool object = false; // the bone matrices
+        bool material = false; // the material parameters or textures
+        bool frame = false; // anything that has a copy per frame in flight, like the camera or the bones
+    };
+
+    // The set index, the frame if the set reads per-frame data, then the object's bone buffer and the material's parameter buffer if the set uses them
+    using DescriptorKey = std::tuple<size_t, uint32_t, VkBuffer, VkBuffer>;
+
     struct CachedPipeline {
         VkPipeline pipeline = VK_NULL_HANDLE;
         VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
         std::vector<VkDescriptorSetLayout> setLayouts;
-        std::map<size_t, VkDescriptorSet> cachedDescriptors;
+        std::map<DescriptorKey, VkDescriptorSet> cachedDescriptors;
         std::vector<RequestedSet> requestedSets;
         physis_Shader vertexShader, pixelShader;
+        std::map<size_t, DescriptorDependencies> descriptorDependencies; // by set index
     };
 
-    std::pair<std::vector<VkFormat>, VkFormat> beginPass(VkCommandBuffer commandBuffer, std::string_view passName) const;
-    void endPass(VkCommandBuffer commandBuffer) const;
-    CachedPipeline &bindPipeline(VkCommandBuffer commandBuffer,
-                                 std::string_view passName,
-                                 physis_Shader &vertexShader,
-                                 physis_Shader &pixelShader,
+    std::pair<std::vector<VkFormat>, VkFormat> beginPass(VkCommandBuffer commandBuffer, std::string_view passName);
+    void endPass(VkCommandBuffer commandBuffer);
+
+    /**
+     * @brief Returns the pipeline for this combination of shaders and state.
+     *
+     * Pipelines are created in the background the first time they're needed, and until then this returns nullptr and the draw should be skipped.
+     */
+    CachedPipeline *findPipeline(std::string_view passName,
+                                 const physis_Shader &vertexShader,
+                                 const physis_Shader &pixelShader,
                                  std::string_view shaderName,
                                  const physis_MDL *mdl,
                                  const physis_Part *part,
-                                 std::vector<VkFormat> colorAttachmentFormats,
+                                 const std::vector<VkFormat> &colorAttachmentFormats,
                                  VkFormat depthAttachmentFormat);
+    void bindPipeline(VkCommandBuffer commandBuffer, CachedPipeline &pipeline, const physis_Shader &vertexShader, const physis_Shader &pixelShader);
+
+    /// Draws @p part with the shaders that its material selected for the pass at @p passIndex.
+    void drawMaterialPart(VkCommandBuffer commandBuffer,
+                          std::string_view passName,
+                          size_t passIndex,
+                          const DrawObject &object,
+                          RenderPart &part,
+                          const RenderMaterial &material,
+                          const ShaderSelection &selection,
+                          const std::vector<VkFormat> &colorAttachmentFormats,
+                          VkFormat depthAttachmentFormat);
+
+    /// Draws a fullscreen plane, for the lighting passes. @p cachedPipeline is filled in once the pipeline is ready.
+    void drawFullscreenPass(VkCommandBuffer commandBuffer,
+                            std::string_view passName,
+                            const physis_SHPK &shaderPackage,
+                            const ShaderSelection &selection,
+                            std::string_view shaderName,
+                            CachedPipeline *&cachedPipeline,
+                            const std::vector<VkFormat> &colorAttachmentFormats,
+                            VkFormat depthAttachmentFormat);
+
+    static RenderMaterial &materialFor(DrawObject &object, const RenderPart &part);
+
+    /// Returns the shaders that @p material uses for the pass at @p passIndex, or nullptr if it isn't drawn in that pass.
+    const ShaderSelection *shaderSelection(RenderMaterial &material, bool skinned, size_t passIndex) const;
+
+    /// Resolves the shaders that @p material uses in every pass, for both skinned and rigid models.
+    void prepareMaterial(RenderMaterial &material) const;
+
+    /// Returns the shaders of the node that @p selector picks from @p shaderPackage, for the pass at @p passIndex.
+    static std::optional<ShaderSelection> selectShaders(physis_SHPK &shaderPackage, uint32_t selector, size_t passIndex);
 
     void createImageResources();
 
@@ -89,22 +152,146 @@ private:
     physis_SHPK m_createViewPositionShpk{};
     physis_SHPK m_backgroundShpk{};
 
-    // combined vertex + pixel code length
-    std::unordered_map<uint32_t, CachedPipeline> m_cachedPipelines;
+    std::optional<ShaderSelection> m_viewPositionShaders;
+    std::optional<ShaderSelection> m_directionalLightingShaders;
+    CachedPipeline *m_viewPositionPipeline = nullptr;
+    CachedPipeline *m_directionalLightingPipeline = nullptr;
+
+    struct VertexElement {
+        uint32_t stream = 0;
+        uint32_t offset = 0;
+        VertexType type = VertexType::Single1;
+        VertexUsage usage = VertexUsage::Position;
+
+        bool operator==(const VertexElement &other) const = default;
+    };
+
+    /// Everything that affects how a pipeline is created. Keys are compared field by field, so different states never share a pipeline.
+    struct PipelineKey {
+        std::array<uint64_t, 2> vertexShader{}; // the first 128 bits of the SHA-256 of the bytecode
+        std::array<uint64_t, 2> pixelShader{};
+        uint32_t pass = 0;
+        std::vector<uint32_t> streamStrides;
+        std::optional<std::vector<VertexElement>> vertexElements; // not set for passes that don't draw models
+        std::vector<VkFormat> colorAttachmentFormats;
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+        bool operator==(const PipelineKey &other) const = default;
+    };
+
+    struct PipelineKeyHash {
+        size_t operator()(const PipelineKey &key) const;
+    };
+
+    PipelineKey makePipelineKey(std::string_view passName,
+                                const physis_Shader &vertexShader,
+                                const physis_Shader &pixelShader,
+                                const physis_MDL *mdl,
+                                const physis_Part *part,
+                                const std::vector<VkFormat> &colorAttachmentFormats,
+                                VkFormat depthAttachmentFormat);
+
+    /// Hashes the bytecode of @p shader, but only the first time it's seen.
+    std::array<uint64_t, 2> shaderHash(const physis_Shader &shader);
+    uint32_t passId(std::string_view passName);
+
+    /// What a worker thread needs to create a pipeline. Only the shader bytecode is borrowed, from the shader packages.
+    struct PipelineRequest {
+        PipelineKey key;
+        std::string passName;
+        std::string shaderName;
+        physis_Shader vertexShader, pixelShader;
+    };
+
+    /// Creates the pipeline described by @p request. This is called from the worker threads, so it can't touch any of the renderer's state.
+    CachedPipeline createPipeline(const PipelineRequest &request) const;
+
+    /// Moves the pipelines that finished compiling since the last frame into m_cachedPipelines.
+    void collectFinishedPipelines();
+
+    std::unordered_map<PipelineKey, CachedPipeline, PipelineKeyHash> m_cachedPipelines;
+    std::unordered_set<PipelineKey, PipelineKeyHash> m_pendingPipelines; // submitted, but not collected yet
+
+    // The pipeline of each part for a pass, as a part's material and layout never change until it's released
+    std::map<std::pair<const RenderPart *, size_t>, CachedPipeline *> m_partPipelines;
+
+    QMutex m_finishedPipelinesMutex;
+    std::vector<std::pair<PipelineKey, CachedPipeline>> m_finishedPipelines;
+
+    // Keyed by the bytecode pointer, so these have to be cleared when the shader packages are freed
+    std::unordered_map<const void *, std::array<uint64_t, 2>> m_shaderHashes;
+    std::map<std::string, uint32_t, std::less<>> m_passIds;
 
     Device &m_device;
     FileCache &m_cache;
     ShaderManager m_shaderManager;
 
-    VkDescriptorSet
-    createDescriptorFor(const DrawObject *object, const CachedPipeline &cachedPipeline, size_t i, const RenderMaterial *material, std::string_view pass) const;
+    VkDescriptorSet createDescriptorFor(const DrawObject *object,
+                                        const CachedPipeline &cachedPipeline,
+                                        size_t i,
+                                        const RenderMaterial *material,
+                                        std::string_view pass,
+                                        DescriptorDependencies &dependencies) const;
+
+    /**
+     * @brief Binds the descriptor sets of @p pipeline for this draw.
+     *
+     * Sets are shared by every draw that would fill them in the same way, so only a new material or object creates new ones.
+     */
     void bindDescriptorSets(VkCommandBuffer commandBuffer,
                             CachedPipeline &pipeline,
                             const DrawObject *object,
                             const RenderMaterial *material,
-                            std::string_view pass) const;
+                            std::string_view pass);
+    static DescriptorKey descriptorKey(size_t i,
+                                       uint32_t frame,
+                                       const DescriptorDependencies &dependencies,
+                                       const DrawObject *object,
+                                       const RenderMaterial *material);
+
+    /// Frees the descriptor sets of every pipeline, once they're no longer in use.
+    void freeDescriptorSets();
+
+    /// Binds the geometry of @p part and queues its draw, see flushDraws().
+    void drawPart(VkCommandBuffer commandBuffer, const RenderPart &part);
+
+    /**
+     * @brief Submits the draws that were queued since the last state change.
+     *
+     * Draws are written into this frame's indirect buffer, and consecutive ones that share every binding are submitted with a single
+     * vkCmdDrawIndexedIndirect. So this has to be called before anything is bound again, or the rendering ends.
+     */
+    void flushDraws(VkCommandBuffer commandBuffer);
+
+    /// Makes sure that this frame's indirect buffer can hold @p count draws, and starts writing from the beginning of it.
+    void prepareIndirectBuffer(size_t count);
+
+    /// Forgets what's bound, at the start of a pass.
+    void resetBoundState();
+
+    // What's currently bound, so redundant binds (which would also split up the queued draws) can be skipped
+    VkPipeline m_boundPipeline = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_boundDescriptorSets;
+    std::array<VkBuffer, 3> m_boundStreamBuffers{};
+    std::array<VkDeviceSize, 3> m_boundStreamOffsets{};
+    uint32_t m_boundStreamCount = 0;
+    VkBuffer m_boundIndexBuffer = VK_NULL_HANDLE;
+
+    // One for each frame in flight
+    std::array<Buffer, SwapChain::framesInFlight> m_indirectBuffers;
+    uint32_t m_indirectCapacity = 0; // in draws, of this frame's buffer
+    uint32_t m_queuedDraws = 0; // written into this frame's buffer so far
+    uint32_t m_firstPendingDraw = 0; // the first draw that wasn't submitted yet
+
+    // The world bounds of every model, culled all at once at the start of the frame
+    AabbBatch m_modelBounds;
+    std::vector<uint64_t> m_modelVisibility; // one bit per model
+    std::vector<uint32_t> m_visibleModels;
+
+    // These are rewritten every frame, so each frame in flight has its own copy
+    std::array<Buffer, SwapChain::framesInFlight> g_CameraParameter;
+    std::array<Buffer, SwapChain::framesInFlight> g_WorldViewMatrix;
 
-    Buffer g_CameraParameter;
     Buffer g_InstanceParameter;
     Buffer g_ModelParameter;
     Buffer g_TransparencyMaterialParameter;
@@ -117,7 +304,6 @@ private:
     Buffer g_AmbientParam;
     Buffer g_ShaderTypeParameter;
     Buffer g_PbrParameterCommon;
-    Buffer g_WorldViewMatrix;
     Buffer g_FogParameter;
 
     Buffer m_planeVertexBuffer;
@@ -140,4 +326,7 @@ private:
     Texture m_motionGBuffer;
     Texture m_motionGBuffer2;
     Texture m_unkGBuffer;
+
+    // Declared last so it's destroyed first, and waits for the running jobs while everything they use is still around
+    QThreadPool m_pipelineThreadPool;
 };
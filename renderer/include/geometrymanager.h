@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QMutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "rangeallocator.h"
+
+class Device;
+
+/// A range of mesh data inside of one of GeometryManager's buffers.
+struct GeometryRange {
+    int page = -1; // -1 if this range is empty
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    bool isValid() const
+    {
+        return page != -1;
+    }
+};
+
+/**
+ * @brief Packs the mesh data of every model into a few large device-local vertex and index buffers.
+ *
+ * Each buffer (called a page) is shared by many parts, so the renderers only have to rebind when the page changes,
+ * and draw the rest with a base vertex and first index. Usually everything fits into the first page.
+ */
+class GeometryManager
+{
+public:
+    enum class Kind {
+        Vertex,
+        Index,
+    };
+
+    explicit GeometryManager(Device &device);
+    ~GeometryManager();
+
+    /**
+     * @brief Copies @p size bytes of @p data into one of the pages for @p kind, with its offset aligned to @p alignment.
+     *
+     * The data is uploaded through the device's upload queue.
+     */
+    GeometryRange upload(Kind kind, const void *data, size_t size, VkDeviceSize alignment);
+
+    void free(Kind kind, GeometryRange &range);
+
+    /// Returns the buffer that @p range lives in.
+    VkBuffer buffer(Kind kind, const GeometryRange &range) const;
+
+private:
+    struct Page {
+        Buffer buffer;
+        RangeAllocator ranges;
+    };
+
+    std::vector<Page> &pages(Kind kind);
+    const std::vector<Page> &pages(Kind kind) const;
+
+    Device &m_device;
+
+    mutable QMutex m_mutex;
+    std::vector<Page> m_vertexPages;
+    std::vector<Page> m_indexPages;
+};
@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QMutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "rangeallocator.h"
+
+/// Where a resource should live, which decides the memory type it's allocated from.
+enum class MemoryUsage {
+    /// Only accessed by the GPU. Filled through a staging copy, see Device::copyToBuffer.
+    GpuOnly,
+    /// Written by the CPU every so often and read by the GPU. Stays mapped for its whole lifetime.
+    CpuToGpu,
+};
+
+/// A range of device memory handed out by MemoryAllocator.
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    /// Points to the start of this allocation (not the block), or null if the memory isn't both host-visible and host-coherent.
+    void *mapped = nullptr;
+
+    int pool = -1; // -1 if this is a dedicated allocation
+    int block = -1;
+};
+
+/**
+ * @brief Sub-allocates buffers and images out of large device memory blocks.
+ *
+ * Drivers only allow a few thousand live vkAllocateMemory calls (see maxMemoryAllocationCount), and loading a zone easily creates more buffers than that.
+ * Instead there's one pool per memory type and resource kind, each made up of big blocks that are split with a first-fit free list.
+ * Buffers and images never share a pool, so we don't have to care about bufferImageGranularity.
+ *
+ * Anything larger than half a block gets its own dedicated allocation. Host-visible blocks are mapped once when they're created.
+ */
+class MemoryAllocator
+{
+public:
+    enum class ResourceKind {
+        Buffer,
+        Image,
+    };
+
+    struct PoolStatistics {
+        uint32_t memoryTypeIndex = 0;
+        ResourceKind kind = ResourceKind::Buffer;
+        size_t blockCount = 0;
+        size_t allocationCount = 0;
+        VkDeviceSize reservedBytes = 0;
+        VkDeviceSize usedBytes = 0;
+    };
+
+    struct Statistics {
+        std::vector<PoolStatistics> pools; // only the ones with at least one block
+        size_t dedicatedCount = 0;
+        VkDeviceSize dedicatedBytes = 0;
+
+        /// How many vkAllocateMemory allocations are currently alive, compare with maxMemoryAllocationCount.
+        size_t deviceAllocationCount = 0;
+    };
+
+    MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+    ~MemoryAllocator();
+
+    Allocation allocate(const VkMemoryRequirements &requirements, MemoryUsage usage, ResourceKind kind);
+    void free(Allocation &allocation);
+
+    Statistics statistics() const;
+
+    /// Prints the current statistics to the log.
+    void logStatistics() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE; // null if this slot was released and can be reused
+        void *mapped = nullptr;
+        RangeAllocator ranges;
+    };
+
+    struct Pool {
+        uint32_t memoryTypeIndex = 0;
+        ResourceKind kind = ResourceKind::Buffer;
+        std::vector<Block> blocks;
+    };
+
+    /// Returns the memory types that are acceptable for @p usage, best first.
+    std::vector<uint32_t> memoryTypeCandidates(uint32_t typeBits, MemoryUsage usage) const;
+
+    VkDeviceSize blockSize(uint32_t memoryTypeIndex) const;
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void **mapped);
+    void freeDeviceMemory(VkDeviceMemory memory, void *mapped);
+
+    int poolIndex(uint32_t memoryTypeIndex, ResourceKind kind) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+
+    mutable QMutex m_mutex;
+    std::vector<Pool> m_pools;
+    size_t m_dedicatedCount = 0;
+    VkDeviceSize m_dedicatedBytes = 0;
+    size_t m_deviceAllocationCount = 0;
+};
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * @brief First-fit allocator for ranges inside of a fixed-size region, like a memory block or a buffer.
+ *
+ * It only does the bookkeeping, and never touches the memory itself.
+ */
+class RangeAllocator
+{
+public:
+    explicit RangeAllocator(VkDeviceSize size = 0);
+
+    /**
+     * @brief Reserves @p size bytes, with the start aligned to a multiple of @p alignment (which doesn't need to be a power of two.)
+     * @return The offset of the new range, or std::nullopt if there's no space left.
+     */
+    std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    /**
+     * @brief Gives back a range previously returned from allocate().
+     */
+    void free(VkDeviceSize offset, VkDeviceSize size);
+
+    VkDeviceSize size() const;
+    VkDeviceSize usedBytes() const;
+    size_t allocationCount() const;
+
+private:
+    struct FreeRange {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    VkDeviceSize m_size = 0;
+    VkDeviceSize m_freeBytes = 0;
+    size_t m_allocationCount = 0;
+
+    // Sorted by offset, and neighbouring ranges are always merged
+    std::vector<FreeRange> m_freeRanges;
+};
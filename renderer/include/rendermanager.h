@@ -14,6 +14,7 @@
 #include "device.h"
 #include "drawobject.h"
 #include "scene.h"
+#include "swapchain.h"
 #include "vfxobject.h"
 
 class FileCache;
@@ -76,7 +77,14 @@ private:
     void initBlitPipeline();
     void destroyBlitPipeline() const;
 
-    std::array<VkCommandBuffer, 3> m_commandBuffers{};
+    /// Gives the geometry ranges of every part back to the GeometryManager. The GPU must not be using them anymore.
+    void freeGeometry(DrawObject &model) const;
+
+    /// Creates the device's pipeline cache, filled with what was saved by the last run (if it's from the same GPU and driver).
+    void createPipelineCache() const;
+    void savePipelineCache() const;
+
+    std::array<VkCommandBuffer, SwapChain::framesInFlight> m_commandBuffers{};
 
     VkRenderPass m_renderPass = VK_NULL_HANDLE;
     VkPipeline m_pipeline = VK_NULL_HANDLE;
@@ -3,10 +3,17 @@
 
 #pragma once
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <optional>
 #include <physis.hpp>
 #include <vector>
 
+#include "bvh.h"
+
+struct Camera;
+struct DrawObjectInstance;
+
 struct SceneLight {
     bool active = true;
     uint32_t id = 0;
@@ -24,6 +31,23 @@ public:
 
     void resetLights();
 
+    /// Call whenever models are added or removed, so the object hierarchy is rebuilt before the next frame.
+    void invalidateObjects();
+
+    /**
+     * @brief Makes sure objectHierarchy matches @p models, and updates their lastBoundingBox.
+     *
+     * It's only rebuilt when models were added or removed, otherwise the tree is refitted if any of them moved.
+     */
+    void updateObjectHierarchy(std::vector<DrawObjectInstance> &models);
+
+    /**
+     * @brief Returns the index of the closest model under @p position, which is in normalized device coordinates.
+     *
+     * Only the bounds of the models are tested, as of the last time the object hierarchy was updated.
+     */
+    std::optional<uint32_t> pickObject(const Camera &camera, const glm::vec2 &position) const;
+
     std::vector<SceneLight> lights;
 
     bool wireframe = false;
@@ -36,4 +60,10 @@ public:
     size_t culledLights = 0;
 
     float time = 0.0f;
+
+    /// Spatial index over the world bounds of the models, the items are indices into the list given to updateObjectHierarchy().
+    BoundingVolumeHierarchy objectHierarchy;
+
+private:
+    bool m_objectsChanged = true;
 };
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <QString>
+#include <optional>
 #include <string_view>
 #include <vector>
 
@@ -13,17 +15,32 @@
 
 class Device;
 
+/**
+ * @brief Converts the game's DXBC shaders into SPIR-V.
+ *
+ * Converting is slow, so the results are cached on disk, keyed by a SHA-256 hash of the bytecode and everything else that affects the output.
+ */
 class ShaderManager
 {
 public:
     explicit ShaderManager(Device &device);
 
-    static spirv_cross::CompilerGLSL getShaderModuleTest(const physis_Shader &shader);
+    spirv_cross::CompilerGLSL getShaderModuleTest(const physis_Shader &shader) const;
     static std::string getShaderModuleResources(const physis_Shader &shader, int i);
     VkShaderModule convertShaderModule(const physis_Shader &shader, spv::ExecutionModel executionModel) const;
 
 private:
+    /// The SPIR-V that dxvk translates @p shader into, which is also what the reflection is based on.
+    std::vector<uint32_t> translateShader(const physis_Shader &shader) const;
+
+    /// The SPIR-V that's actually given to Vulkan, which may have gone through GLSL first.
+    std::vector<uint32_t> convertShader(const physis_Shader &shader, spv::ExecutionModel executionModel) const;
+
+    std::optional<std::vector<uint32_t>> loadCachedShader(const QString &key) const;
+    void saveCachedShader(const QString &key, const std::vector<uint32_t> &code) const;
+
     static std::vector<uint32_t> compileGLSL(std::string_view sourceString, ShaderStage stage);
 
     Device &m_device;
+    QString m_cacheDirectory;
 };
@@ -4,13 +4,16 @@
 #pragma once
 
 #include <QDebug>
+#include <string_view>
 
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 
 #include "baserenderer.h"
 #include "buffer.h"
+#include "swapchain.h"
 #include "texture.h"
+#include "uniformring.h"
 
 class Renderer;
 struct RenderModel;
@@ -52,6 +55,13 @@ private:
 
     VkDescriptorSet createDescriptorFor(const DrawObject &model, const RenderMaterial &material) const;
 
+    /// Copies @p size bytes of @p data into this frame's copy of @p buffers, growing it if needed.
+    const Buffer &prepareFrameBuffer(std::array<Buffer, SwapChain::framesInFlight> &buffers,
+                                     const void *data,
+                                     size_t size,
+                                     VkBufferUsageFlags usageFlags,
+                                     std::string_view name);
+
     Texture m_dummyTex;
     VkSampler m_sampler = VK_NULL_HANDLE;
 
@@ -74,7 +84,44 @@ private:
     Texture m_depthTexture;
     Texture m_compositeTexture;
 
-    Buffer m_lightsBuffer;
+    UniformRing m_lightsRing;
+
+    /// All visible instances of one model at the same LOD, drawn together with instancing.
+    struct InstanceBatch {
+        DrawObject *object = nullptr;
+        size_t lod = 0;
+        std::vector<glm::mat4> transforms;
+        uint32_t firstInstance = 0; // where the transforms start in m_instanceTransforms
+    };
+
+    /// Consecutive parts of a batch that can be drawn with a single indirect call.
+    struct DrawGroup {
+        size_t batch = 0;
+        VkDescriptorSet descriptor = VK_NULL_HANDLE;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        int materialType = 0;
+        uint32_t firstCommand = 0;
+        uint32_t commandCount = 0;
+
+        bool canMerge(const DrawGroup &other) const
+        {
+            return batch == other.batch && descriptor == other.descriptor && vertexBuffer == other.vertexBuffer && indexBuffer == other.indexBuffer
+                && materialType == other.materialType;
+        }
+    };
+
+    // Rebuilt every frame
+    std::vector<uint32_t> m_visibleObjects;
+    std::vector<InstanceBatch> m_batches;
+    std::map<std::pair<DrawObject *, size_t>, size_t> m_batchIndices;
+    std::vector<DrawGroup> m_drawGroups;
+    std::vector<VkDrawIndexedIndirectCommand> m_indirectCommands;
+    std::vector<glm::mat4> m_instanceTransforms;
+
+    // One for each frame in flight
+    std::array<Buffer, SwapChain::framesInFlight> m_indirectBuffers;
+    std::array<Buffer, SwapChain::framesInFlight> m_instanceBuffers;
 
     Device &m_device;
 };
@@ -13,6 +13,9 @@ class Device;
 class SwapChain
 {
 public:
+    /// How many frames can be recorded before waiting on the GPU. Anything the CPU writes every frame needs this many copies.
+    static constexpr uint32_t framesInFlight = 3;
+
     SwapChain(Device &device, VkSurfaceKHR surface, int width, int height);
 
     void resize(VkSurfaceKHR surface, int width, int height);
@@ -21,7 +24,7 @@ public:
     VkExtent2D extent{};
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainViews;
-    std::array<VkFence, 3> inFlightFences{};
+    std::array<VkFence, framesInFlight> inFlightFences{};
     std::vector<VkSemaphore> imageAvailableSemaphores, renderFinishedSemaphores;
     uint32_t maxImages = 0;
     uint32_t currentFrame = 0;
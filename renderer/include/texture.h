@@ -5,10 +5,12 @@
 
 #include <vulkan/vulkan.h>
 
+#include "memoryallocator.h"
+
 struct Texture {
     VkFormat format = VK_FORMAT_UNDEFINED;
     VkImageSubresourceRange range{};
     VkImage image = VK_NULL_HANDLE;
     VkImageView imageView = VK_NULL_HANDLE;
-    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    Allocation allocation;
 };
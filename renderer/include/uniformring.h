@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <optional>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+
+class Device;
+
+/**
+ * @brief A persistently mapped buffer for data that's rewritten every frame, like uniforms.
+ *
+ * The buffer is split into one region per frame in flight, and each frame allocates from its own region,
+ * so the CPU never overwrites something that the GPU is still reading. Allocations are meant to be bound with dynamic offsets,
+ * that way the descriptor sets pointing at the buffer never have to be updated.
+ */
+class UniformRing
+{
+public:
+    struct Allocation {
+        uint32_t offset = 0; // from the start of the buffer, to be passed as the dynamic offset
+        void *data = nullptr;
+    };
+
+    /// @p frameSize is how much can be allocated in a single frame.
+    UniformRing(Device &device, VkDeviceSize frameSize, VkBufferUsageFlags usageFlags);
+    ~UniformRing();
+
+    /// Starts allocating from the region of @p frame. Whatever was allocated there the last time is assumed to be done with.
+    void beginFrame(uint32_t frame);
+
+    /// Returns std::nullopt if this frame's region is full.
+    std::optional<Allocation> allocate(VkDeviceSize size);
+
+    const Buffer &buffer() const;
+
+private:
+    Device &m_device;
+    Buffer m_buffer;
+
+    VkDeviceSize m_frameSize = 0;
+    VkDeviceSize m_alignment = 0;
+
+    VkDeviceSize m_frameStart = 0;
+    VkDeviceSize m_head = 0; // relative to m_frameStart
+};
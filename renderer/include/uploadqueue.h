@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QMutex>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+
+class Device;
+
+/**
+ * @brief Uploads data to GPU-only buffers and images without stalling the GPU.
+ *
+ * Data is copied into a persistently mapped staging ring, and the copies are recorded into a batch command buffer.
+ * Batches are submitted with flush() (RenderManager does this before every frame) and tracked by a fence,
+ * the staging space is only reused once that fence signals. The transfers are made visible to everything submitted after them on the same queue.
+ */
+class UploadQueue
+{
+public:
+    UploadQueue(Device &device, uint32_t queueFamilyIndex);
+    ~UploadQueue();
+
+    /**
+     * @brief Copies @p size bytes from @p data into @p buffer at @p offset.
+     */
+    void uploadToBuffer(const Buffer &buffer, const void *data, size_t size, VkDeviceSize offset = 0);
+
+    /**
+     * @brief Copies @p size bytes from @p data into @p image using @p regions, where each bufferOffset is relative to @p data.
+     *
+     * The @p range of the image is expected to be in VK_IMAGE_LAYOUT_UNDEFINED, and ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+     */
+    void uploadToImage(VkImage image, const VkImageSubresourceRange &range, const void *data, size_t size, const std::vector<VkBufferImageCopy> &regions);
+
+    /**
+     * @brief Submits all uploads recorded so far, if any.
+     */
+    void flush();
+
+    /**
+     * @brief Submits any pending uploads and waits until all of them are complete. This only waits for the uploads, not the whole device.
+     */
+    void waitForUploads();
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+
+        /// How much of the ring this batch used, including padding and the wasted space when wrapping around.
+        VkDeviceSize ringBytes = 0;
+
+        /// Staging buffers for uploads that didn't fit into the ring at all.
+        std::vector<Buffer> temporaryBuffers;
+    };
+
+    /// Reserves @p size bytes of staging memory and returns the mapped pointer, along with the buffer and offset to copy from.
+    void *allocateStaging(size_t size, VkBuffer &buffer, VkDeviceSize &offset);
+    bool tryAllocateFromRing(size_t size, VkDeviceSize &offset);
+
+    /// Returns the command buffer of the batch that's currently being recorded, starting a new one if needed.
+    VkCommandBuffer recordingCommandBuffer();
+
+    void flushLocked();
+
+    /// Frees the resources of every completed batch. If @p waitForOldest is true, it blocks until at least one batch is complete.
+    void retireBatches(bool waitForOldest);
+
+    Device &m_device;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+    Buffer m_ring;
+    VkDeviceSize m_ringHead = 0;
+    VkDeviceSize m_ringUsed = 0;
+
+    QMutex m_mutex;
+    Batch m_recording;
+    std::deque<Batch> m_inFlight;
+    std::vector<Batch> m_freeBatches; // keeps their command buffer and fence around for reuse
+};
@@ -12,6 +12,9 @@ layout(location = 5) in vec4 inColor;
 layout(location = 6) in vec4 inBoneWeights;
 layout(location = 7) in uvec4 inBoneIds;
 
+// Per-instance, from the second vertex buffer
+layout(location = 8) in mat4 inModel;
+
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 outFragPos;
 layout(location = 2) out vec2 outUV;
@@ -22,7 +25,7 @@ layout(binding = 5) uniform sampler2D specularTexture;
 layout(binding = 6) uniform sampler2D multiTexture;
 
 layout(std430, push_constant) uniform PushConstant {
-    mat4 vp, model;
+    mat4 vp, model; // model is unused, each instance has its own in inModel
     vec4 viewPos;
     int type;
 };
@@ -37,13 +40,13 @@ void main() {
     BoneTransform += mat4(bones[inBoneIds[2]]) * inBoneWeights[2];
     BoneTransform += mat4(bones[inBoneIds[3]]) * inBoneWeights[3];
 
-    BoneTransform = model * BoneTransform;
+    BoneTransform = inModel * BoneTransform;
 
     vec4 bPos = BoneTransform * vec4(inPosition, 1.0);
     vec4 bNor = BoneTransform * vec4(inNormal, 0.0);
 
     gl_Position = vp * bPos;
     outNormal = bNor.xyz;
-    outFragPos = vec3(model * vec4(inPosition, 1.0));
+    outFragPos = vec3(inModel * vec4(inPosition, 1.0));
     outUV = inUV0;
 }
@@ -0,0 +1,345 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Small enough that a leaf is tested in one go by the culling kernel, but keeps the tree shallow for big maps
+static constexpr uint32_t maxLeafSize = 4;
+
+namespace
+{
+BoundingBox emptyBox()
+{
+    constexpr float inf = std::numeric_limits<float>::max();
+    return BoundingBox{.min = {inf, inf, inf}, .max = {-inf, -inf, -inf}};
+}
+
+void grow(BoundingBox &box, const BoundingBox &other)
+{
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = std::min(box.min[i], other.min[i]);
+        box.max[i] = std::max(box.max[i], other.max[i]);
+    }
+}
+
+glm::vec3 center(const BoundingBox &box)
+{
+    return (glm::make_vec3(box.min) + glm::make_vec3(box.max)) * 0.5f;
+}
+
+bool overlaps(const BoundingBox &a, const BoundingBox &b)
+{
+    for (int i = 0; i < 3; i++) {
+        if (a.max[i] < b.min[i] || a.min[i] > b.max[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+enum class Containment { Outside, Intersecting, Inside };
+
+Containment classify(const CameraFrustum &frustum, const BoundingBox &box)
+{
+    auto result = Containment::Inside;
+    for (const auto &plane : frustum.planes) {
+        // The corner that's furthest along the plane normal, and the one that's furthest behind it
+        glm::vec3 positive, negative;
+        const std::array normal = {plane.a, plane.b, plane.c};
+        for (int i = 0; i < 3; i++) {
+            positive[i] = normal[i] >= 0.0f ? box.max[i] : box.min[i];
+            negative[i] = normal[i] >= 0.0f ? box.min[i] : box.max[i];
+        }
+
+        if (distance_to_point(plane, positive) < 0.0f) {
+            return Containment::Outside;
+        }
+        if (distance_to_point(plane, negative) < 0.0f) {
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+/// Returns where the ray enters @p box, if it hits it before @p maxDistance.
+std::optional<float> intersectRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const BoundingBox &box, const float maxDistance)
+{
+    const glm::vec3 t0 = (glm::make_vec3(box.min) - origin) * inverseDirection;
+    const glm::vec3 t1 = (glm::make_vec3(box.max) - origin) * inverseDirection;
+
+    const glm::vec3 nearest = glm::min(t0, t1);
+    const glm::vec3 furthest = glm::max(t0, t1);
+
+    const float enter = std::max({nearest.x, nearest.y, nearest.z, 0.0f});
+    const float exit = std::min({furthest.x, furthest.y, furthest.z, maxDistance});
+
+    if (enter > exit) {
+        return std::nullopt;
+    }
+    return enter;
+}
+}
+
+void BoundingVolumeHierarchy::build(std::vector<BoundingBox> bounds)
+{
+    m_bounds = std::move(bounds);
+
+    m_items.resize(m_bounds.size());
+    for (uint32_t i = 0; i < m_items.size(); i++) {
+        m_items[i] = i;
+    }
+
+    m_nodes.clear();
+    if (m_items.empty()) {
+        return;
+    }
+
+    // A binary tree with at least one item per leaf never needs more than this
+    m_nodes.reserve(m_items.size() * 2);
+    m_nodes.emplace_back();
+    buildNode(0, 0, static_cast<uint32_t>(m_items.size()));
+
+    m_leafBounds.clear();
+    m_leafBounds.reserve(m_items.size());
+    m_leafPositions.resize(m_items.size());
+    for (uint32_t i = 0; i < m_items.size(); i++) {
+        m_leafBounds.push_back(m_bounds[m_items[i]]);
+        m_leafPositions[m_items[i]] = i;
+    }
+}
+
+void BoundingVolumeHierarchy::update(const uint32_t item, const BoundingBox &bounds)
+{
+    m_bounds[item] = bounds;
+    m_leafBounds.set(m_leafPositions[item], bounds);
+}
+
+void BoundingVolumeHierarchy::refit()
+{
+    // Children are always stored after their parent, so going backwards visits them first
+    for (auto it = m_nodes.rbegin(); it != m_nodes.rend(); ++it) {
+        auto &node = *it;
+
+        node.bounds = emptyBox();
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                grow(node.bounds, m_bounds[m_items[i]]);
+            }
+        } else {
+            grow(node.bounds, m_nodes[node.first].bounds);
+            grow(node.bounds, m_nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+size_t BoundingVolumeHierarchy::itemCount() const
+{
+    return m_bounds.size();
+}
+
+const BoundingBox &BoundingVolumeHierarchy::bounds(const uint32_t item) const
+{
+    return m_bounds[item];
+}
+
+void BoundingVolumeHierarchy::queryFrustum(const CameraFrustum &frustum, std::vector<uint32_t> &items) const
+{
+    if (m_nodes.empty()) {
+        return;
+    }
+
+    // The second value is whether the node is known to be completely inside, so its children don't have to be tested anymore
+    std::vector<std::pair<uint32_t, bool>> stack;
+    stack.emplace_back(0, false);
+
+    while (!stack.empty()) {
+        const auto [index, inside] = stack.back();
+        stack.pop_back();
+
+        const auto &node = m_nodes[index];
+
+        bool nodeInside = inside;
+        if (!inside) {
+            const auto containment = classify(frustum, node.bounds);
+            if (containment == Containment::Outside) {
+                continue;
+            }
+            nodeInside = containment == Containment::Inside;
+        }
+
+        if (node.count > 0) {
+            // Leaves that straddle the frustum test all of their items at once
+            const uint32_t visible = nodeInside ? ~0u : cull_aabbs(frustum, m_leafBounds, node.first, node.count);
+            for (uint32_t i = 0; i < node.count; i++) {
+                if (visible & (1u << i)) {
+                    items.push_back(m_items[node.first + i]);
+                }
+            }
+        } else {
+            stack.emplace_back(node.first, nodeInside);
+            stack.emplace_back(node.first + 1, nodeInside);
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::queryBox(const BoundingBox &box, std::vector<uint32_t> &items) const
+{
+    if (m_nodes.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if (!overlaps(node.bounds, box)) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (overlaps(m_bounds[m_items[i]], box)) {
+                    items.push_back(m_items[i]);
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+}
+
+bool BoundingVolumeHierarchy::overlapsAny(const BoundingBox &box) const
+{
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if (!overlaps(node.bounds, box)) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (overlaps(m_bounds[m_items[i]], box)) {
+                    return true;
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+
+    return false;
+}
+
+std::optional<BoundingVolumeHierarchy::RayHit>
+BoundingVolumeHierarchy::raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance) const
+{
+    if (m_nodes.empty()) {
+        return std::nullopt;
+    }
+
+    // An axis-aligned ray would get an infinite inverse, and 0 * inf is NaN when the origin is right on a slab.
+    // The largest finite float gives the same results in the slab test, without the NaNs.
+    glm::vec3 inverseDirection;
+    for (int i = 0; i < 3; i++) {
+        if (std::abs(direction[i]) > std::numeric_limits<float>::min()) {
+            inverseDirection[i] = 1.0f / direction[i];
+        } else {
+            inverseDirection[i] = std::copysign(std::numeric_limits<float>::max(), direction[i]);
+        }
+    }
+
+    std::optional<RayHit> closest;
+    float closestDistance = maxDistance;
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if (!intersectRay(origin, inverseDirection, node.bounds, closestDistance)) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (const auto distance = intersectRay(origin, inverseDirection, m_bounds[m_items[i]], closestDistance)) {
+                    closest = RayHit{.item = m_items[i], .distance = *distance};
+                    closestDistance = *distance;
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+
+    return closest;
+}
+
+void BoundingVolumeHierarchy::buildNode(const uint32_t index, const uint32_t first, const uint32_t count)
+{
+    BoundingBox bounds = emptyBox();
+    BoundingBox centers = emptyBox();
+    for (uint32_t i = first; i < first + count; i++) {
+        const auto &itemBounds = m_bounds[m_items[i]];
+        grow(bounds, itemBounds);
+
+        const glm::vec3 c = center(itemBounds);
+        grow(centers, BoundingBox{.min = {c.x, c.y, c.z}, .max = {c.x, c.y, c.z}});
+    }
+
+    m_nodes[index].bounds = bounds;
+
+    if (count <= maxLeafSize) {
+        m_nodes[index].first = first;
+        m_nodes[index].count = count;
+        return;
+    }
+
+    // Split at the median along the axis where the items are the most spread out
+    const glm::vec3 extent = glm::make_vec3(centers.max) - glm::make_vec3(centers.min);
+    int axis = 0;
+    if (extent.y > extent.x) {
+        axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+        axis = 2;
+    }
+
+    const uint32_t half = count / 2;
+    const auto begin = m_items.begin() + first;
+    std::nth_element(begin, begin + half, begin + count, [this, axis](const uint32_t a, const uint32_t b) {
+        return center(m_bounds[a])[axis] < center(m_bounds[b])[axis];
+    });
+
+    // Both children are allocated at once, so they end up next to each other
+    const auto left = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[index].first = left;
+    m_nodes[index].count = 0;
+    m_nodes.resize(m_nodes.size() + 2);
+
+    buildNode(left, first, half);
+    buildNode(left + 1, first + half, count - half);
+}
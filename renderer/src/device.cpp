@@ -6,10 +6,10 @@
 #include <QDebug>
 #include <QFile>
 
-Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFlags) const
-{
-    vkDeviceWaitIdle(device);
+#include <limits>
 
+Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFlags, const MemoryUsage memoryUsage) const
+{
     // create buffer
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -17,6 +17,11 @@ Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFla
     bufferInfo.usage = usageFlags;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    // GPU-only buffers can only be filled by copying into them
+    if (memoryUsage == MemoryUsage::GpuOnly) {
+        bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+
     VkBuffer handle;
     vkCreateBuffer(device, &bufferInfo, nullptr, &handle);
 
@@ -24,25 +29,21 @@ Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFla
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, handle, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    VkDeviceMemory memory;
-    vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+    const Allocation allocation = allocator->allocate(memRequirements, memoryUsage, MemoryAllocator::ResourceKind::Buffer);
 
-    vkBindBufferMemory(device, handle, memory, 0);
+    vkBindBufferMemory(device, handle, allocation.memory, allocation.offset);
 
-    return {handle, memory, size};
+    return {handle, allocation, size};
 }
 
 void Device::copyToBuffer(const Buffer &buffer, const void *data, const size_t size) const
 {
-    void *mapped_data;
-    vkMapMemory(device, buffer.memory, 0, size, 0, &mapped_data);
-    memcpy(mapped_data, data, size);
-    vkUnmapMemory(device, buffer.memory);
+    if (buffer.mapped() != nullptr) {
+        memcpy(buffer.mapped(), data, size);
+        return;
+    }
+
+    uploadQueue->uploadToBuffer(buffer, data, size);
 }
 
 void Device::destroyBuffer(Buffer &buffer) const
@@ -51,10 +52,7 @@ void Device::destroyBuffer(Buffer &buffer) const
         vkDestroyBuffer(device, buffer.buffer, nullptr);
         buffer.buffer = VK_NULL_HANDLE;
     }
-    if (buffer.memory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, buffer.memory, nullptr);
-        buffer.memory = VK_NULL_HANDLE;
-    }
+    allocator->free(buffer.allocation);
 }
 
 uint32_t Device::findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const
@@ -99,7 +97,6 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
 {
     VkImage image;
     VkImageView imageView;
-    VkDeviceMemory imageMemory;
 
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -121,14 +118,9 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memRequirements.size;
-    allocateInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    const Allocation allocation = allocator->allocate(memRequirements, MemoryUsage::GpuOnly, MemoryAllocator::ResourceKind::Image);
 
-    vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory);
-
-    vkBindImageMemory(device, image, imageMemory, 0);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
 
     VkImageViewCreateInfo viewCreateInfo = {};
     viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -143,7 +135,7 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
 
     vkCreateImageView(device, &viewCreateInfo, nullptr, &imageView);
 
-    return {format, viewCreateInfo.subresourceRange, image, imageView, imageMemory};
+    return {format, viewCreateInfo.subresourceRange, image, imageView, allocation};
 }
 
 void Device::destroyTexture(Texture &texture) const
@@ -156,86 +148,19 @@ void Device::destroyTexture(Texture &texture) const
         vkDestroyImage(device, texture.image, nullptr);
         texture.image = VK_NULL_HANDLE;
     }
-    if (texture.imageMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, texture.imageMemory, nullptr);
-        texture.imageMemory = VK_NULL_HANDLE;
-    }
+    allocator->free(texture.allocation);
 }
 
 Texture Device::createDummyTexture(const std::array<uint8_t, 4> values) const
 {
     const auto texture = createTexture(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
-    // copy image data
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = 4;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer);
-
-    // allocate staging memory
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory);
-
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
-
-    // copy to staging buffer
-    void *mapped_data;
-    vkMapMemory(device, stagingBufferMemory, 0, 4 * sizeof(uint8_t), 0, &mapped_data);
-    memcpy(mapped_data, values.data(), 4 * sizeof(uint8_t));
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    // copy staging buffer to image
-    const VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkImageSubresourceRange range = {};
-    range.baseMipLevel = 0;
-    range.levelCount = 1;
-    range.baseArrayLayer = 0;
-    range.layerCount = 1;
-
-    inlineTransitionImageLayout(commandBuffer,
-                                texture.image,
-                                VK_FORMAT_R8G8B8A8_UNORM,
-                                VK_IMAGE_ASPECT_COLOR_BIT,
-                                range,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
     VkBufferImageCopy region = {};
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
-    region.imageExtent = {static_cast<uint32_t>(1), static_cast<uint32_t>(1), 1};
-
-    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    inlineTransitionImageLayout(commandBuffer,
-                                texture.image,
-                                VK_FORMAT_R8G8B8A8_UNORM,
-                                VK_IMAGE_ASPECT_COLOR_BIT,
-                                range,
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    region.imageExtent = {1, 1, 1};
 
-    endSingleTimeCommands(commandBuffer);
-
-    // free staging resources
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploadQueue->uploadToImage(texture.image, texture.range, values.data(), values.size() * sizeof(uint8_t), {region});
 
     return texture;
 }
@@ -277,9 +202,20 @@ void Device::endSingleTimeCommands(const VkCommandBuffer commandBuffer) const
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    // Keep these in submission order with any pending uploads they might depend on
+    uploadQueue->flush();
+
+    // Only wait for this submission instead of the whole queue
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence = VK_NULL_HANDLE;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
 
+    vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+    vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+    vkDestroyFence(device, fence, nullptr);
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
@@ -364,13 +300,11 @@ void Device::nameTexture(Texture &texture, const std::string_view name) const
 {
     nameObject(VK_OBJECT_TYPE_IMAGE, reinterpret_cast<uint64_t>(texture.image), name.data());
     nameObject(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(texture.imageView), name.data());
-    nameObject(VK_OBJECT_TYPE_DEVICE_MEMORY, reinterpret_cast<uint64_t>(texture.imageMemory), name.data());
 }
 
 void Device::nameBuffer(Buffer &buffer, const std::string_view name) const
 {
     nameObject(VK_OBJECT_TYPE_BUFFER, reinterpret_cast<uint64_t>(buffer.buffer), name.data());
-    nameObject(VK_OBJECT_TYPE_DEVICE_MEMORY, reinterpret_cast<uint64_t>(buffer.memory), name.data());
 }
 
 Texture Device::addGameTexture(physis_Texture gameTexture) const
@@ -495,39 +429,17 @@ Texture Device::addGameTexture(physis_Texture gameTexture) const
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, newTexture.image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    vkAllocateMemory(device, &allocInfo, nullptr, &newTexture.imageMemory);
-
-    vkBindImageMemory(device, newTexture.image, newTexture.imageMemory, 0);
-
-    // copy image data
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = gameTexture.data_size;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer);
-
-    // allocate staging memory
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+    newTexture.allocation = allocator->allocate(memRequirements, MemoryUsage::GpuOnly, MemoryAllocator::ResourceKind::Image);
 
-    allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkBindImageMemory(device, newTexture.image, newTexture.allocation.memory, newTexture.allocation.offset);
 
-    vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory);
-
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
+    VkImageSubresourceRange range = {};
+    range.levelCount = gameTexture.mip_levels;
+    range.layerCount = gameTexture.layers;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
+    // copy image data, all mips and layers in one go
+    std::vector<VkBufferImageCopy> regions;
     for (int i = 0; i < gameTexture.layers; i++) {
         for (int j = 0; j < gameTexture.mip_levels; j++) {
             auto mipData = physis_tex_mip_data(&gameTexture, j);
@@ -539,30 +451,8 @@ Texture Device::addGameTexture(physis_Texture gameTexture) const
                 mipData.end = gameTexture.data_size;
             }
 
-            // copy to staging buffer
-            void *mapped_data;
-            vkMapMemory(device, stagingBufferMemory, 0, gameTexture.data_size, 0, &mapped_data);
-            memcpy(mapped_data, gameTexture.data + mipData.start, mipData.end - mipData.start);
-            vkUnmapMemory(device, stagingBufferMemory);
-
-            VkImageSubresourceRange range = {};
-            range.baseMipLevel = j;
-            range.levelCount = 1;
-            range.baseArrayLayer = i;
-            range.layerCount = 1;
-
-            // copy staging buffer to image
-            VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-            inlineTransitionImageLayout(commandBuffer,
-                                        newTexture.image,
-                                        imageInfo.format,
-                                        VK_IMAGE_ASPECT_COLOR_BIT,
-                                        range,
-                                        VK_IMAGE_LAYOUT_UNDEFINED,
-                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
             VkBufferImageCopy region = {};
+            region.bufferOffset = mipData.start;
             region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             region.imageSubresource.mipLevel = j;
             region.imageSubresource.baseArrayLayer = i;
@@ -571,28 +461,11 @@ Texture Device::addGameTexture(physis_Texture gameTexture) const
             region.imageExtent.height = mipData.height;
             region.imageExtent.depth = 1;
 
-            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, newTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-            inlineTransitionImageLayout(commandBuffer,
-                                        newTexture.image,
-                                        imageInfo.format,
-                                        VK_IMAGE_ASPECT_COLOR_BIT,
-                                        range,
-                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-            endSingleTimeCommands(commandBuffer);
+            regions.push_back(region);
         }
     }
 
-    // free staging resources
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-
-    VkImageSubresourceRange range = {};
-    range.levelCount = gameTexture.mip_levels;
-    range.layerCount = gameTexture.layers;
-    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    uploadQueue->uploadToImage(newTexture.image, range, gameTexture.data, gameTexture.data_size, regions);
 
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
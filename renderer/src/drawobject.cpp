@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "drawobject.h"
+
+#include <algorithm>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+DrawObjectInstance::DrawObjectInstance(const QString &name, DrawObject *sourceObject, const Transformation &transformation, const float clipOutDistance)
+    : name(name)
+    , sourceObject(sourceObject)
+    , clipOutDistance(clipOutDistance)
+    , m_transformation(transformation)
+{
+}
+
+const Transformation &DrawObjectInstance::transformation() const
+{
+    return m_transformation;
+}
+
+void DrawObjectInstance::setTransformation(const Transformation &transformation)
+{
+    m_transformation = transformation;
+    m_transformationDirty = true;
+}
+
+const glm::mat4 &DrawObjectInstance::modelMatrix() const
+{
+    if (m_transformationDirty) {
+        updateCachedTransformation();
+    }
+
+    return m_modelMatrix;
+}
+
+const BoundingBox &DrawObjectInstance::worldBounds() const
+{
+    if (m_transformationDirty) {
+        updateCachedTransformation();
+    }
+
+    return m_worldBounds;
+}
+
+void DrawObjectInstance::markTransformationDirty()
+{
+    m_transformationDirty = true;
+}
+
+void DrawObjectInstance::updateCachedTransformation() const
+{
+    auto m = glm::mat4(1.0f);
+    m = glm::translate(m, glm::make_vec3(m_transformation.translation));
+    m *= glm::mat4_cast(glm::quat(glm::make_vec3(m_transformation.rotation)));
+    m = glm::scale(m, glm::make_vec3(m_transformation.scale));
+
+    m_modelMatrix = m;
+
+    const auto &localBounds = sourceObject->model.bounding_box;
+
+    // Transforms each axis of the box separately and keeps the extremes, which is the same as transforming all eight corners
+    for (int i = 0; i < 3; i++) {
+        m_worldBounds.min[i] = m_worldBounds.max[i] = m[3][i];
+
+        for (int j = 0; j < 3; j++) {
+            const float a = m[j][i] * localBounds.min[j];
+            const float b = m[j][i] * localBounds.max[j];
+            m_worldBounds.min[i] += std::min(a, b);
+            m_worldBounds.max[i] += std::max(a, b);
+        }
+    }
+
+    m_transformationDirty = false;
+}
@@ -5,8 +5,23 @@
 
 #include "camera.h"
 
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define FRUSTUM_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows AVX intrinsics anywhere, it's up to us to only call them when they're supported
+#define FRUSTUM_TARGET_AVX
+#else
+#define FRUSTUM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
 CameraFrustum extract_frustum(glm::mat4 combined)
 {
     CameraFrustum frustum;
@@ -57,18 +72,6 @@ CameraFrustum camera_extract_frustum(const Camera &cam)
     return extract_frustum(combined);
 }
 
-std::array<glm::vec3, 8> get_points(const BoundingBox &aabb)
-{
-    return {glm::vec3(aabb.min[0], aabb.min[1], aabb.min[2]),
-            glm::vec3(aabb.max[0], aabb.min[1], aabb.min[2]),
-            glm::vec3(aabb.min[0], aabb.max[1], aabb.min[2]),
-            glm::vec3(aabb.max[0], aabb.max[1], aabb.min[2]),
-            glm::vec3(aabb.min[0], aabb.min[1], aabb.max[2]),
-            glm::vec3(aabb.max[0], aabb.min[1], aabb.max[2]),
-            glm::vec3(aabb.min[0], aabb.max[1], aabb.max[2]),
-            glm::vec3(aabb.max[0], aabb.max[1], aabb.max[2])};
-}
-
 CameraFrustum normalize_frustum(const CameraFrustum &frustum)
 {
     CameraFrustum normalized_frustum;
@@ -80,19 +83,205 @@ CameraFrustum normalize_frustum(const CameraFrustum &frustum)
 
 bool test_aabb_frustum(const CameraFrustum &frustum, const BoundingBox &aabb)
 {
-    for (std::size_t i = 0; i < 6; i++) {
-        int out = 0;
-
-        for (const auto point : get_points(aabb))
-            out += distance_to_point(frustum.planes[i], point) < 0.0 ? 1 : 0;
+    const glm::vec3 center = (glm::make_vec3(aabb.min) + glm::make_vec3(aabb.max)) * 0.5f;
+    const glm::vec3 extent = (glm::make_vec3(aabb.max) - glm::make_vec3(aabb.min)) * 0.5f;
 
-        if (out == 8)
+    // Only the corner furthest along the plane normal matters, if even that one is behind the plane then the whole box is
+    for (const auto &plane : frustum.planes) {
+        const float radius = std::abs(plane.a) * extent.x + std::abs(plane.b) * extent.y + std::abs(plane.c) * extent.z;
+        if (distance_to_point(plane, center) + radius < 0.0f) {
             return false;
+        }
     }
 
     return true;
 }
 
+// Enough for the widest kernel to read a full vector starting at the last box
+static constexpr size_t lanePadding = 8;
+
+void AabbBatch::clear()
+{
+    m_size = 0;
+}
+
+void AabbBatch::reserve(const size_t count)
+{
+    for (auto *component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        component->reserve(count + lanePadding);
+    }
+}
+
+void AabbBatch::push_back(const BoundingBox &aabb)
+{
+    m_size++;
+    for (auto *component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        if (component->size() < m_size + lanePadding) {
+            component->resize(m_size + lanePadding);
+        }
+    }
+
+    set(m_size - 1, aabb);
+}
+
+void AabbBatch::set(const size_t index, const BoundingBox &aabb)
+{
+    centerX[index] = (aabb.min[0] + aabb.max[0]) * 0.5f;
+    centerY[index] = (aabb.min[1] + aabb.max[1]) * 0.5f;
+    centerZ[index] = (aabb.min[2] + aabb.max[2]) * 0.5f;
+    extentX[index] = (aabb.max[0] - aabb.min[0]) * 0.5f;
+    extentY[index] = (aabb.max[1] - aabb.min[1]) * 0.5f;
+    extentZ[index] = (aabb.max[2] - aabb.min[2]) * 0.5f;
+}
+
+size_t AabbBatch::size() const
+{
+    return m_size;
+}
+
+namespace
+{
+// Each kernel tests its lane count of boxes starting at first against all six planes, and returns one bit per box.
+// This is the same test as test_aabb_frustum, just without the early out.
+#if !defined(FRUSTUM_X86_64)
+uint32_t cullBlockScalar(const CameraFrustum &frustum, const AabbBatch &boxes, const size_t first)
+{
+    for (const auto &plane : frustum.planes) {
+        const float distance = plane.a * boxes.centerX[first] + plane.b * boxes.centerY[first] + plane.c * boxes.centerZ[first] + plane.d
+            + std::abs(plane.a) * boxes.extentX[first] + std::abs(plane.b) * boxes.extentY[first] + std::abs(plane.c) * boxes.extentZ[first];
+        if (distance < 0.0f) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+#else
+// SSE2 is part of x86-64, so this one is always available
+uint32_t cullBlockSse2(const CameraFrustum &frustum, const AabbBatch &boxes, const size_t first)
+{
+    const __m128 cx = _mm_loadu_ps(boxes.centerX.data() + first);
+    const __m128 cy = _mm_loadu_ps(boxes.centerY.data() + first);
+    const __m128 cz = _mm_loadu_ps(boxes.centerZ.data() + first);
+    const __m128 ex = _mm_loadu_ps(boxes.extentX.data() + first);
+    const __m128 ey = _mm_loadu_ps(boxes.extentY.data() + first);
+    const __m128 ez = _mm_loadu_ps(boxes.extentZ.data() + first);
+
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (const auto &plane : frustum.planes) {
+        __m128 distance = _mm_set1_ps(plane.d);
+        distance = _mm_add_ps(distance, _mm_mul_ps(cx, _mm_set1_ps(plane.a)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.b)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.c)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.a))));
+        distance = _mm_add_ps(distance, _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.b))));
+        distance = _mm_add_ps(distance, _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.c))));
+
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+
+    return static_cast<uint32_t>(_mm_movemask_ps(visible));
+}
+
+// Built for AVX regardless of the compiler flags, and only picked if the CPU supports it
+FRUSTUM_TARGET_AVX uint32_t cullBlockAvx(const CameraFrustum &frustum, const AabbBatch &boxes, const size_t first)
+{
+    const __m256 cx = _mm256_loadu_ps(boxes.centerX.data() + first);
+    const __m256 cy = _mm256_loadu_ps(boxes.centerY.data() + first);
+    const __m256 cz = _mm256_loadu_ps(boxes.centerZ.data() + first);
+    const __m256 ex = _mm256_loadu_ps(boxes.extentX.data() + first);
+    const __m256 ey = _mm256_loadu_ps(boxes.extentY.data() + first);
+    const __m256 ez = _mm256_loadu_ps(boxes.extentZ.data() + first);
+
+    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const auto &plane : frustum.planes) {
+        __m256 distance = _mm256_set1_ps(plane.d);
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(cx, _mm256_set1_ps(plane.a)));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane.b)));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.c)));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(ex, _mm256_set1_ps(std::abs(plane.a))));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(ey, _mm256_set1_ps(std::abs(plane.b))));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(ez, _mm256_set1_ps(std::abs(plane.c))));
+
+        visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    return static_cast<uint32_t>(_mm256_movemask_ps(visible));
+}
+
+bool cpuHasAvx()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+
+    // The OS also has to save the YMM registers, otherwise using them isn't safe
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+struct CullKernel {
+    uint32_t (*cullBlock)(const CameraFrustum &frustum, const AabbBatch &boxes, size_t first);
+    size_t laneCount;
+    const char *name;
+};
+
+CullKernel pickCullKernel()
+{
+#if defined(FRUSTUM_X86_64)
+    if (cpuHasAvx()) {
+        return {cullBlockAvx, 8, "AVX"};
+    }
+    return {cullBlockSse2, 4, "SSE2"};
+#else
+    return {cullBlockScalar, 1, "Scalar"};
+#endif
+}
+
+const CullKernel &cullKernel()
+{
+    // Only checked once, the CPU isn't going to change
+    static const CullKernel kernel = pickCullKernel();
+    return kernel;
+}
+}
+
+uint32_t cull_aabbs(const CameraFrustum &frustum, const AabbBatch &boxes, const size_t first, const size_t count)
+{
+    Q_ASSERT(count <= 32);
+    Q_ASSERT(first + count <= boxes.size());
+
+    const auto &kernel = cullKernel();
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i += kernel.laneCount) {
+        mask |= static_cast<uint64_t>(kernel.cullBlock(frustum, boxes, first + i)) << i;
+    }
+
+    // The last block may have read past the requested boxes
+    return static_cast<uint32_t>(mask & ((uint64_t{1} << count) - 1));
+}
+
+void cull_aabbs(const CameraFrustum &frustum, const AabbBatch &boxes, std::vector<uint64_t> &visibility)
+{
+    visibility.assign((boxes.size() + 63) / 64, 0);
+
+    for (size_t i = 0; i < boxes.size(); i += 32) {
+        const size_t count = std::min<size_t>(32, boxes.size() - i);
+        visibility[i / 64] |= static_cast<uint64_t>(cull_aabbs(frustum, boxes, i, count)) << (i % 64);
+    }
+}
+
+const char *cull_aabbs_kernel()
+{
+    return cullKernel().name;
+}
+
 bool intersects(const BoundingBox &a, const BoundingBox &b)
 {
     return glm::all(glm::lessThanEqual(glm::make_vec3(a.min), glm::make_vec3(b.max)))
@@ -3,7 +3,11 @@
 
 #include "gamerenderer.h"
 
+#include <QCryptographicHash>
+#include <QThread>
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <ranges>
 
 #include <glm/ext/matrix_clip_space.hpp>
@@ -56,11 +60,24 @@ const std::array<std::string, 14> passes = {
 
 constexpr int INVALID_PASS = 255;
 
+// Samplers that are filled in from the material, so descriptor sets that use them can't be shared between materials
+const std::array materialSamplers =
+    {"g_SamplerNormal", "g_SamplerIndex", "g_SamplerDiffuse", "g_SamplerDecal", "g_SamplerSpecular", "g_SamplerMask", "g_SamplerTable"};
+
+// PASS_G_OPAQUE, PASS_Z_OPAQUE and PASS_COMPOSITE_SEMITRANSPARENCY
+constexpr size_t modelPassCount = 3;
+
+// Enough for a few thousand parts
+constexpr size_t initialIndirectBufferSize = 4096 * sizeof(VkDrawIndexedIndirectCommand);
+
 GameRenderer::GameRenderer(Device &device, FileCache &cache)
     : m_device(device)
     , m_cache(cache)
     , m_shaderManager(device)
 {
+    // Leave a core for the render thread, so it doesn't stutter while a new area is compiling
+    m_pipelineThreadPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+
     m_dummyTex = m_device.createDummyTexture();
     m_device.nameTexture(m_dummyTex, "Dummy Texture");
 
@@ -70,7 +87,7 @@ GameRenderer::GameRenderer(Device &device, FileCache &cache)
     m_dummyBuffer = m_device.createDummyBuffer();
 
     const size_t vertexSize = planeVertices.size() * sizeof(glm::vec4);
-    m_planeVertexBuffer = m_device.createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    m_planeVertexBuffer = m_device.createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
     m_device.copyToBuffer(m_planeVertexBuffer, planeVertices.data(), vertexSize);
 
     // TODO: they switched from 3D images from ARR to 2D arrays here, not yet supported
@@ -83,10 +100,42 @@ GameRenderer::GameRenderer(Device &device, FileCache &cache)
     m_createViewPositionShpk = physis_shpk_parse(m_cache.platform(), m_cache.read(QStringLiteral("shader/sm5/shpk/createviewposition.shpk")));
     m_backgroundShpk = physis_shpk_parse(m_cache.platform(), m_cache.read(QStringLiteral("shader/sm5/shpk/bg.shpk")));
 
+    // The lighting shaders never change, so they're only selected once
+    {
+        const size_t lightingPass = std::ranges::find(passes, "PASS_LIGHTING_OPAQUE") - passes.begin();
+
+        std::vector subviewKeys = {
+            physis_shpk_crc("Default"),
+            physis_shpk_crc("SUB_VIEW_MAIN"),
+        };
+
+        const uint32_t viewPositionSelector =
+            physis_shpk_build_selector_from_all_keys(nullptr, 0, nullptr, 0, nullptr, 0, subviewKeys.data(), subviewKeys.size());
+        m_viewPositionShaders = selectShaders(m_createViewPositionShpk, viewPositionSelector, lightingPass);
+
+        std::vector sceneKeys = {
+            physis_shpk_crc("GetDirectionalLight_Enable"),
+            physis_shpk_crc("GetFakeSpecular_Disable"),
+            physis_shpk_crc("GetUnderWaterLighting_Disable"),
+        };
+
+        const uint32_t directionalLightingSelector = physis_shpk_build_selector_from_all_keys(nullptr,
+                                                                                              0,
+                                                                                              sceneKeys.data(),
+                                                                                              sceneKeys.size(),
+                                                                                              nullptr,
+                                                                                              0,
+                                                                                              subviewKeys.data(),
+                                                                                              subviewKeys.size());
+        m_directionalLightingShaders = selectShaders(m_directionalLightningShpk, directionalLightingSelector, lightingPass);
+    }
+
     // camera data
     {
-        g_CameraParameter = m_device.createBuffer(sizeof(CameraParameter), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-        m_device.nameBuffer(g_CameraParameter, "g_CameraParameter");
+        for (auto &buffer : g_CameraParameter) {
+            buffer = m_device.createBuffer(sizeof(CameraParameter), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            m_device.nameBuffer(buffer, "g_CameraParameter");
+        }
     }
 
     // instance data
@@ -238,8 +287,10 @@ GameRenderer::GameRenderer(Device &device, FileCache &cache)
 
     // worldViewMatrix
     {
-        g_WorldViewMatrix = m_device.createBuffer(sizeof(WorldViewMatrix), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-        m_device.nameBuffer(g_WorldViewMatrix, "g_WorldViewMatrix");
+        for (auto &buffer : g_WorldViewMatrix) {
+            buffer = m_device.createBuffer(sizeof(WorldViewMatrix), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            m_device.nameBuffer(buffer, "g_WorldViewMatrix");
+        }
     }
 
     // fog parameter
@@ -276,9 +327,19 @@ GameRenderer::GameRenderer(Device &device, FileCache &cache)
     createImageResources();
 }
 
+GameRenderer::~GameRenderer()
+{
+    for (auto &buffer : m_indirectBuffers) {
+        m_device.destroyBuffer(buffer);
+    }
+}
+
 void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &scene, std::vector<DrawObjectInstance> &models)
 {
-    Q_UNUSED(scene)
+    collectFinishedPipelines();
+
+    // Anything written while recording goes into this frame's copy, as the previous frames may still be running
+    const uint32_t frame = m_device.swapChain->currentFrame;
 
     // TODO: this shouldn't be here
     CameraParameter cameraParameter{};
@@ -307,13 +368,59 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
     cameraParameter.IdentityMat3 = glm::mat3x4(1.0f);
     cameraParameter.m_ViewMatrix2 = cameraParameter.m_ViewMatrix;
 
-    m_device.copyToBuffer(g_CameraParameter, &cameraParameter, sizeof(CameraParameter));
+    m_device.copyToBuffer(g_CameraParameter[frame], &cameraParameter, sizeof(CameraParameter));
 
     WorldViewMatrix worldViewMatrix{};
     worldViewMatrix.m_WorldViewMatrix = glm::mat4(1.0f);
     worldViewMatrix.m_EyePosition = glm::vec4(camera.position, 0.0f);
 
-    m_device.copyToBuffer(g_WorldViewMatrix, &worldViewMatrix, sizeof(WorldViewMatrix));
+    m_device.copyToBuffer(g_WorldViewMatrix[frame], &worldViewMatrix, sizeof(WorldViewMatrix));
+
+    // Every model is tested in one go by the batched kernel, and everything below skips the ones out of view
+    m_modelBounds.clear();
+    m_modelBounds.reserve(models.size());
+    for (const auto &model : models) {
+        m_modelBounds.push_back(model.worldBounds());
+    }
+
+    if (scene.frustumCulling) {
+        cull_aabbs(camera.frustum(), m_modelBounds, m_modelVisibility);
+    } else {
+        m_modelVisibility.assign((models.size() + 63) / 64, ~uint64_t{0});
+    }
+
+    m_visibleModels.clear();
+    for (uint32_t j = 0; j < models.size(); j++) {
+        if (is_visible(m_modelVisibility, j)) {
+            m_visibleModels.push_back(j);
+        }
+    }
+    scene.culledObjects = models.size() - m_visibleModels.size();
+
+    // copy bone data, once per frame and only for the models whose bones changed since this frame's copy was written
+    // The ones out of view are caught up whenever they come back into view
+    for (const auto index : m_visibleModels) {
+        auto &object = *models[index].sourceObject;
+        auto &uploadedVersion = object.uploadedBoneDataVersions[frame];
+        if (uploadedVersion == object.boneDataVersion) {
+            continue;
+        }
+
+        // Bone buffers are persistently mapped and coherent, so this writes straight into them without a flush
+        auto boneMatrices = static_cast<glm::mat3x4 *>(object.mappedBoneInfo(frame));
+        for (size_t j = 0; j < object.boneData.size(); j++) {
+            boneMatrices[j] = glm::transpose(object.boneData[j]);
+        }
+        uploadedVersion = object.boneDataVersion;
+    }
+
+    // Every part of every model can be drawn once in each of the passes that draw models
+    size_t maxDraws = 0;
+    for (const auto index : m_visibleModels) {
+        const auto &object = *models[index].sourceObject;
+        maxDraws += object.lods[object.chooseLod(0.0f)].parts.size();
+    }
+    prepareIndirectBuffer(maxDraws * modelPassCount);
 
     int i = 0;
     for (const auto &pass : passes) {
@@ -321,143 +428,37 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
         if (pass == "PASS_G_OPAQUE" || pass == "PASS_Z_OPAQUE") {
             const auto [colorAttachmentFormats, depthAttachmentFormat] = beginPass(commandBuffer, pass);
 
-            for (auto &model : models) {
+            for (const auto index : m_visibleModels) {
+                auto &model = models[index];
                 const auto modelNameStdString = model.name.toStdString();
                 VkDebugUtilsLabelEXT labelExt{};
                 labelExt.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
                 labelExt.pLabelName = modelNameStdString.c_str();
                 m_device.beginDebugMarker(commandBuffer, labelExt);
 
-                // copy bone data
-                {
-                    constexpr int jointMatrixSize = JOINT_MATRIX_SIZE_DAWNTRAIL;
-                    constexpr size_t bufferSize = sizeof(glm::mat3x4) * jointMatrixSize;
-                    void *mapped_data = nullptr;
-                    vkMapMemory(m_device.device, model.sourceObject->boneInfoBuffer.memory, 0, bufferSize, 0, &mapped_data);
-
-                    std::vector<glm::mat3x4> newBoneData(model.sourceObject->boneData.size());
-                    for (int j = 0; j < jointMatrixSize; j++) {
-                        newBoneData[j] = glm::transpose(model.sourceObject->boneData[j]);
-                    }
-
-                    memcpy(mapped_data, newBoneData.data(), bufferSize);
-
-                    VkMappedMemoryRange range = {};
-                    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-                    range.memory = model.sourceObject->boneInfoBuffer.memory;
-                    range.size = bufferSize;
-                    vkFlushMappedMemoryRanges(m_device.device, 1, &range);
-
-                    vkUnmapMemory(m_device.device, model.sourceObject->boneInfoBuffer.memory);
-                }
-
                 const auto &lod = model.sourceObject->chooseLod(0.0f); // TODO: use lod
-                for (const auto &part : model.sourceObject->lods[lod].parts) {
-                    RenderMaterial renderMaterial;
-                    if (static_cast<size_t>(part.materialIndex + 1) > model.sourceObject->materials.size()) {
-                        renderMaterial = model.sourceObject->materials[0]; // TODO: better fallback
-                    } else {
-                        renderMaterial = model.sourceObject->materials[part.materialIndex];
-                    }
-
+                for (auto &part : model.sourceObject->lods[lod].parts) {
+                    auto &renderMaterial = materialFor(*model.sourceObject, part);
                     if (renderMaterial.shaderPackage.p_ptr == nullptr) {
                         qWarning() << "Invalid shader package!";
                         continue;
                     }
 
-                    std::vector<uint32_t> systemKeys;
-                    for (uint32_t j = 0; j < renderMaterial.shaderPackage.num_system_keys; j++) {
-                        systemKeys.push_back(renderMaterial.shaderPackage.system_keys[j].default_value);
-                    }
-
-                    std::vector<uint32_t> sceneKeys;
-                    for (uint32_t j = 0; j < renderMaterial.shaderPackage.num_scene_keys; j++) {
-                        auto id = renderMaterial.shaderPackage.scene_keys[j].id;
-
-                        bool found = false;
-                        if (id == physis_shpk_crc("TransformView")) {
-                            if (model.sourceObject->skinned) {
-                                sceneKeys.push_back(physis_shpk_crc("TransformViewSkin"));
-                            } else {
-                                sceneKeys.push_back(physis_shpk_crc("TransformViewRigid"));
-                            }
-                            found = true;
-                        }
-
-                        // Fall back to default if needed
-                        if (!found) {
-                            sceneKeys.push_back(renderMaterial.shaderPackage.scene_keys[j].default_value);
-                        }
-                    }
-
-                    std::vector<uint32_t> materialKeys;
-                    for (uint32_t j = 0; j < renderMaterial.shaderPackage.num_material_keys; j++) {
-                        auto id = renderMaterial.shaderPackage.material_keys[j].id;
-
-                        bool found = false;
-                        for (uint32_t z = 0; z < renderMaterial.mat.num_shader_keys; z++) {
-                            if (renderMaterial.mat.shader_keys[z].category == id) {
-                                materialKeys.push_back(renderMaterial.mat.shader_keys[z].value);
-                                found = true;
-                            }
-                        }
-
-                        // Fall back to default if needed
-                        if (!found) {
-                            materialKeys.push_back(renderMaterial.shaderPackage.material_keys[j].default_value);
-                        }
-                    }
-                    std::vector subviewKeys = {physis_shpk_crc("Default"), physis_shpk_crc("SUB_VIEW_MAIN")};
-
-                    const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                       systemKeys.size(),
-                                                                                       sceneKeys.data(),
-                                                                                       sceneKeys.size(),
-                                                                                       materialKeys.data(),
-                                                                                       materialKeys.size(),
-                                                                                       subviewKeys.data(),
-                                                                                       subviewKeys.size());
-                    const physis_SHPKNode node = physis_shpk_get_node(&renderMaterial.shaderPackage, selector);
-
-                    // check if invalid
-                    if (node.pass_count == 0) {
-                        qWarning() << "Invalid pass, that's not intended!";
+                    const auto selection = shaderSelection(renderMaterial, model.sourceObject->skinned, i);
+                    if (selection == nullptr) {
+                        qWarning() << "No pass for" << pass << ", that's not intended!";
                         continue;
                     }
 
-                    // this is an index into the node's pass array, not to get confused with the global one we always follow.
-                    const int passIndice = node.pass_indices[i];
-                    if (passIndice != INVALID_PASS) {
-                        const Pass currentPass = node.passes[passIndice];
-                        Q_ASSERT(currentPass.id == physis_shpk_crc(pass.c_str()));
-
-                        const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                        const uint32_t pixelShaderIndice = currentPass.pixel_shader;
-
-                        physis_Shader vertexShader = renderMaterial.shaderPackage.vertex_shaders[vertexShaderIndice];
-                        physis_Shader pixelShader = renderMaterial.shaderPackage.pixel_shaders[pixelShaderIndice];
-
-                        auto &pipeline = bindPipeline(commandBuffer,
-                                                      pass,
-                                                      vertexShader,
-                                                      pixelShader,
-                                                      renderMaterial.mat.shpk_name,
-                                                      &model.sourceObject->model,
-                                                      &part.originalPart,
-                                                      colorAttachmentFormats,
-                                                      depthAttachmentFormat);
-                        bindDescriptorSets(commandBuffer, pipeline, model.sourceObject, &renderMaterial, pass);
-
-                        VkDeviceSize offsets[] = {0};
-                        for (uintptr_t j = 0; j < part.originalPart.num_streams; j++) {
-                            vkCmdBindVertexBuffers(commandBuffer, j, 1, &part.streamBuffer[j].buffer, offsets);
-                        }
-                        vkCmdBindIndexBuffer(commandBuffer, part.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-                        vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, 0, 0, 0);
-                    } else {
-                        qWarning() << "No pass for" << pass << ", that's not intended!";
-                    }
+                    drawMaterialPart(commandBuffer,
+                                     pass,
+                                     i,
+                                     *model.sourceObject,
+                                     part,
+                                     renderMaterial,
+                                     *selection,
+                                     colorAttachmentFormats,
+                                     depthAttachmentFormat);
                 }
 
                 m_device.endDebugMarker(commandBuffer);
@@ -473,53 +474,15 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
             {
                 const auto [colorAttachmentFormats, depthAttachmentFormat] = beginPass(commandBuffer, "PASS_LIGHTING_OPAQUE_VIEWPOSITION");
 
-                std::vector<uint32_t> systemKeys = {};
-                std::vector subviewKeys = {
-                    physis_shpk_crc("Default"),
-                    physis_shpk_crc("SUB_VIEW_MAIN"),
-                };
-
-                const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                   systemKeys.size(),
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   subviewKeys.data(),
-                                                                                   subviewKeys.size());
-                const physis_SHPKNode node = physis_shpk_get_node(&m_createViewPositionShpk, selector);
-
-                // check if invalid
-                if (node.pass_count == 0) {
-                    continue;
-                }
-
-                const int passIndice = node.pass_indices[i];
-                if (passIndice != INVALID_PASS) {
-                    const Pass currentPass = node.passes[passIndice];
-                    Q_ASSERT(currentPass.id == physis_shpk_crc(pass.c_str()));
-
-                    const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                    const uint32_t pixelShaderIndice = currentPass.pixel_shader;
-
-                    physis_Shader vertexShader = m_createViewPositionShpk.vertex_shaders[vertexShaderIndice];
-                    physis_Shader pixelShader = m_createViewPositionShpk.pixel_shaders[pixelShaderIndice];
-
-                    auto &pipeline = bindPipeline(commandBuffer,
-                                                  "PASS_LIGHTING_OPAQUE_VIEWPOSITION",
-                                                  vertexShader,
-                                                  pixelShader,
-                                                  "createviewposition.shpk",
-                                                  nullptr,
-                                                  nullptr,
-                                                  colorAttachmentFormats,
-                                                  depthAttachmentFormat);
-                    bindDescriptorSets(commandBuffer, pipeline, nullptr, nullptr, pass);
-
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
-
-                    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+                if (m_viewPositionShaders) {
+                    drawFullscreenPass(commandBuffer,
+                                       "PASS_LIGHTING_OPAQUE_VIEWPOSITION",
+                                       m_createViewPositionShpk,
+                                       *m_viewPositionShaders,
+                                       "createviewposition.shpk",
+                                       m_viewPositionPipeline,
+                                       colorAttachmentFormats,
+                                       depthAttachmentFormat);
                 }
             }
             endPass(commandBuffer);
@@ -530,58 +493,15 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
             {
                 const auto [colorAttachmentFormats, depthAttachmentFormat] = beginPass(commandBuffer, pass);
 
-                std::vector<uint32_t> systemKeys = {};
-                std::vector sceneKeys = {
-                    physis_shpk_crc("GetDirectionalLight_Enable"),
-                    physis_shpk_crc("GetFakeSpecular_Disable"),
-                    physis_shpk_crc("GetUnderWaterLighting_Disable"),
-                };
-                std::vector subviewKeys = {
-                    physis_shpk_crc("Default"),
-                    physis_shpk_crc("SUB_VIEW_MAIN"),
-                };
-
-                const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                   systemKeys.size(),
-                                                                                   sceneKeys.data(),
-                                                                                   sceneKeys.size(),
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   subviewKeys.data(),
-                                                                                   subviewKeys.size());
-                const physis_SHPKNode node = physis_shpk_get_node(&m_directionalLightningShpk, selector);
-
-                // check if invalid
-                if (node.pass_count == 0) {
-                    continue;
-                }
-
-                const int passIndice = node.pass_indices[i];
-                if (passIndice != INVALID_PASS) {
-                    const Pass currentPass = node.passes[passIndice];
-                    Q_ASSERT(currentPass.id == physis_shpk_crc(pass.c_str()));
-
-                    const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                    const uint32_t pixelShaderIndice = currentPass.pixel_shader;
-
-                    physis_Shader vertexShader = m_directionalLightningShpk.vertex_shaders[vertexShaderIndice];
-                    physis_Shader pixelShader = m_directionalLightningShpk.pixel_shaders[pixelShaderIndice];
-
-                    auto &pipeline = bindPipeline(commandBuffer,
-                                                  pass,
-                                                  vertexShader,
-                                                  pixelShader,
-                                                  "directionallighting.shpk",
-                                                  nullptr,
-                                                  nullptr,
-                                                  colorAttachmentFormats,
-                                                  depthAttachmentFormat);
-                    bindDescriptorSets(commandBuffer, pipeline, nullptr, nullptr, pass);
-
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
-
-                    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+                if (m_directionalLightingShaders) {
+                    drawFullscreenPass(commandBuffer,
+                                       pass,
+                                       m_directionalLightningShpk,
+                                       *m_directionalLightingShaders,
+                                       "directionallighting.shpk",
+                                       m_directionalLightingPipeline,
+                                       colorAttachmentFormats,
+                                       depthAttachmentFormat);
                 }
             }
             endPass(commandBuffer);
@@ -594,107 +514,26 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
         } else if (pass == "PASS_COMPOSITE_SEMITRANSPARENCY") {
             const auto [colorAttachmentFormats, depthAttachmentFormat] = beginPass(commandBuffer, pass);
 
-            for (auto &model : models) {
+            for (const auto index : m_visibleModels) {
+                auto &model = models[index];
                 const auto &lod = model.sourceObject->chooseLod(0.0f); // TODO: use lod
-                for (const auto &part : model.sourceObject->lods[lod].parts) {
-                    RenderMaterial renderMaterial;
-                    if (static_cast<size_t>(part.materialIndex + 1) > model.sourceObject->materials.size()) {
-                        renderMaterial = model.sourceObject->materials[0]; // TODO: better fallback
-                    } else {
-                        renderMaterial = model.sourceObject->materials[part.materialIndex];
-                    }
-
+                for (auto &part : model.sourceObject->lods[lod].parts) {
+                    auto &renderMaterial = materialFor(*model.sourceObject, part);
                     if (renderMaterial.shaderPackage.p_ptr == nullptr) {
                         qWarning() << "Invalid shader package!";
                         continue;
                     }
 
-                    std::vector<uint32_t> systemKeys;
-
-                    std::vector<uint32_t> sceneKeys;
-                    for (uint32_t j = 0; j < renderMaterial.shaderPackage.num_scene_keys; j++) {
-                        auto id = renderMaterial.shaderPackage.scene_keys[j].id;
-
-                        bool found = false;
-                        if (id == physis_shpk_crc("TransformView")) {
-                            if (model.sourceObject->skinned) {
-                                sceneKeys.push_back(physis_shpk_crc("TransformViewSkin"));
-                            } else {
-                                sceneKeys.push_back(physis_shpk_crc("TransformViewRigid"));
-                            }
-                            found = true;
-                        }
-
-                        // Fall back to default if needed
-                        if (!found) {
-                            sceneKeys.push_back(renderMaterial.shaderPackage.scene_keys[j].default_value);
-                        }
-                    }
-
-                    std::vector<uint32_t> materialKeys;
-                    for (uint32_t j = 0; j < renderMaterial.shaderPackage.num_material_keys; j++) {
-                        auto id = renderMaterial.shaderPackage.material_keys[j].id;
-
-                        bool found = false;
-                        for (uint32_t z = 0; z < renderMaterial.mat.num_shader_keys; z++) {
-                            if (renderMaterial.mat.shader_keys[z].category == id) {
-                                materialKeys.push_back(renderMaterial.mat.shader_keys[z].value);
-                                found = true;
-                            }
-                        }
-
-                        // Fall back to default if needed
-                        if (!found) {
-                            materialKeys.push_back(renderMaterial.shaderPackage.material_keys[j].default_value);
-                        }
-                    }
-                    std::vector subviewKeys = {physis_shpk_crc("Default"), physis_shpk_crc("SUB_VIEW_MAIN")};
-
-                    const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                       systemKeys.size(),
-                                                                                       sceneKeys.data(),
-                                                                                       sceneKeys.size(),
-                                                                                       materialKeys.data(),
-                                                                                       materialKeys.size(),
-                                                                                       subviewKeys.data(),
-                                                                                       subviewKeys.size());
-                    const physis_SHPKNode node = physis_shpk_get_node(&renderMaterial.shaderPackage, selector);
-
-                    // check if invalid
-                    if (node.pass_count == 0) {
-                        continue;
-                    }
-
-                    // this is an index into the node's pass array, not to get confused with the global one we always follow.
-                    const int passIndice = node.pass_indices[i];
-                    if (passIndice != INVALID_PASS) {
-                        const Pass currentPass = node.passes[passIndice];
-                        Q_ASSERT(currentPass.id == physis_shpk_crc(pass.c_str()));
-
-                        const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                        const uint32_t pixelShaderIndice = currentPass.pixel_shader;
-
-                        physis_Shader vertexShader = renderMaterial.shaderPackage.vertex_shaders[vertexShaderIndice];
-                        physis_Shader pixelShader = renderMaterial.shaderPackage.pixel_shaders[pixelShaderIndice];
-
-                        auto &pipeline = bindPipeline(commandBuffer,
-                                                      pass,
-                                                      vertexShader,
-                                                      pixelShader,
-                                                      renderMaterial.mat.shpk_name,
-                                                      &model.sourceObject->model,
-                                                      &part.originalPart,
-                                                      colorAttachmentFormats,
-                                                      depthAttachmentFormat);
-                        bindDescriptorSets(commandBuffer, pipeline, model.sourceObject, &renderMaterial, pass);
-
-                        VkDeviceSize offsets[] = {0};
-                        for (uintptr_t j = 0; j < part.originalPart.num_streams; j++) {
-                            vkCmdBindVertexBuffers(commandBuffer, j, 1, &part.streamBuffer[j].buffer, offsets);
-                        }
-                        vkCmdBindIndexBuffer(commandBuffer, part.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-                        vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, 0, 0, 0);
+                    if (const auto selection = shaderSelection(renderMaterial, model.sourceObject->skinned, i)) {
+                        drawMaterialPart(commandBuffer,
+                                     pass,
+                                     i,
+                                     *model.sourceObject,
+                                     part,
+                                     renderMaterial,
+                                     *selection,
+                                     colorAttachmentFormats,
+                                     depthAttachmentFormat);
                     }
                 }
             }
@@ -710,16 +549,16 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene &
 
 void GameRenderer::resize()
 {
-    // TODO: this is because of our terrible resource handling. an image referenced in these may be gone due to resizing, for example
-    for (auto &cachedPipeline : m_cachedPipelines | std::views::values) {
-        cachedPipeline.cachedDescriptors.clear();
-    }
+    // The render targets referenced by the descriptor sets are about to be recreated
+    freeDescriptorSets();
 
     createImageResources();
 }
 
-std::pair<std::vector<VkFormat>, VkFormat> GameRenderer::beginPass(VkCommandBuffer commandBuffer, const std::string_view passName) const
+std::pair<std::vector<VkFormat>, VkFormat> GameRenderer::beginPass(VkCommandBuffer commandBuffer, const std::string_view passName)
 {
+    resetBoundState();
+
     VkDebugUtilsLabelEXT labelExt{};
     labelExt.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
     labelExt.pLabelName = passName.data();
@@ -956,391 +795,422 @@ std::pair<std::vector<VkFormat>, VkFormat> GameRenderer::beginPass(VkCommandBuff
     return {colorAttachmentFormats, depthAttachmentFormat};
 }
 
-void GameRenderer::endPass(const VkCommandBuffer commandBuffer) const
+void GameRenderer::endPass(const VkCommandBuffer commandBuffer)
 {
+    flushDraws(commandBuffer);
+
     vkCmdEndRendering(commandBuffer);
 
     m_device.endDebugMarker(commandBuffer);
 }
 
-GameRenderer::CachedPipeline &GameRenderer::bindPipeline(VkCommandBuffer commandBuffer,
-                                                         std::string_view passName,
-                                                         physis_Shader &vertexShader,
-                                                         physis_Shader &pixelShader,
-                                                         std::string_view shaderName,
-                                                         const physis_MDL *mdl,
-                                                         const physis_Part *part,
-                                                         std::vector<VkFormat> colorAttachmentFormats,
-                                                         VkFormat depthAttachmentFormat)
+GameRenderer::CachedPipeline GameRenderer::createPipeline(const PipelineRequest &request) const
 {
-    const uint32_t hash = vertexShader.len + pixelShader.len + physis_shpk_crc(passName.data()) + physis_shpk_crc(shaderName.data());
-    if (!m_cachedPipelines.contains(hash)) {
-        qInfo() << "Creating pipeline for" << passName << "in" << shaderName;
-
-        auto vertexShaderModule = m_shaderManager.convertShaderModule(vertexShader, spv::ExecutionModelVertex);
-        auto fragmentShaderModule = m_shaderManager.convertShaderModule(pixelShader, spv::ExecutionModelFragment);
-
-        m_device.nameObject(VK_OBJECT_TYPE_SHADER_MODULE, reinterpret_cast<uint64_t>(vertexShaderModule), shaderName);
-        m_device.nameObject(VK_OBJECT_TYPE_SHADER_MODULE, reinterpret_cast<uint64_t>(fragmentShaderModule), shaderName);
-
-        VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
-        vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertexShaderStageInfo.module = vertexShaderModule;
-        vertexShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
-        fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragmentShaderStageInfo.module = fragmentShaderModule; // m_renderer.loadShaderFromDisk(":/shaders/dummy.frag.spv");
-        fragmentShaderStageInfo.pName = "main";
-
-        std::array shaderStages = {vertexShaderStageInfo, fragmentShaderStageInfo};
-
-        std::vector<VkVertexInputBindingDescription> bindings;
-        if (passName == "PASS_LIGHTING_OPAQUE" || passName == "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
+    const auto &key = request.key;
+
+    auto vertexShaderModule = m_shaderManager.convertShaderModule(request.vertexShader, spv::ExecutionModelVertex);
+    auto fragmentShaderModule = m_shaderManager.convertShaderModule(request.pixelShader, spv::ExecutionModelFragment);
+
+    m_device.nameObject(VK_OBJECT_TYPE_SHADER_MODULE, reinterpret_cast<uint64_t>(vertexShaderModule), request.shaderName);
+    m_device.nameObject(VK_OBJECT_TYPE_SHADER_MODULE, reinterpret_cast<uint64_t>(fragmentShaderModule), request.shaderName);
+
+    VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
+    vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertexShaderStageInfo.module = vertexShaderModule;
+    vertexShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
+    fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragmentShaderStageInfo.module = fragmentShaderModule; // m_renderer.loadShaderFromDisk(":/shaders/dummy.frag.spv");
+    fragmentShaderStageInfo.pName = "main";
+
+    std::array shaderStages = {vertexShaderStageInfo, fragmentShaderStageInfo};
+
+    std::vector<VkVertexInputBindingDescription> bindings;
+    if (request.passName == "PASS_LIGHTING_OPAQUE" || request.passName == "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
+        VkVertexInputBindingDescription binding = {};
+        binding.stride = sizeof(glm::vec4);
+        bindings.push_back(binding);
+    } else {
+        for (uint32_t i = 0; i < key.streamStrides.size(); i++) {
             VkVertexInputBindingDescription binding = {};
-            binding.stride = sizeof(glm::vec4);
+            binding.stride = key.streamStrides[i];
+            binding.binding = i;
             bindings.push_back(binding);
-        } else {
-            for (uintptr_t i = 0; i < part->num_streams; i++) {
-                VkVertexInputBindingDescription binding = {};
-                binding.stride = part->stream_strides[i];
-                binding.binding = i;
-                bindings.push_back(binding);
-            }
         }
+    }
 
-        auto vertex_glsl = m_shaderManager.getShaderModuleTest(vertexShader);
-        auto vertex_resources = vertex_glsl.get_shader_resources();
-
-        auto fragment_glsl = m_shaderManager.getShaderModuleTest(pixelShader);
-        auto fragment_resources = fragment_glsl.get_shader_resources();
+    auto vertex_glsl = m_shaderManager.getShaderModuleTest(request.vertexShader);
+    auto vertex_resources = vertex_glsl.get_shader_resources();
 
-        std::vector<RequestedSet> requestedSets;
+    auto fragment_glsl = m_shaderManager.getShaderModuleTest(request.pixelShader);
+    auto fragment_resources = fragment_glsl.get_shader_resources();
 
-        const auto &collectResources = [&requestedSets](const spirv_cross::CompilerGLSL &glsl,
-                                                        const spirv_cross::SmallVector<spirv_cross::Resource> &resources,
-                                                        const VkShaderStageFlagBits stageFlagBit,
-                                                        const VkDescriptorType descriptorType) {
-            for (const auto &resource : resources) {
-                const unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
-                const unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+    std::vector<RequestedSet> requestedSets;
 
-                if (requestedSets.size() <= set) {
-                    requestedSets.resize(set + 1);
-                }
+    const auto &collectResources = [&requestedSets](const spirv_cross::CompilerGLSL &glsl,
+                                                    const spirv_cross::SmallVector<spirv_cross::Resource> &resources,
+                                                    const VkShaderStageFlagBits stageFlagBit,
+                                                    const VkDescriptorType descriptorType) {
+        for (const auto &resource : resources) {
+            const unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
+            const unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
 
-                auto &requestSet = requestedSets[set];
-                requestSet.used = true;
+            if (requestedSets.size() <= set) {
+                requestedSets.resize(set + 1);
+            }
 
-                if (requestSet.bindings.size() <= binding) {
-                    requestSet.bindings.resize(binding + 1);
-                }
+            auto &requestSet = requestedSets[set];
+            requestSet.used = true;
 
-                requestSet.bindings[binding].type = descriptorType;
-                requestSet.bindings[binding].used = true;
-                requestSet.bindings[binding].stageFlags |= stageFlagBit;
-                requestSet.bindings[binding].originalName = resource.name;
+            if (requestSet.bindings.size() <= binding) {
+                requestSet.bindings.resize(binding + 1);
             }
-        };
 
-        collectResources(vertex_glsl, vertex_resources.uniform_buffers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-        collectResources(vertex_glsl, vertex_resources.separate_images, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
-        collectResources(vertex_glsl, vertex_resources.separate_samplers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
-        collectResources(vertex_glsl, vertex_resources.storage_buffers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-
-        collectResources(fragment_glsl, fragment_resources.uniform_buffers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-        collectResources(fragment_glsl, fragment_resources.separate_images, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
-        collectResources(fragment_glsl, fragment_resources.separate_samplers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
-        collectResources(fragment_glsl, fragment_resources.storage_buffers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-
-        for (auto &set : requestedSets) {
-            if (set.used) {
-                int j = 0;
-                std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
-                for (const auto &binding : set.bindings) {
-                    if (binding.used) {
-                        VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
-                        boneInfoBufferBinding.descriptorType = binding.type;
-                        boneInfoBufferBinding.descriptorCount = 1;
-                        boneInfoBufferBinding.stageFlags = binding.stageFlags;
-                        boneInfoBufferBinding.binding = j;
-
-                        layoutBindings.push_back(boneInfoBufferBinding);
-                    }
-                    j++;
+            requestSet.bindings[binding].type = descriptorType;
+            requestSet.bindings[binding].used = true;
+            requestSet.bindings[binding].stageFlags |= stageFlagBit;
+            requestSet.bindings[binding].originalName = resource.name;
+        }
+    };
+
+    collectResources(vertex_glsl, vertex_resources.uniform_buffers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    collectResources(vertex_glsl, vertex_resources.separate_images, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+    collectResources(vertex_glsl, vertex_resources.separate_samplers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
+    collectResources(vertex_glsl, vertex_resources.storage_buffers, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    collectResources(fragment_glsl, fragment_resources.uniform_buffers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    collectResources(fragment_glsl, fragment_resources.separate_images, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+    collectResources(fragment_glsl, fragment_resources.separate_samplers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
+    collectResources(fragment_glsl, fragment_resources.storage_buffers, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    for (auto &set : requestedSets) {
+        if (set.used) {
+            int j = 0;
+            std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+            for (const auto &binding : set.bindings) {
+                if (binding.used) {
+                    VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
+                    boneInfoBufferBinding.descriptorType = binding.type;
+                    boneInfoBufferBinding.descriptorCount = 1;
+                    boneInfoBufferBinding.stageFlags = binding.stageFlags;
+                    boneInfoBufferBinding.binding = j;
+
+                    layoutBindings.push_back(boneInfoBufferBinding);
                 }
+                j++;
+            }
 
-                VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-                layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-                layoutInfo.bindingCount = layoutBindings.size();
-                layoutInfo.pBindings = layoutBindings.data();
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = layoutBindings.size();
+            layoutInfo.pBindings = layoutBindings.data();
 
-                vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &set.layout);
-            }
+            vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &set.layout);
         }
+    }
 
-        std::vector<VkVertexInputAttributeDescription> attributeDescs;
-
-        for (const auto &texture : vertex_resources.stage_inputs) {
-            const unsigned binding = vertex_glsl.get_decoration(texture.id, spv::DecorationLocation);
-
-            VkVertexInputAttributeDescription uv0Attribute = {};
-            uv0Attribute.location = binding;
-
-            if (mdl != nullptr) {
-                std::string semanticName = m_shaderManager.getShaderModuleResources(vertexShader, binding);
-
-                for (uintptr_t i = 0; i < mdl->lods[0].num_vertex_elements; i++) {
-                    auto element = mdl->lods[0].vertex_elements[i];
-
-                    auto fromVertexType = [](const VertexType type) -> VkFormat {
-                        switch (type) {
-                        case VertexType::Single1:
-                            return VK_FORMAT_R32_SFLOAT;
-                        case VertexType::Single2:
-                            return VK_FORMAT_R32G32_SFLOAT;
-                        case VertexType::Single3:
-                            return VK_FORMAT_R32G32B32_SFLOAT;
-                        case VertexType::Single4:
-                            return VK_FORMAT_R32G32B32A32_SFLOAT;
-                        case VertexType::Byte4:
-                            return VK_FORMAT_R8G8B8A8_UINT;
-                        case VertexType::Short2:
-                            break;
-                        case VertexType::Short4:
-                            break;
-                        case VertexType::ByteFloat4:
-                            return VK_FORMAT_R8G8B8A8_UNORM;
-                        case VertexType::Short2n:
-                            break;
-                        case VertexType::Short4n:
-                            break;
-                        case VertexType::Half2:
-                            return VK_FORMAT_R16G16_SFLOAT;
-                        case VertexType::Half4:
-                            return VK_FORMAT_R16G16B16A16_SFLOAT;
-                        case VertexType::UnkPS3:
-                        case VertexType::UnsignedShort2:
-                        case VertexType::UnsignedShort4:
-                            break;
-                        }
-
-                        qInfo() << "Unhandled type" << magic_enum::enum_name(type);
-                        return VK_FORMAT_R32G32B32A32_SFLOAT;
-                    };
+    std::vector<VkVertexInputAttributeDescription> attributeDescs;
+
+    for (const auto &texture : vertex_resources.stage_inputs) {
+        const unsigned binding = vertex_glsl.get_decoration(texture.id, spv::DecorationLocation);
+
+        VkVertexInputAttributeDescription uv0Attribute = {};
+        uv0Attribute.location = binding;
+
+        if (key.vertexElements) {
+            const std::string semanticName = m_shaderManager.getShaderModuleResources(request.vertexShader, binding);
+
+            auto fromVertexType = [](const VertexType type) -> VkFormat {
+                switch (type) {
+                case VertexType::Single1:
+                    return VK_FORMAT_R32_SFLOAT;
+                case VertexType::Single2:
+                    return VK_FORMAT_R32G32_SFLOAT;
+                case VertexType::Single3:
+                    return VK_FORMAT_R32G32B32_SFLOAT;
+                case VertexType::Single4:
+                    return VK_FORMAT_R32G32B32A32_SFLOAT;
+                case VertexType::Byte4:
+                    return VK_FORMAT_R8G8B8A8_UINT;
+                case VertexType::Short2:
+                    break;
+                case VertexType::Short4:
+                    break;
+                case VertexType::ByteFloat4:
+                    return VK_FORMAT_R8G8B8A8_UNORM;
+                case VertexType::Short2n:
+                    break;
+                case VertexType::Short4n:
+                    break;
+                case VertexType::Half2:
+                    return VK_FORMAT_R16G16_SFLOAT;
+                case VertexType::Half4:
+                    return VK_FORMAT_R16G16B16A16_SFLOAT;
+                case VertexType::UnkPS3:
+                case VertexType::UnsignedShort2:
+                case VertexType::UnsignedShort4:
+                    break;
+                }
 
-                    if (semanticName == "POSITION" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::Position) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "COLOR" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::Color) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "TEXCOORD" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::UV) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "NORMAL" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::Normal) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "BINORMAL"
-                               && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::BiTangent) { // TODO: Bitangent is here twice lol
+                qInfo() << "Unhandled type" << magic_enum::enum_name(type);
+                return VK_FORMAT_R32G32B32A32_SFLOAT;
+            };
+
+            static const std::map<std::string_view, VertexUsage> semanticUsages = {
+                {"POSITION", VertexUsage::Position},
+                {"COLOR", VertexUsage::Color},
+                {"TEXCOORD", VertexUsage::UV},
+                {"NORMAL", VertexUsage::Normal},
+                {"BINORMAL", VertexUsage::BiTangent}, // TODO: Bitangent is here twice lol
+                {"BLENDWEIGHT", VertexUsage::BlendWeights},
+                {"BLENDINDICES", VertexUsage::BlendIndices},
+            };
+
+            if (const auto usage = semanticUsages.find(semanticName); usage != semanticUsages.end()) {
+                for (const auto &element : *key.vertexElements) {
+                    if (element.usage == usage->second) {
                         uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "BLENDWEIGHT" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::BlendWeights) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
-                    } else if (semanticName == "BLENDINDICES" && mdl->lods[0].vertex_elements[i].vertex_usage == VertexUsage::BlendIndices) {
-                        uv0Attribute.binding = element.stream;
-                        uv0Attribute.offset = mdl->lods[0].vertex_elements[i].offset;
-                        uv0Attribute.format = fromVertexType(element.vertex_type);
+                        uv0Attribute.offset = element.offset;
+                        uv0Attribute.format = fromVertexType(element.type);
                     }
                 }
+            }
 
-                if (uv0Attribute.format == VK_FORMAT_UNDEFINED) {
-                    qWarning() << "Unhandled input name:" << semanticName;
+            if (uv0Attribute.format == VK_FORMAT_UNDEFINED) {
+                qWarning() << "Unhandled input name:" << semanticName;
+            }
+        } else {
+            auto type = vertex_glsl.get_type(texture.type_id);
+            if (type.basetype == spirv_cross::SPIRType::Int) {
+                switch (type.vecsize) {
+                case 1:
+                    uv0Attribute.format = VK_FORMAT_R32_SINT;
+                    break;
+                case 2:
+                    uv0Attribute.format = VK_FORMAT_R32G32_SINT;
+                    break;
+                case 3:
+                    uv0Attribute.format = VK_FORMAT_R32G32B32_SINT;
+                    break;
+                case 4:
+                    uv0Attribute.format = VK_FORMAT_R8G8B8A8_UINT; // supposed to be VK_FORMAT_R32G32B32A32_SINT, but our bone_id is uint8_t currently
+                    break;
+                default:
+                    Q_UNREACHABLE();
                 }
-            } else {
-                auto type = vertex_glsl.get_type(texture.type_id);
-                if (type.basetype == spirv_cross::SPIRType::Int) {
-                    switch (type.vecsize) {
-                    case 1:
-                        uv0Attribute.format = VK_FORMAT_R32_SINT;
-                        break;
-                    case 2:
-                        uv0Attribute.format = VK_FORMAT_R32G32_SINT;
-                        break;
-                    case 3:
-                        uv0Attribute.format = VK_FORMAT_R32G32B32_SINT;
-                        break;
-                    case 4:
-                        uv0Attribute.format = VK_FORMAT_R8G8B8A8_UINT; // supposed to be VK_FORMAT_R32G32B32A32_SINT, but our bone_id is uint8_t currently
-                        break;
-                    default:
-                        Q_UNREACHABLE();
-                    }
-                } else if (type.basetype == spirv_cross::SPIRType::Float) {
-                    switch (type.vecsize) {
-                    case 1:
-                        uv0Attribute.format = VK_FORMAT_R32_SFLOAT;
-                        break;
-                    case 2:
-                        uv0Attribute.format = VK_FORMAT_R32G32_SFLOAT;
-                        break;
-                    case 3:
-                        uv0Attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-                        break;
-                    case 4:
-                        uv0Attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-                        break;
-                    default:
-                        Q_UNREACHABLE();
-                    }
-                } else if (type.basetype == spirv_cross::SPIRType::Half) {
-                    switch (type.vecsize) {
-                    case 1:
-                        uv0Attribute.format = VK_FORMAT_R16_SFLOAT;
-                        break;
-                    case 2:
-                        uv0Attribute.format = VK_FORMAT_R16G16_SFLOAT;
-                        break;
-                    case 3:
-                        uv0Attribute.format = VK_FORMAT_R16G16B16_SFLOAT;
-                        break;
-                    case 4:
-                        uv0Attribute.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-                        break;
-                    default:
-                        Q_UNREACHABLE();
-                    }
+            } else if (type.basetype == spirv_cross::SPIRType::Float) {
+                switch (type.vecsize) {
+                case 1:
+                    uv0Attribute.format = VK_FORMAT_R32_SFLOAT;
+                    break;
+                case 2:
+                    uv0Attribute.format = VK_FORMAT_R32G32_SFLOAT;
+                    break;
+                case 3:
+                    uv0Attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+                    break;
+                case 4:
+                    uv0Attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+                    break;
+                default:
+                    Q_UNREACHABLE();
+                }
+            } else if (type.basetype == spirv_cross::SPIRType::Half) {
+                switch (type.vecsize) {
+                case 1:
+                    uv0Attribute.format = VK_FORMAT_R16_SFLOAT;
+                    break;
+                case 2:
+                    uv0Attribute.format = VK_FORMAT_R16G16_SFLOAT;
+                    break;
+                case 3:
+                    uv0Attribute.format = VK_FORMAT_R16G16B16_SFLOAT;
+                    break;
+                case 4:
+                    uv0Attribute.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+                    break;
+                default:
+                    Q_UNREACHABLE();
                 }
             }
-
-            attributeDescs.push_back(uv0Attribute);
         }
 
-        VkPipelineVertexInputStateCreateInfo vertexInputState = {};
-        vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputState.vertexBindingDescriptionCount = bindings.size();
-        vertexInputState.pVertexBindingDescriptions = bindings.data();
-        vertexInputState.vertexAttributeDescriptionCount = attributeDescs.size();
-        vertexInputState.pVertexAttributeDescriptions = attributeDescs.data();
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-        VkPipelineViewportStateCreateInfo viewportState = {};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer = {};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_NONE; // TODO: implement cull mode
-        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-        VkPipelineMultisampleStateCreateInfo multisampling = {};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
-        for (size_t i = 0; i < colorAttachmentFormats.size(); i++) {
-            colorBlendAttachments.push_back(colorBlendAttachment);
-        }
+        attributeDescs.push_back(uv0Attribute);
+    }
 
-        VkPipelineColorBlendStateCreateInfo colorBlending = {};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.attachmentCount = colorBlendAttachments.size();
-        colorBlending.pAttachments = colorBlendAttachments.data();
+    VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.vertexBindingDescriptionCount = bindings.size();
+    vertexInputState.pVertexBindingDescriptions = bindings.data();
+    vertexInputState.vertexAttributeDescriptionCount = attributeDescs.size();
+    vertexInputState.pVertexAttributeDescriptions = attributeDescs.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE; // TODO: implement cull mode
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+    for (size_t i = 0; i < key.colorAttachmentFormats.size(); i++) {
+        colorBlendAttachments.push_back(colorBlendAttachment);
+    }
 
-        std::vector dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = colorBlendAttachments.size();
+    colorBlending.pAttachments = colorBlendAttachments.data();
 
-        VkPipelineDynamicStateCreateInfo dynamicState = {};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = dynamicStates.size();
-        dynamicState.pDynamicStates = dynamicStates.data();
+    std::vector dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = dynamicStates.size();
+    dynamicState.pDynamicStates = dynamicStates.data();
 
-        std::vector<VkDescriptorSetLayout> setLayouts;
-        for (auto &set : requestedSets) {
-            if (set.used) {
-                setLayouts.push_back(set.layout);
-            }
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    for (auto &set : requestedSets) {
+        if (set.used) {
+            setLayouts.push_back(set.layout);
         }
+    }
 
-        pipelineLayoutInfo.setLayoutCount = setLayouts.size();
-        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 
-        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
-        vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
 
-        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        if (passName != "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
-            depthStencil.depthTestEnable = VK_TRUE;
-        }
-        if (passName == "PASS_G_OPAQUE") {
-            depthStencil.depthWriteEnable = VK_TRUE;
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    if (request.passName != "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
+        depthStencil.depthTestEnable = VK_TRUE;
+    }
+    if (request.passName == "PASS_G_OPAQUE") {
+        depthStencil.depthWriteEnable = VK_TRUE;
+    }
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {};
+    pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipelineRenderingCreateInfo.colorAttachmentCount = key.colorAttachmentFormats.size();
+    pipelineRenderingCreateInfo.pColorAttachmentFormats = key.colorAttachmentFormats.data();
+    pipelineRenderingCreateInfo.depthAttachmentFormat = key.depthAttachmentFormat;
+
+    VkGraphicsPipelineCreateInfo createInfo = {};
+    createInfo.pNext = &pipelineRenderingCreateInfo;
+    createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    createInfo.stageCount = shaderStages.size();
+    createInfo.pStages = shaderStages.data();
+    createInfo.pVertexInputState = &vertexInputState;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewportState;
+    createInfo.pRasterizationState = &rasterizer;
+    createInfo.pMultisampleState = &multisampling;
+    createInfo.pColorBlendState = &colorBlending;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.pDepthStencilState = &depthStencil;
+    createInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &pipeline);
+
+    qInfo() << "Created" << pipeline << "for" << request.passName << "in" << request.shaderName;
+
+    return CachedPipeline{.pipeline = pipeline,
+                          .pipelineLayout = pipelineLayout,
+                          .setLayouts = setLayouts,
+                          .cachedDescriptors = {},
+                          .requestedSets = requestedSets,
+                          .vertexShader = request.vertexShader,
+                          .pixelShader = request.pixelShader};
+}
+
+GameRenderer::CachedPipeline *GameRenderer::findPipeline(const std::string_view passName,
+                                                         const physis_Shader &vertexShader,
+                                                         const physis_Shader &pixelShader,
+                                                         const std::string_view shaderName,
+                                                         const physis_MDL *mdl,
+                                                         const physis_Part *part,
+                                                         const std::vector<VkFormat> &colorAttachmentFormats,
+                                                         const VkFormat depthAttachmentFormat)
+{
+    auto key = makePipelineKey(passName, vertexShader, pixelShader, mdl, part, colorAttachmentFormats, depthAttachmentFormat);
+
+    const auto it = m_cachedPipelines.find(key);
+    if (it == m_cachedPipelines.end()) {
+        if (!m_pendingPipelines.contains(key)) {
+            qInfo() << "Creating pipeline for" << passName << "in" << shaderName;
+
+            m_pendingPipelines.insert(key);
+
+            // Everything except the shader bytecode is copied, since the model may be reloaded before the job gets to it
+            m_pipelineThreadPool.start([this,
+                                        request = PipelineRequest{.key = std::move(key),
+                                                                  .passName = std::string(passName),
+                                                                  .shaderName = std::string(shaderName),
+                                                                  .vertexShader = vertexShader,
+                                                                  .pixelShader = pixelShader}] {
+                auto pipeline = createPipeline(request);
+
+                QMutexLocker locker(&m_finishedPipelinesMutex);
+                m_finishedPipelines.emplace_back(request.key, std::move(pipeline));
+            });
         }
-        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-        depthStencil.maxDepthBounds = 1.0f;
-
-        VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {};
-        pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-        pipelineRenderingCreateInfo.colorAttachmentCount = colorAttachmentFormats.size();
-        pipelineRenderingCreateInfo.pColorAttachmentFormats = colorAttachmentFormats.data();
-        pipelineRenderingCreateInfo.depthAttachmentFormat = depthAttachmentFormat;
-
-        VkGraphicsPipelineCreateInfo createInfo = {};
-        createInfo.pNext = &pipelineRenderingCreateInfo;
-        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        createInfo.stageCount = shaderStages.size();
-        createInfo.pStages = shaderStages.data();
-        createInfo.pVertexInputState = &vertexInputState;
-        createInfo.pInputAssemblyState = &inputAssembly;
-        createInfo.pViewportState = &viewportState;
-        createInfo.pRasterizationState = &rasterizer;
-        createInfo.pMultisampleState = &multisampling;
-        createInfo.pColorBlendState = &colorBlending;
-        createInfo.pDynamicState = &dynamicState;
-        createInfo.pDepthStencilState = &depthStencil;
-        createInfo.layout = pipelineLayout;
-
-        VkPipeline pipeline = VK_NULL_HANDLE;
-        vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
-
-        qInfo() << "Created" << pipeline << "for hash" << hash;
-        m_cachedPipelines[hash] = CachedPipeline{.pipeline = pipeline,
-                                                 .pipelineLayout = pipelineLayout,
-                                                 .setLayouts = setLayouts,
-                                                 .cachedDescriptors = {},
-                                                 .requestedSets = requestedSets,
-                                                 .vertexShader = vertexShader,
-                                                 .pixelShader = pixelShader};
-    }
-
-    auto &pipeline = m_cachedPipelines[hash];
+
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+void GameRenderer::bindPipeline(VkCommandBuffer commandBuffer, CachedPipeline &pipeline, const physis_Shader &vertexShader, const physis_Shader &pixelShader)
+{
+    // Identical shaders from another package share this pipeline, so point it at the package that's currently loaded
+    pipeline.vertexShader = vertexShader;
+    pipeline.pixelShader = pixelShader;
+
+    if (pipeline.pipeline == m_boundPipeline) {
+        return;
+    }
+
+    flushDraws(commandBuffer);
+
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    m_boundPipeline = pipeline.pipeline;
+
+    // The sets may have been bound with an incompatible layout
+    m_boundDescriptorSets.clear();
 
     VkViewport viewport = {};
     viewport.width = m_device.swapChain->extent.width;
@@ -1352,15 +1222,303 @@ GameRenderer::CachedPipeline &GameRenderer::bindPipeline(VkCommandBuffer command
 
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
 
-    return pipeline;
+void GameRenderer::drawMaterialPart(VkCommandBuffer commandBuffer,
+                                    const std::string_view passName,
+                                    const size_t passIndex,
+                                    const DrawObject &object,
+                                    RenderPart &part,
+                                    const RenderMaterial &material,
+                                    const ShaderSelection &selection,
+                                    const std::vector<VkFormat> &colorAttachmentFormats,
+                                    const VkFormat depthAttachmentFormat)
+{
+    const physis_Shader &vertexShader = material.shaderPackage.vertex_shaders[selection.vertexShader];
+    const physis_Shader &pixelShader = material.shaderPackage.pixel_shaders[selection.pixelShader];
+
+    // The part's material and layout never change, so the pipeline only has to be looked up once
+    auto &pipeline = m_partPipelines[{&part, passIndex}];
+    if (pipeline == nullptr) {
+        pipeline = findPipeline(passName,
+                                vertexShader,
+                                pixelShader,
+                                material.mat.shpk_name,
+                                &object.model,
+                                &part.originalPart,
+                                colorAttachmentFormats,
+                                depthAttachmentFormat);
+        if (pipeline == nullptr) {
+            return;
+        }
+    }
+
+    bindPipeline(commandBuffer, *pipeline, vertexShader, pixelShader);
+    bindDescriptorSets(commandBuffer, *pipeline, &object, &material, passName);
+
+    drawPart(commandBuffer, part);
+}
+
+void GameRenderer::drawFullscreenPass(VkCommandBuffer commandBuffer,
+                                      const std::string_view passName,
+                                      const physis_SHPK &shaderPackage,
+                                      const ShaderSelection &selection,
+                                      const std::string_view shaderName,
+                                      CachedPipeline *&cachedPipeline,
+                                      const std::vector<VkFormat> &colorAttachmentFormats,
+                                      const VkFormat depthAttachmentFormat)
+{
+    const physis_Shader &vertexShader = shaderPackage.vertex_shaders[selection.vertexShader];
+    const physis_Shader &pixelShader = shaderPackage.pixel_shaders[selection.pixelShader];
+
+    if (cachedPipeline == nullptr) {
+        cachedPipeline = findPipeline(passName, vertexShader, pixelShader, shaderName, nullptr, nullptr, colorAttachmentFormats, depthAttachmentFormat);
+        if (cachedPipeline == nullptr) {
+            return;
+        }
+    }
+
+    bindPipeline(commandBuffer, *cachedPipeline, vertexShader, pixelShader);
+    bindDescriptorSets(commandBuffer, *cachedPipeline, nullptr, nullptr, passName);
+
+    flushDraws(commandBuffer);
+
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
+    m_boundStreamCount = 0; // so the next part binds its streams again
+
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+}
+
+RenderMaterial &GameRenderer::materialFor(DrawObject &object, const RenderPart &part)
+{
+    if (static_cast<size_t>(part.materialIndex + 1) > object.materials.size()) {
+        return object.materials[0]; // TODO: better fallback
+    }
+    return object.materials[part.materialIndex];
+}
+
+std::optional<ShaderSelection> GameRenderer::selectShaders(physis_SHPK &shaderPackage, const uint32_t selector, const size_t passIndex)
+{
+    const physis_SHPKNode node = physis_shpk_get_node(&shaderPackage, selector);
+
+    // check if invalid
+    if (node.pass_count == 0) {
+        return std::nullopt;
+    }
+
+    // this is an index into the node's pass array, not to get confused with the global one we always follow.
+    const int passIndice = node.pass_indices[passIndex];
+    if (passIndice == INVALID_PASS) {
+        return std::nullopt;
+    }
+
+    const Pass currentPass = node.passes[passIndice];
+    Q_ASSERT(currentPass.id == physis_shpk_crc(passes[passIndex].c_str()));
+
+    return ShaderSelection{.vertexShader = currentPass.vertex_shader, .pixelShader = currentPass.pixel_shader};
+}
+
+const ShaderSelection *GameRenderer::shaderSelection(RenderMaterial &material, const bool skinned, const size_t passIndex) const
+{
+    // Materials don't know which renderer they'll be drawn with, so they're prepared the first time they're drawn here
+    if (material.shaderSelections[skinned].empty()) {
+        prepareMaterial(material);
+    }
+
+    const auto &selections = material.shaderSelections[skinned];
+    if (passIndex >= selections.size() || !selections[passIndex]) {
+        return nullptr;
+    }
+
+    return &*selections[passIndex];
+}
+
+void GameRenderer::prepareMaterial(RenderMaterial &material) const
+{
+    auto &shaderPackage = material.shaderPackage;
+
+    std::vector<uint32_t> systemKeys;
+    for (uint32_t j = 0; j < shaderPackage.num_system_keys; j++) {
+        systemKeys.push_back(shaderPackage.system_keys[j].default_value);
+    }
+
+    std::vector<uint32_t> materialKeys;
+    for (uint32_t j = 0; j < shaderPackage.num_material_keys; j++) {
+        auto id = shaderPackage.material_keys[j].id;
+
+        bool found = false;
+        for (uint32_t z = 0; z < material.mat.num_shader_keys; z++) {
+            if (material.mat.shader_keys[z].category == id) {
+                materialKeys.push_back(material.mat.shader_keys[z].value);
+                found = true;
+            }
+        }
+
+        // Fall back to default if needed
+        if (!found) {
+            materialKeys.push_back(shaderPackage.material_keys[j].default_value);
+        }
+    }
+
+    std::vector subviewKeys = {physis_shpk_crc("Default"), physis_shpk_crc("SUB_VIEW_MAIN")};
+
+    // The same material can end up on skinned and rigid models, so both are resolved
+    for (const bool skinned : {false, true}) {
+        std::vector<uint32_t> sceneKeys;
+        for (uint32_t j = 0; j < shaderPackage.num_scene_keys; j++) {
+            auto id = shaderPackage.scene_keys[j].id;
+
+            if (id == physis_shpk_crc("TransformView")) {
+                sceneKeys.push_back(physis_shpk_crc(skinned ? "TransformViewSkin" : "TransformViewRigid"));
+            } else {
+                // Fall back to default if needed
+                sceneKeys.push_back(shaderPackage.scene_keys[j].default_value);
+            }
+        }
+
+        // The opaque passes use the default system keys, but the composite pass doesn't use any
+        const uint32_t opaqueSelector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
+                                                                                 systemKeys.size(),
+                                                                                 sceneKeys.data(),
+                                                                                 sceneKeys.size(),
+                                                                                 materialKeys.data(),
+                                                                                 materialKeys.size(),
+                                                                                 subviewKeys.data(),
+                                                                                 subviewKeys.size());
+        const uint32_t compositeSelector = physis_shpk_build_selector_from_all_keys(nullptr,
+                                                                                    0,
+                                                                                    sceneKeys.data(),
+                                                                                    sceneKeys.size(),
+                                                                                    materialKeys.data(),
+                                                                                    materialKeys.size(),
+                                                                                    subviewKeys.data(),
+                                                                                    subviewKeys.size());
+
+        auto &selections = material.shaderSelections[skinned];
+        selections.assign(passes.size(), std::nullopt);
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (passes[i] == "PASS_G_OPAQUE" || passes[i] == "PASS_Z_OPAQUE") {
+                selections[i] = selectShaders(shaderPackage, opaqueSelector, i);
+            } else if (passes[i] == "PASS_COMPOSITE_SEMITRANSPARENCY") {
+                selections[i] = selectShaders(shaderPackage, compositeSelector, i);
+            }
+        }
+    }
+}
+
+void GameRenderer::collectFinishedPipelines()
+{
+    QMutexLocker locker(&m_finishedPipelinesMutex);
+    for (auto &[key, pipeline] : m_finishedPipelines) {
+        m_pendingPipelines.erase(key);
+        m_cachedPipelines.emplace(std::move(key), std::move(pipeline));
+    }
+    m_finishedPipelines.clear();
+}
+
+GameRenderer::PipelineKey GameRenderer::makePipelineKey(const std::string_view passName,
+                                                       const physis_Shader &vertexShader,
+                                                       const physis_Shader &pixelShader,
+                                                       const physis_MDL *mdl,
+                                                       const physis_Part *part,
+                                                       const std::vector<VkFormat> &colorAttachmentFormats,
+                                                       const VkFormat depthAttachmentFormat)
+{
+    PipelineKey key{
+        .vertexShader = shaderHash(vertexShader),
+        .pixelShader = shaderHash(pixelShader),
+        .pass = passId(passName),
+        .streamStrides = {},
+        .vertexElements = std::nullopt,
+        .colorAttachmentFormats = colorAttachmentFormats,
+        .depthAttachmentFormat = depthAttachmentFormat,
+    };
+
+    // Same inputs that createPipeline() builds the vertex input state from
+    if (part != nullptr) {
+        for (uintptr_t i = 0; i < part->num_streams; i++) {
+            key.streamStrides.push_back(part->stream_strides[i]);
+        }
+    }
+    if (mdl != nullptr) {
+        auto &elements = key.vertexElements.emplace();
+        for (uintptr_t i = 0; i < mdl->lods[0].num_vertex_elements; i++) {
+            const auto &element = mdl->lods[0].vertex_elements[i];
+            elements.push_back(VertexElement{.stream = static_cast<uint32_t>(element.stream),
+                                             .offset = static_cast<uint32_t>(element.offset),
+                                             .type = element.vertex_type,
+                                             .usage = element.vertex_usage});
+        }
+    }
+
+    return key;
+}
+
+size_t GameRenderer::PipelineKeyHash::operator()(const PipelineKey &key) const
+{
+    // The shader hashes are already well distributed, the rest only has to be mixed in
+    size_t hash = key.vertexShader[0] ^ (key.pixelShader[0] * 31) ^ key.pass;
+
+    const auto combine = [&hash](const size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    };
+
+    for (const auto stride : key.streamStrides) {
+        combine(stride);
+    }
+    if (key.vertexElements) {
+        for (const auto &element : *key.vertexElements) {
+            combine(element.stream);
+            combine(element.offset);
+            combine(static_cast<size_t>(element.type));
+            combine(static_cast<size_t>(element.usage));
+        }
+    }
+    for (const auto format : key.colorAttachmentFormats) {
+        combine(format);
+    }
+    combine(key.depthAttachmentFormat);
+
+    return hash;
+}
+
+std::array<uint64_t, 2> GameRenderer::shaderHash(const physis_Shader &shader)
+{
+    if (const auto it = m_shaderHashes.find(shader.bytecode); it != m_shaderHashes.end()) {
+        return it->second;
+    }
+
+    const QByteArray digest =
+        QCryptographicHash::hash(QByteArrayView(reinterpret_cast<const char *>(shader.bytecode), shader.len), QCryptographicHash::Sha256);
+
+    std::array<uint64_t, 2> hash{};
+    memcpy(hash.data(), digest.constData(), sizeof(hash));
+
+    m_shaderHashes[shader.bytecode] = hash;
+
+    return hash;
+}
+
+uint32_t GameRenderer::passId(const std::string_view passName)
+{
+    if (const auto it = m_passIds.find(passName); it != m_passIds.end()) {
+        return it->second;
+    }
+
+    const std::string name(passName);
+    const uint32_t id = physis_shpk_crc(name.c_str());
+    m_passIds.emplace(name, id);
+
+    return id;
 }
 
 VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
                                                   const CachedPipeline &cachedPipeline,
                                                   const size_t i,
                                                   const RenderMaterial *material,
-                                                  const std::string_view pass) const
+                                                  const std::string_view pass,
+                                                  DescriptorDependencies &dependencies) const
 {
     VkDescriptorSet set;
 
@@ -1385,6 +1543,9 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
     bufferInfo.reserve(cachedPipeline.requestedSets[i].bindings.size());
     imageInfo.reserve(cachedPipeline.requestedSets[i].bindings.size());
 
+    // Per-frame buffers are bound as this frame's copy, and the set is only reused by this frame
+    const uint32_t frame = m_device.swapChain->currentFrame;
+
     int j = 0;
     int z = 0;
     uint32_t p = 0;
@@ -1450,6 +1611,14 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
                         qInfo() << "Unspecified image at" << j;
                     } else {
                         qInfo() << "Requesting image" << name << "at" << j;
+
+                        // Even the ones that fall back to a dummy texture depend on what the material has
+                        if (std::ranges::any_of(materialSamplers, [name](const char *sampler) {
+                                return strcmp(name, sampler) == 0;
+                            })) {
+                            dependencies.material = true;
+                        }
+
                         if (strcmp(name, "g_SamplerGBuffer") == 0) {
                             info->imageView = m_normalGBuffer.imageView;
                         } else if (strcmp(name, "g_SamplerViewPosition") == 0) {
@@ -1521,14 +1690,19 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
                     info->range = buffer.size;
                 };
 
-                auto bindBuffer = [this, &useUniformBuffer, &info, j, &object, material](const char *name) {
+                auto bindBuffer = [this, &useUniformBuffer, &info, j, &object, material, &dependencies, frame](const char *name) {
                     qInfo() << "Requesting" << name << "at" << j;
 
                     if (strcmp(name, "g_CameraParameter") == 0) {
-                        useUniformBuffer(g_CameraParameter);
+                        useUniformBuffer(g_CameraParameter[frame]);
+                        dependencies.frame = true;
                     } else if (strcmp(name, "g_JointMatrixArray") == 0 || strcmp(name, "g_JointMatrixArrayPrev") == 0) {
                         Q_ASSERT(object != nullptr);
-                        useUniformBuffer(object->boneInfoBuffer);
+                        info->buffer = object->boneInfoBuffer.buffer;
+                        info->offset = DrawObject::boneInfoOffset(frame);
+                        info->range = DrawObject::boneInfoSize;
+                        dependencies.object = true;
+                        dependencies.frame = true;
                     } else if (strcmp(name, "g_InstanceParameter") == 0) {
                         useUniformBuffer(g_InstanceParameter);
                     } else if (strcmp(name, "g_ModelParameter") == 0) {
@@ -1537,6 +1711,7 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
                         Q_ASSERT(material);
                         Q_ASSERT(material->materialBuffer.buffer);
                         useUniformBuffer(material->materialBuffer);
+                        dependencies.material = true;
                     } else if (strcmp(name, "g_LightParam") == 0) {
                         useUniformBuffer(g_LightParam);
                     } else if (strcmp(name, "g_CommonParameter") == 0) {
@@ -1556,7 +1731,8 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object,
                     } else if (strcmp(name, "g_PbrParameterCommon") == 0) {
                         useUniformBuffer(g_PbrParameterCommon);
                     } else if (strcmp(name, "g_WorldViewMatrix") == 0) {
-                        useUniformBuffer(g_WorldViewMatrix);
+                        useUniformBuffer(g_WorldViewMatrix[frame]);
+                        dependencies.frame = true;
                     } else if (strcmp(name, "g_FogParameter") == 0) {
                         useUniformBuffer(g_FogParameter);
                     } else {
@@ -1682,20 +1858,163 @@ void GameRenderer::bindDescriptorSets(const VkCommandBuffer commandBuffer,
                                       CachedPipeline &pipeline,
                                       const DrawObject *object,
                                       const RenderMaterial *material,
-                                      const std::string_view pass) const
+                                      const std::string_view pass)
 {
+    const uint32_t frame = m_device.swapChain->currentFrame;
+
+    m_boundDescriptorSets.resize(std::max(m_boundDescriptorSets.size(), pipeline.setLayouts.size()), VK_NULL_HANDLE);
+
     for (size_t i = 0; i < pipeline.setLayouts.size(); i++) {
-        if (!pipeline.cachedDescriptors.contains(i)) {
-            if (const auto descriptor = createDescriptorFor(object, pipeline, i, material, pass); descriptor != VK_NULL_HANDLE) {
-                pipeline.cachedDescriptors[i] = descriptor;
-            } else {
+        VkDescriptorSet descriptor = VK_NULL_HANDLE;
+        if (const auto dependencies = pipeline.descriptorDependencies.find(i); dependencies != pipeline.descriptorDependencies.end()) {
+            if (const auto it = pipeline.cachedDescriptors.find(descriptorKey(i, frame, dependencies->second, object, material));
+                it != pipeline.cachedDescriptors.end()) {
+                descriptor = it->second;
+            }
+        }
+
+        if (descriptor == VK_NULL_HANDLE) {
+            DescriptorDependencies dependencies;
+            descriptor = createDescriptorFor(object, pipeline, i, material, pass, dependencies);
+            if (descriptor == VK_NULL_HANDLE) {
                 continue;
             }
+
+            pipeline.descriptorDependencies[i] = dependencies;
+            pipeline.cachedDescriptors[descriptorKey(i, frame, dependencies, object, material)] = descriptor;
+        }
+
+        if (m_boundDescriptorSets[i] == descriptor) {
+            continue;
         }
 
+        flushDraws(commandBuffer);
+
         // TODO: we can pass all descriptors in one function call
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, i, 1, &pipeline.cachedDescriptors[i], 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, i, 1, &descriptor, 0, nullptr);
+        m_boundDescriptorSets[i] = descriptor;
+    }
+}
+
+GameRenderer::DescriptorKey GameRenderer::descriptorKey(const size_t i,
+                                                        const uint32_t frame,
+                                                        const DescriptorDependencies &dependencies,
+                                                        const DrawObject *object,
+                                                        const RenderMaterial *material)
+{
+    // Copies of the same material share their parameter buffer, so it identifies the material's contents too
+    const VkBuffer objectBuffer = dependencies.object && object != nullptr ? object->boneInfoBuffer.buffer : VK_NULL_HANDLE;
+    const VkBuffer materialBuffer = dependencies.material && material != nullptr ? material->materialBuffer.buffer : VK_NULL_HANDLE;
+
+    return {i, dependencies.frame ? frame : 0, objectBuffer, materialBuffer};
+}
+
+void GameRenderer::freeDescriptorSets()
+{
+    m_device.waitForIdle();
+
+    for (auto &pipeline : m_cachedPipelines | std::views::values) {
+        for (const auto &descriptor : pipeline.cachedDescriptors | std::views::values) {
+            vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &descriptor);
+        }
+        pipeline.cachedDescriptors.clear();
+    }
+}
+
+void GameRenderer::drawPart(const VkCommandBuffer commandBuffer, const RenderPart &part)
+{
+    // All streams of a part live in the geometry pages, and are bound in one go with their own offsets
+    // MDL files have at most three vertex streams
+    std::array<VkBuffer, 3> streamBuffers{};
+    std::array<VkDeviceSize, 3> streamOffsets{};
+
+    const uint32_t streamCount = std::min<uint32_t>(part.originalPart.num_streams, streamBuffers.size());
+    for (uint32_t j = 0; j < streamCount; j++) {
+        streamBuffers[j] = m_device.geometry->buffer(GeometryManager::Kind::Vertex, part.streams[j]);
+        streamOffsets[j] = part.streams[j].offset;
+    }
+
+    if (streamCount != m_boundStreamCount || streamBuffers != m_boundStreamBuffers || streamOffsets != m_boundStreamOffsets) {
+        flushDraws(commandBuffer);
+
+        vkCmdBindVertexBuffers(commandBuffer, 0, streamCount, streamBuffers.data(), streamOffsets.data());
+        m_boundStreamBuffers = streamBuffers;
+        m_boundStreamOffsets = streamOffsets;
+        m_boundStreamCount = streamCount;
+    }
+
+    // Most parts share the same index page, so this rarely has to rebind anything
+    const VkBuffer indexBuffer = m_device.geometry->buffer(GeometryManager::Kind::Index, part.indices);
+    if (indexBuffer != m_boundIndexBuffer) {
+        flushDraws(commandBuffer);
+
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        m_boundIndexBuffer = indexBuffer;
+    }
+
+    // The buffer is sized for every part in every pass, so this is only a safety net
+    if (m_queuedDraws >= m_indirectCapacity) {
+        flushDraws(commandBuffer);
+        vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, part.firstIndex(), 0, 0);
+        return;
+    }
+
+    auto commands = static_cast<VkDrawIndexedIndirectCommand *>(m_indirectBuffers[m_device.swapChain->currentFrame].mapped());
+    commands[m_queuedDraws++] = VkDrawIndexedIndirectCommand{
+        .indexCount = static_cast<uint32_t>(part.numIndices),
+        .instanceCount = 1,
+        .firstIndex = part.firstIndex(),
+        .vertexOffset = 0,
+        .firstInstance = 0,
+    };
+}
+
+void GameRenderer::flushDraws(const VkCommandBuffer commandBuffer)
+{
+    const uint32_t count = m_queuedDraws - m_firstPendingDraw;
+    if (count == 0) {
+        return;
+    }
+
+    const Buffer &buffer = m_indirectBuffers[m_device.swapChain->currentFrame];
+    const VkDeviceSize offset = m_firstPendingDraw * sizeof(VkDrawIndexedIndirectCommand);
+
+    if (m_device.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(commandBuffer, buffer.buffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        for (uint32_t j = 0; j < count; j++) {
+            vkCmdDrawIndexedIndirect(commandBuffer, buffer.buffer, offset + j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
     }
+
+    m_firstPendingDraw = m_queuedDraws;
+}
+
+void GameRenderer::prepareIndirectBuffer(const size_t count)
+{
+    // The fence for this frame was already waited on, so nothing on the GPU is reading this buffer anymore
+    auto &buffer = m_indirectBuffers[m_device.swapChain->currentFrame];
+
+    const size_t requiredSize = std::max<size_t>(count, 1) * sizeof(VkDrawIndexedIndirectCommand);
+    if (requiredSize > buffer.size) {
+        m_device.destroyBuffer(buffer);
+
+        // Leave some room, so the buffer doesn't have to be recreated every time a few more models are loaded
+        buffer = m_device.createBuffer(std::max(requiredSize * 2, initialIndirectBufferSize), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        m_device.nameBuffer(buffer, "Game Renderer Indirect Commands");
+    }
+
+    m_indirectCapacity = static_cast<uint32_t>(buffer.size / sizeof(VkDrawIndexedIndirectCommand));
+    m_queuedDraws = 0;
+    m_firstPendingDraw = 0;
+}
+
+void GameRenderer::resetBoundState()
+{
+    m_boundPipeline = VK_NULL_HANDLE;
+    m_boundDescriptorSets.clear();
+    m_boundStreamCount = 0;
+    m_boundIndexBuffer = VK_NULL_HANDLE;
 }
 
 Device &GameRenderer::device()
@@ -1703,7 +2022,30 @@ Device &GameRenderer::device()
     return m_device;
 }
 
+void GameRenderer::releaseDrawObject(const DrawObject &object)
+{
+    // The parts are about to be freed, and their addresses may be reused by the next ones
+    for (const auto &lod : object.lods) {
+        for (const auto &part : lod.parts) {
+            for (size_t i = 0; i < passes.size(); i++) {
+                m_partPipelines.erase({&part, i});
+            }
+        }
+    }
+}
+
 void GameRenderer::freeResources()
 {
-    // TODO: stub
+    // The pipeline jobs read the bytecode of the shader packages too
+    m_pipelineThreadPool.waitForDone();
+    collectFinishedPipelines();
+
+    // The models are usually destroyed right after this
+    m_partPipelines.clear();
+
+    // The shader packages are about to be freed, and their bytecode pointers may be reused by the next ones
+    m_shaderHashes.clear();
+
+    // Same with the buffers that the descriptor sets are keyed by
+    freeDescriptorSets();
 }
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "geometrymanager.h"
+
+#include "device.h"
+
+#include <algorithm>
+
+// A zone's worth of bg models usually fits into one page of each
+static constexpr VkDeviceSize vertexPageSize = 64 * 1024 * 1024;
+static constexpr VkDeviceSize indexPageSize = 16 * 1024 * 1024;
+
+GeometryManager::GeometryManager(Device &device)
+    : m_device(device)
+{
+}
+
+GeometryManager::~GeometryManager()
+{
+    for (auto &page : m_vertexPages) {
+        m_device.destroyBuffer(page.buffer);
+    }
+    for (auto &page : m_indexPages) {
+        m_device.destroyBuffer(page.buffer);
+    }
+}
+
+GeometryRange GeometryManager::upload(const Kind kind, const void *data, const size_t size, const VkDeviceSize alignment)
+{
+    if (size == 0) {
+        return {};
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    auto &kindPages = pages(kind);
+
+    GeometryRange range;
+    range.size = size;
+
+    for (size_t i = 0; i < kindPages.size(); i++) {
+        if (const auto offset = kindPages[i].ranges.allocate(size, alignment)) {
+            range.page = static_cast<int>(i);
+            range.offset = *offset;
+            break;
+        }
+    }
+
+    if (!range.isValid()) {
+        // Models bigger than a page get one to themselves
+        const VkDeviceSize pageSize = std::max<VkDeviceSize>(kind == Kind::Vertex ? vertexPageSize : indexPageSize, size);
+        const VkBufferUsageFlags usage = kind == Kind::Vertex ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+        Page page{.buffer = m_device.createBuffer(pageSize, usage, MemoryUsage::GpuOnly), .ranges = RangeAllocator(pageSize)};
+        m_device.nameBuffer(page.buffer, kind == Kind::Vertex ? "Geometry Vertex Page" : "Geometry Index Page");
+
+        range.page = static_cast<int>(kindPages.size());
+        range.offset = page.ranges.allocate(size, alignment).value_or(0);
+
+        kindPages.push_back(page);
+    }
+
+    m_device.uploadQueue->uploadToBuffer(kindPages[range.page].buffer, data, size, range.offset);
+
+    return range;
+}
+
+void GeometryManager::free(const Kind kind, GeometryRange &range)
+{
+    if (!range.isValid()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    // Pages are never released, the next model that's loaded will most likely reuse the space
+    pages(kind)[range.page].ranges.free(range.offset, range.size);
+    range = {};
+}
+
+VkBuffer GeometryManager::buffer(const Kind kind, const GeometryRange &range) const
+{
+    if (!range.isValid()) {
+        return VK_NULL_HANDLE;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    return pages(kind)[range.page].buffer.buffer;
+}
+
+std::vector<GeometryManager::Page> &GeometryManager::pages(const Kind kind)
+{
+    return kind == Kind::Vertex ? m_vertexPages : m_indexPages;
+}
+
+const std::vector<GeometryManager::Page> &GeometryManager::pages(const Kind kind) const
+{
+    return kind == Kind::Vertex ? m_vertexPages : m_indexPages;
+}
@@ -66,10 +66,8 @@ void ImGuiPass::render(const uint32_t imageIndex, const VkCommandBuffer commandB
     if (vertexBuffer.size == 0 || indexBuffer.size == 0)
         return;
 
-    ImDrawVert *vertexData = nullptr;
-    ImDrawIdx *indexData = nullptr;
-    vkMapMemory(m_renderer.device().device, vertexBuffer.memory, 0, vertexBuffer.size, 0, reinterpret_cast<void **>(&vertexData));
-    vkMapMemory(m_renderer.device().device, indexBuffer.memory, 0, indexBuffer.size, 0, reinterpret_cast<void **>(&indexData));
+    auto vertexData = static_cast<ImDrawVert *>(vertexBuffer.mapped());
+    auto indexData = static_cast<ImDrawIdx *>(indexBuffer.mapped());
 
     for (int i = 0; i < drawData->CmdListsCount; i++) {
         const ImDrawList *cmd_list = drawData->CmdLists[i];
@@ -81,9 +79,6 @@ void ImGuiPass::render(const uint32_t imageIndex, const VkCommandBuffer commandB
         indexData += cmd_list->IdxBuffer.Size;
     }
 
-    vkUnmapMemory(m_renderer.device().device, vertexBuffer.memory);
-    vkUnmapMemory(m_renderer.device().device, indexBuffer.memory);
-
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
     constexpr VkDeviceSize offset = 0;
@@ -301,7 +296,7 @@ void ImGuiPass::createPipeline()
     pipelineInfo.pDepthStencilState = &depthStencilStateCreateInfo;
     pipelineInfo.renderPass = m_renderer.presentationRenderPass();
 
-    vkCreateGraphicsPipelines(m_renderer.device().device, nullptr, 1, &pipelineInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_renderer.device().device, m_renderer.device().pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline);
 
     vkDestroyShaderModule(m_renderer.device().device, fragShaderModule, nullptr);
     vkDestroyShaderModule(m_renderer.device().device, vertShaderModule, nullptr);
@@ -0,0 +1,278 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "memoryallocator.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+// Large enough that a whole zone fits in a handful of blocks, small enough that it doesn't matter if one ends up mostly empty
+static constexpr VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+
+MemoryAllocator::MemoryAllocator(const VkPhysicalDevice physicalDevice, const VkDevice device)
+    : m_device(device)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+    // One buffer and one image pool for every memory type
+    m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        m_pools[poolIndex(i, ResourceKind::Buffer)] = Pool{.memoryTypeIndex = i, .kind = ResourceKind::Buffer};
+        m_pools[poolIndex(i, ResourceKind::Image)] = Pool{.memoryTypeIndex = i, .kind = ResourceKind::Image};
+    }
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    size_t leakedCount = m_dedicatedCount;
+    for (auto &pool : m_pools) {
+        for (auto &block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                leakedCount += block.ranges.allocationCount();
+                freeDeviceMemory(block.memory, block.mapped);
+            }
+        }
+    }
+
+    if (leakedCount > 0) {
+        qWarning() << leakedCount << "allocations were never freed";
+    }
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, const MemoryUsage usage, const ResourceKind kind)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    for (const uint32_t memoryTypeIndex : memoryTypeCandidates(requirements.memoryTypeBits, usage)) {
+        const VkDeviceSize size = blockSize(memoryTypeIndex);
+
+        // Huge resources (like render targets at high resolutions) would waste most of a block
+        if (requirements.size > size / 2) {
+            Allocation allocation;
+            allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+            if (allocation.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            allocation.size = requirements.size;
+
+            m_dedicatedCount++;
+            m_dedicatedBytes += requirements.size;
+
+            return allocation;
+        }
+
+        const int index = poolIndex(memoryTypeIndex, kind);
+        auto &pool = m_pools[index];
+
+        const auto makeAllocation = [index, &requirements](const Block &block, const int blockIndex, const VkDeviceSize offset) {
+            Allocation allocation;
+            allocation.memory = block.memory;
+            allocation.offset = offset;
+            allocation.size = requirements.size;
+            allocation.mapped = block.mapped ? static_cast<uint8_t *>(block.mapped) + offset : nullptr;
+            allocation.pool = index;
+            allocation.block = blockIndex;
+
+            return allocation;
+        };
+
+        for (size_t i = 0; i < pool.blocks.size(); i++) {
+            auto &block = pool.blocks[i];
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            if (const auto offset = block.ranges.allocate(requirements.size, alignment)) {
+                return makeAllocation(block, static_cast<int>(i), *offset);
+            }
+        }
+
+        // Nothing fits, so we need a new block. Reuse an empty slot if there is one, so block indices stay stable.
+        Block newBlock;
+        newBlock.memory = allocateDeviceMemory(size, memoryTypeIndex, &newBlock.mapped);
+        if (newBlock.memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        newBlock.ranges = RangeAllocator(size);
+
+        auto emptySlot = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const Block &other) {
+            return other.memory == VK_NULL_HANDLE;
+        });
+        if (emptySlot == pool.blocks.end()) {
+            emptySlot = pool.blocks.insert(pool.blocks.end(), newBlock);
+        } else {
+            *emptySlot = newBlock;
+        }
+
+        const auto offset = emptySlot->ranges.allocate(requirements.size, alignment);
+
+        return makeAllocation(*emptySlot, static_cast<int>(std::distance(pool.blocks.begin(), emptySlot)), offset.value_or(0));
+    }
+
+    qWarning() << "Failed to allocate" << requirements.size << "bytes of device memory";
+
+    return {};
+}
+
+void MemoryAllocator::free(Allocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (allocation.pool == -1) {
+        freeDeviceMemory(allocation.memory, allocation.mapped);
+
+        m_dedicatedCount--;
+        m_dedicatedBytes -= allocation.size;
+    } else {
+        auto &pool = m_pools[allocation.pool];
+        auto &block = pool.blocks[allocation.block];
+
+        block.ranges.free(allocation.offset, allocation.size);
+
+        // Keep at least one block around, so a model being reloaded doesn't allocate and free a whole block every time
+        if (block.ranges.allocationCount() == 0) {
+            const auto liveBlocks = std::count_if(pool.blocks.cbegin(), pool.blocks.cend(), [](const Block &other) {
+                return other.memory != VK_NULL_HANDLE;
+            });
+            if (liveBlocks > 1) {
+                freeDeviceMemory(block.memory, block.mapped);
+                block = Block{};
+            }
+        }
+    }
+
+    allocation = {};
+}
+
+MemoryAllocator::Statistics MemoryAllocator::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    Statistics statistics;
+    statistics.dedicatedCount = m_dedicatedCount;
+    statistics.dedicatedBytes = m_dedicatedBytes;
+    statistics.deviceAllocationCount = m_deviceAllocationCount;
+
+    for (const auto &pool : m_pools) {
+        PoolStatistics poolStatistics;
+        poolStatistics.memoryTypeIndex = pool.memoryTypeIndex;
+        poolStatistics.kind = pool.kind;
+
+        for (const auto &block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            poolStatistics.blockCount++;
+            poolStatistics.allocationCount += block.ranges.allocationCount();
+            poolStatistics.reservedBytes += block.ranges.size();
+            poolStatistics.usedBytes += block.ranges.usedBytes();
+        }
+
+        if (poolStatistics.blockCount > 0) {
+            statistics.pools.push_back(poolStatistics);
+        }
+    }
+
+    return statistics;
+}
+
+void MemoryAllocator::logStatistics() const
+{
+    const auto stats = statistics();
+
+    qInfo() << "Device memory allocations:" << stats.deviceAllocationCount;
+    for (const auto &pool : stats.pools) {
+        qInfo() << "  Memory type" << pool.memoryTypeIndex << (pool.kind == ResourceKind::Buffer ? "buffers:" : "images:") << pool.allocationCount
+                << "allocations in" << pool.blockCount << "blocks," << pool.usedBytes << "of" << pool.reservedBytes << "bytes used";
+    }
+    qInfo() << "  Dedicated:" << stats.dedicatedCount << "allocations," << stats.dedicatedBytes << "bytes";
+}
+
+std::vector<uint32_t> MemoryAllocator::memoryTypeCandidates(const uint32_t typeBits, const MemoryUsage usage) const
+{
+    VkMemoryPropertyFlags required = 0;
+    VkMemoryPropertyFlags preferred = 0;
+    switch (usage) {
+    case MemoryUsage::GpuOnly:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    case MemoryUsage::CpuToGpu:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; // Resizable BAR or integrated GPUs
+        break;
+    }
+
+    std::vector<uint32_t> preferredTypes, otherTypes;
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        const VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if (!(typeBits & 1 << i) || (flags & required) != required) {
+            continue;
+        }
+
+        if ((flags & preferred) == preferred) {
+            preferredTypes.push_back(i);
+        } else {
+            otherTypes.push_back(i);
+        }
+    }
+
+    preferredTypes.insert(preferredTypes.end(), otherTypes.cbegin(), otherTypes.cend());
+
+    return preferredTypes;
+}
+
+VkDeviceSize MemoryAllocator::blockSize(const uint32_t memoryTypeIndex) const
+{
+    // Small heaps (like the 256 MiB BAR without resizable BAR) shouldn't be eaten up by only a few blocks
+    const uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    const VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+    return std::min(defaultBlockSize, heapSize / 8);
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex, void **mapped)
+{
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+
+    // Writes to non-coherent memory would need explicit flushes, so anything landing there is filled through a staging copy instead
+    constexpr VkMemoryPropertyFlags mappableFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    *mapped = nullptr;
+    if ((m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & mappableFlags) == mappableFlags) {
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    }
+
+    m_deviceAllocationCount++;
+
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(const VkDeviceMemory memory, void *mapped)
+{
+    if (mapped) {
+        vkUnmapMemory(m_device, memory);
+    }
+    vkFreeMemory(m_device, memory, nullptr);
+
+    m_deviceAllocationCount--;
+}
+
+int MemoryAllocator::poolIndex(const uint32_t memoryTypeIndex, const ResourceKind kind) const
+{
+    return static_cast<int>(memoryTypeIndex * 2 + (kind == ResourceKind::Image ? 1 : 0));
+}
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "rangeallocator.h"
+
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(const VkDeviceSize size)
+    : m_size(size)
+    , m_freeBytes(size)
+{
+    if (size > 0) {
+        m_freeRanges.push_back(FreeRange{.offset = 0, .size = size});
+    }
+}
+
+std::optional<VkDeviceSize> RangeAllocator::allocate(const VkDeviceSize size, const VkDeviceSize alignment)
+{
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+        const VkDeviceSize alignedOffset = (it->offset + alignment - 1) / alignment * alignment;
+        const VkDeviceSize end = it->offset + it->size;
+        if (alignedOffset + size > end) {
+            continue;
+        }
+
+        // Whatever is left before and after the allocation stays free
+        const FreeRange before{.offset = it->offset, .size = alignedOffset - it->offset};
+        const FreeRange after{.offset = alignedOffset + size, .size = end - (alignedOffset + size)};
+
+        it = m_freeRanges.erase(it);
+        if (after.size > 0) {
+            it = m_freeRanges.insert(it, after);
+        }
+        if (before.size > 0) {
+            m_freeRanges.insert(it, before);
+        }
+
+        m_freeBytes -= size;
+        m_allocationCount++;
+
+        return alignedOffset;
+    }
+
+    return std::nullopt;
+}
+
+void RangeAllocator::free(const VkDeviceSize offset, const VkDeviceSize size)
+{
+    auto it = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), offset, [](const FreeRange &range, const VkDeviceSize value) {
+        return range.offset < value;
+    });
+    it = m_freeRanges.insert(it, FreeRange{.offset = offset, .size = size});
+
+    // Merge with the following range
+    if (const auto next = std::next(it); next != m_freeRanges.end() && it->offset + it->size == next->offset) {
+        it->size += next->size;
+        m_freeRanges.erase(next);
+    }
+
+    // And the previous one
+    if (it != m_freeRanges.begin()) {
+        if (const auto previous = std::prev(it); previous->offset + previous->size == it->offset) {
+            previous->size += it->size;
+            m_freeRanges.erase(it);
+        }
+    }
+
+    m_freeBytes += size;
+    m_allocationCount--;
+}
+
+VkDeviceSize RangeAllocator::size() const
+{
+    return m_size;
+}
+
+VkDeviceSize RangeAllocator::usedBytes() const
+{
+    return m_size - m_freeBytes;
+}
+
+size_t RangeAllocator::allocationCount() const
+{
+    return m_allocationCount;
+}
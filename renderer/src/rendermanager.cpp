@@ -3,7 +3,11 @@
 
 #include "rendermanager.h"
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <array>
 #include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
@@ -233,6 +237,12 @@ RenderManager::RenderManager(FileCache &cache)
     enabledFeatures.imageCubeArray = VK_TRUE;
     enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
 
+    // Optional, the renderers fall back to one indirect draw at a time without it
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(m_device->physicalDevice, &supportedFeatures);
+    enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    m_device->multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
     VkPhysicalDeviceDynamicRenderingUnusedAttachmentsFeaturesEXT unusedAttachmentsFeaturesExt{};
     unusedAttachmentsFeaturesExt.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_UNUSED_ATTACHMENTS_FEATURES_EXT;
     unusedAttachmentsFeaturesExt.dynamicRenderingUnusedAttachments = VK_TRUE;
@@ -269,6 +279,10 @@ RenderManager::RenderManager(FileCache &cache)
     vkGetDeviceQueue(m_device->device, graphicsFamilyIndex, 0, &m_device->graphicsQueue);
     vkGetDeviceQueue(m_device->device, presentFamilyIndex, 0, &m_device->presentQueue);
 
+    m_device->allocator = std::make_unique<MemoryAllocator>(m_device->physicalDevice, m_device->device);
+
+    createPipelineCache();
+
     // command pool
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -277,6 +291,9 @@ RenderManager::RenderManager(FileCache &cache)
 
     vkCreateCommandPool(m_device->device, &poolInfo, nullptr, &m_device->commandPool);
 
+    m_device->uploadQueue = std::make_unique<UploadQueue>(*m_device, graphicsFamilyIndex);
+    m_device->geometry = std::make_unique<GeometryManager>(*m_device);
+
     VkDescriptorPoolSize poolSize = {};
     poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     poolSize.descriptorCount = 2000;
@@ -297,7 +314,15 @@ RenderManager::RenderManager(FileCache &cache)
     poolSize5.type = VK_DESCRIPTOR_TYPE_SAMPLER;
     poolSize5.descriptorCount = 2000;
 
-    const std::array poolSizes = {poolSize, poolSize2, poolSize3, poolSize4, poolSize5};
+    VkDescriptorPoolSize poolSize6 = {};
+    poolSize6.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSize6.descriptorCount = 2000;
+
+    VkDescriptorPoolSize poolSize7 = {};
+    poolSize7.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize7.descriptorCount = 2000;
+
+    const std::array poolSizes = {poolSize, poolSize2, poolSize3, poolSize4, poolSize5, poolSize6, poolSize7};
 
     VkDescriptorPoolCreateInfo poolCreateInfo = {};
     poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -328,6 +353,12 @@ RenderManager::~RenderManager()
 
     vkDestroyDescriptorPool(m_device->device, m_device->descriptorPool, nullptr);
     vkDestroyCommandPool(m_device->device, m_device->commandPool, nullptr);
+    m_device->geometry.reset();
+    m_device->uploadQueue.reset();
+    savePipelineCache();
+    vkDestroyPipelineCache(m_device->device, m_device->pipelineCache, nullptr);
+    m_device->allocator->logStatistics();
+    m_device->allocator.reset();
     vkDestroyDevice(m_device->device, nullptr);
     DestroyDebugUtilsMessengerEXT(m_device->instance, m_device->callback, nullptr);
     vkDestroyInstance(m_device->instance, nullptr);
@@ -586,6 +617,9 @@ void RenderManager::render(std::vector<DrawObjectInstance> &models, const std::v
 
     vkResetFences(m_device->device, 1, &m_device->swapChain->inFlightFences[m_device->swapChain->currentFrame]);
 
+    // Anything loaded since the last frame has to be submitted before it's used
+    m_device->uploadQueue->flush();
+
     if (vkQueueSubmit(m_device->graphicsQueue, 1, &submitInfo, m_device->swapChain->inFlightFences[m_device->swapChain->currentFrame]) != VK_SUCCESS)
         return;
 
@@ -602,7 +636,7 @@ void RenderManager::render(std::vector<DrawObjectInstance> &models, const std::v
 
     vkQueuePresentKHR(m_device->presentQueue, &presentInfo);
 
-    m_device->swapChain->currentFrame = (m_device->swapChain->currentFrame + 1) % 3;
+    m_device->swapChain->currentFrame = (m_device->swapChain->currentFrame + 1) % SwapChain::framesInFlight;
 }
 
 VkRenderPass RenderManager::presentationRenderPass() const
@@ -623,6 +657,16 @@ DrawObject *RenderManager::addDrawObject(const physis_MDL &model, const std::str
 
 void RenderManager::reloadDrawObject(DrawObject &DrawObject) const
 {
+    if (m_renderer != nullptr) {
+        m_renderer->releaseDrawObject(DrawObject);
+    }
+
+    // Frames in flight may still be drawing the old geometry
+    if (!DrawObject.lods.empty()) {
+        m_device->waitForIdle();
+        freeGeometry(DrawObject);
+    }
+
     DrawObject.lods.clear();
 
     for (uint32_t lod = 0; lod < DrawObject.model.num_lod; lod++) {
@@ -638,32 +682,24 @@ void RenderManager::reloadDrawObject(DrawObject &DrawObject) const
             renderPart.materialIndex = part.material_index;
 
             if (qgetenv("NOVUS_USE_NEW_RENDERER") == QByteArrayLiteral("1")) {
-                renderPart.streamBuffer.resize(DrawObject.model.lods[lod].num_vertex_elements);
+                renderPart.streams.resize(DrawObject.model.lods[lod].num_vertex_elements);
                 for (uint32_t j = 0; j < part.num_streams; j++) {
-                    const size_t size = part.stream_sizes[j];
-                    auto buffer = m_device->createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-                    m_device->copyToBuffer(buffer, part.streams[j], size);
-                    m_device->nameBuffer(buffer, "Stream Buffer for MDL");
-
-                    renderPart.streamBuffer[j] = buffer;
+                    // Streams are bound with their own offset, so they only need to be aligned for the vertex attributes
+                    renderPart.streams[j] = m_device->geometry->upload(GeometryManager::Kind::Vertex, part.streams[j], part.stream_sizes[j], 16);
                 }
             } else {
                 if (part.num_vertices > 0) {
-                    const size_t vertexSize = part.num_vertices * sizeof(Vertex);
-                    renderPart.vertexBuffer = m_device->createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-                    m_device->copyToBuffer(renderPart.vertexBuffer, part.vertices, vertexSize);
-                    m_device->nameBuffer(renderPart.vertexBuffer, "Vertex Buffer for MDL " + std::to_string(lod));
+                    // Aligned to whole vertices, so they can be drawn with a base vertex
+                    renderPart.vertices =
+                        m_device->geometry->upload(GeometryManager::Kind::Vertex, part.vertices, part.num_vertices * sizeof(Vertex), sizeof(Vertex));
                 } else {
                     qWarning() << DrawObject.name << "Lod" << lod << "Part" << i << "has zero vertices, is that supposed to happen?";
                 }
             }
 
             if (part.num_indices > 0) {
-                const size_t indexSize = part.num_indices * sizeof(uint16_t);
-                renderPart.indexBuffer = m_device->createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-                m_device->copyToBuffer(renderPart.indexBuffer, part.indices, indexSize);
-                m_device->nameBuffer(renderPart.indexBuffer, "Index Buffer for MDL");
-
+                renderPart.indices =
+                    m_device->geometry->upload(GeometryManager::Kind::Index, part.indices, part.num_indices * sizeof(uint16_t), sizeof(uint16_t));
                 renderPart.numIndices = part.num_indices;
             } else {
                 qWarning() << DrawObject.name << "Lod" << lod << "Part" << i << "has zero indices, is that supposed to happen?";
@@ -674,24 +710,38 @@ void RenderManager::reloadDrawObject(DrawObject &DrawObject) const
         DrawObject.lods.push_back(newLod);
     }
 
-    constexpr size_t bufferSize = sizeof(glm::mat3x4) * JOINT_MATRIX_SIZE_DAWNTRAIL;
-    DrawObject.boneInfoBuffer = m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    m_device->nameBuffer(DrawObject.boneInfoBuffer, "Bone Info Buffer for MDL");
+    // The bone buffer is the same size for every model, so a reload keeps the existing one
+    if (DrawObject.boneInfoBuffer.buffer == VK_NULL_HANDLE) {
+        DrawObject.boneInfoBuffer = m_device->createBuffer(DrawObject::boneInfoSize * SwapChain::framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        m_device->nameBuffer(DrawObject.boneInfoBuffer, "Bone Info Buffer for MDL");
+    }
+
+    // Either way, none of its copies hold the current bones yet
+    DrawObject.uploadedBoneDataVersions.fill(0);
 }
 
 void RenderManager::destroyDrawObject(DrawObject &model) const
+{
+    if (m_renderer != nullptr) {
+        m_renderer->releaseDrawObject(model);
+    }
+
+    freeGeometry(model);
+
+    m_device->destroyBuffer(model.boneInfoBuffer);
+}
+
+void RenderManager::freeGeometry(DrawObject &model) const
 {
     for (auto &lod : model.lods) {
         for (auto &part : lod.parts) {
-            m_device->destroyBuffer(part.vertexBuffer);
-            m_device->destroyBuffer(part.indexBuffer);
-            for (auto &stream : part.streamBuffer) {
-                m_device->destroyBuffer(stream);
+            m_device->geometry->free(GeometryManager::Kind::Vertex, part.vertices);
+            m_device->geometry->free(GeometryManager::Kind::Index, part.indices);
+            for (auto &stream : part.streams) {
+                m_device->geometry->free(GeometryManager::Kind::Vertex, stream);
             }
         }
     }
-
-    m_device->destroyBuffer(model.boneInfoBuffer);
 }
 
 VfxObject *RenderManager::addVFXObject(const physis_Avfx &vfx, const std::vector<physis_Texture> &textures, const std::string &name) const
@@ -714,7 +764,7 @@ void RenderManager::reloadVFXObject(VfxObject &vfx) const
 
         if (model.vertex_count > 0) {
             const size_t vertexSize = model.vertex_count * sizeof(DrawVertex);
-            drawModel.vertexBuffer = m_device->createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+            drawModel.vertexBuffer = m_device->createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
             m_device->copyToBuffer(drawModel.vertexBuffer, model.vertices, vertexSize);
             m_device->nameBuffer(drawModel.vertexBuffer, "Vertex Buffer for VFX");
         } else {
@@ -723,7 +773,7 @@ void RenderManager::reloadVFXObject(VfxObject &vfx) const
 
         if (model.index_count > 0) {
             const size_t indexSize = model.index_count * sizeof(uint16_t);
-            drawModel.indexBuffer = m_device->createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            drawModel.indexBuffer = m_device->createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryUsage::GpuOnly);
             m_device->copyToBuffer(drawModel.indexBuffer, model.indices, indexSize);
             m_device->nameBuffer(drawModel.indexBuffer, "Index Buffer for VFX");
 
@@ -869,7 +919,7 @@ void RenderManager::initBlitPipeline()
     createInfo.layout = m_pipelineLayout;
     createInfo.renderPass = m_renderPass;
 
-    vkCreateGraphicsPipelines(m_device->device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_device->device, m_device->pipelineCache, 1, &createInfo, nullptr, &m_pipeline);
 
     VkSamplerCreateInfo samplerInfo = {};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -1073,6 +1123,7 @@ QImage RenderManager::grab(std::vector<DrawObjectInstance> &models, std::vector<
     VkFence fence = VK_NULL_HANDLE;
     vkCreateFence(m_device->device, &fenceInfo, nullptr, &fence);
     // Submit to the queue
+    m_device->uploadQueue->flush();
     vkQueueSubmit(m_device->graphicsQueue, 1, &submitInfo, fence);
     // Wait for the fence to signal that command buffer has finished executing
     vkWaitForFences(m_device->device, 1, &fence, VK_TRUE, UINT64_MAX);
@@ -1104,3 +1155,75 @@ QImage RenderManager::grab(std::vector<DrawObjectInstance> &models, std::vector<
 
     return image;
 }
+
+static QString pipelineCachePath()
+{
+    const QDir cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return cacheDir.absoluteFilePath(QStringLiteral("pipelines.bin"));
+}
+
+void RenderManager::createPipelineCache() const
+{
+    QByteArray initialData;
+
+    QFile file(pipelineCachePath());
+    if (file.open(QIODevice::ReadOnly)) {
+        initialData = file.readAll();
+    }
+
+    // Drivers are supposed to reject data from another device themselves, but not all of them are careful about it
+    if (!initialData.isEmpty()) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_device->physicalDevice, &properties);
+
+        VkPipelineCacheHeaderVersionOne header{};
+        if (static_cast<size_t>(initialData.size()) < sizeof(header)) {
+            initialData.clear();
+        } else {
+            memcpy(&header, initialData.constData(), sizeof(header));
+            if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header.vendorID != properties.vendorID
+                || header.deviceID != properties.deviceID || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+                qInfo() << "Discarding pipeline cache from a different device or driver";
+                initialData.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initialData.size();
+    createInfo.pInitialData = initialData.constData();
+
+    if (vkCreatePipelineCache(m_device->device, &createInfo, nullptr, &m_device->pipelineCache) != VK_SUCCESS) {
+        // Try again without the old data, in case the driver didn't like it
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        vkCreatePipelineCache(m_device->device, &createInfo, nullptr, &m_device->pipelineCache);
+    }
+}
+
+void RenderManager::savePipelineCache() const
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_device->device, m_device->pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    QByteArray data(static_cast<qsizetype>(size), Qt::Uninitialized);
+    if (vkGetPipelineCacheData(m_device->device, m_device->pipelineCache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+    data.resize(static_cast<qsizetype>(size));
+
+    const QString path = pipelineCachePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write pipeline cache to" << path;
+        return;
+    }
+
+    file.write(data);
+    file.commit();
+}
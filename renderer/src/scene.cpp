@@ -3,10 +3,19 @@
 
 #include "scene.h"
 
+#include "camera.h"
+#include "drawobject.h"
 #include "physis.hpp"
 
+#include <algorithm>
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
+static bool sameBounds(const BoundingBox &a, const BoundingBox &b)
+{
+    return std::ranges::equal(a.min, b.min) && std::ranges::equal(a.max, b.max);
+}
+
 Scene::Scene()
 {
     resetLights();
@@ -16,3 +25,60 @@ void Scene::resetLights()
 {
     lights.clear();
 }
+
+void Scene::invalidateObjects()
+{
+    m_objectsChanged = true;
+}
+
+void Scene::updateObjectHierarchy(std::vector<DrawObjectInstance> &models)
+{
+    // The size check catches callers that forgot to invalidate
+    if (m_objectsChanged || objectHierarchy.itemCount() != models.size()) {
+        std::vector<BoundingBox> bounds;
+        bounds.reserve(models.size());
+
+        for (auto &model : models) {
+            model.lastBoundingBox = model.worldBounds();
+            bounds.push_back(model.lastBoundingBox);
+        }
+
+        objectHierarchy.build(std::move(bounds));
+        m_objectsChanged = false;
+        return;
+    }
+
+    // worldBounds() is cached, so this only does real work for the instances that were moved or reloaded
+    bool moved = false;
+    for (uint32_t i = 0; i < models.size(); i++) {
+        const auto &bounds = models[i].worldBounds();
+        if (!sameBounds(bounds, models[i].lastBoundingBox)) {
+            models[i].lastBoundingBox = bounds;
+            objectHierarchy.update(i, bounds);
+            moved = true;
+        }
+    }
+
+    if (moved) {
+        objectHierarchy.refit();
+    }
+}
+
+std::optional<uint32_t> Scene::pickObject(const Camera &camera, const glm::vec2 &position) const
+{
+    const glm::mat4 inverseViewProjection = glm::inverse(camera.perspective * camera.view);
+    const auto unproject = [&inverseViewProjection, &position](const float depth) {
+        const glm::vec4 point = inverseViewProjection * glm::vec4(position, depth, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+
+    // The far plane is at infinity, so take any point in between to get the direction
+    const glm::vec3 origin = unproject(0.0f);
+    const glm::vec3 direction = unproject(0.5f) - origin;
+
+    if (const auto hit = objectHierarchy.raycast(origin, direction)) {
+        return hit->item;
+    }
+
+    return std::nullopt;
+}
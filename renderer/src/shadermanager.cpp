@@ -3,6 +3,14 @@
 
 #include "shadermanager.h"
 
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+#include <mutex>
 #include <dxbc_module.h>
 #include <dxbc_reader.h>
 #include <physis.hpp>
@@ -17,37 +25,63 @@
 
 #include "device.h"
 
+// Bump this whenever the conversion changes in a way that should invalidate the old results
+static constexpr int shaderCacheVersion = 1;
+
+// The first word of every SPIR-V module
+static constexpr uint32_t spirvMagic = 0x07230203;
+
 ShaderManager::ShaderManager(Device &device)
     : m_device(device)
 {
+    const QDir cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_cacheDirectory = cacheDir.absoluteFilePath(QStringLiteral("shaders"));
+    QDir().mkpath(m_cacheDirectory);
 }
 
-spirv_cross::CompilerGLSL ShaderManager::getShaderModuleTest(const physis_Shader &shader)
+spirv_cross::CompilerGLSL ShaderManager::getShaderModuleTest(const physis_Shader &shader) const
 {
-    dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
-
-    const dxvk::DxbcModule module(reader);
-
-    const dxvk::DxbcModuleInfo info;
-    auto result = module.compile(info, "test");
+    const auto code = translateShader(shader);
 
-    return {result.code.data(), result.code.dwords()};
+    return {code.data(), code.size()};
 }
 
 std::string ShaderManager::getShaderModuleResources(const physis_Shader &shader, const int i)
 {
     dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
 
+    // The signatures are read when the module is parsed, there's no need to compile it
     const dxvk::DxbcModule module(reader);
 
-    const dxvk::DxbcModuleInfo info;
-    auto result = module.compile(info, "test");
-
     return module.isgn()->findByRegister(i)->semanticName;
 }
 
 VkShaderModule ShaderManager::convertShaderModule(const physis_Shader &shader, spv::ExecutionModel executionModel) const
 {
+    const auto code = convertShader(shader, executionModel);
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    vkCreateShaderModule(m_device.device, &createInfo, nullptr, &shaderModule);
+
+    return shaderModule;
+}
+
+std::vector<uint32_t> ShaderManager::translateShader(const physis_Shader &shader) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(shader.bytecode), shader.len));
+    hash.addData(QByteArrayLiteral("dxvk"));
+
+    const QString key = QStringLiteral("%1-%2").arg(shaderCacheVersion).arg(QString::fromLatin1(hash.result().toHex()));
+    if (auto cached = loadCachedShader(key)) {
+        return *cached;
+    }
+
     dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
 
     dxvk::DxbcModule module(reader);
@@ -55,12 +89,39 @@ VkShaderModule ShaderManager::convertShaderModule(const physis_Shader &shader, s
     dxvk::DxbcModuleInfo info;
     auto result = module.compile(info, "test");
 
-    VkShaderModuleCreateInfo createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    std::vector<uint32_t> code(result.code.data(), result.code.data() + result.code.dwords());
+    saveCachedShader(key, code);
+
+    return code;
+}
 
+std::vector<uint32_t> ShaderManager::convertShader(const physis_Shader &shader, spv::ExecutionModel executionModel) const
+{
 #ifdef HAVE_GLSLANG
+    // The GLSL path renames resources after the shader parameters, so those are part of the key too
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(shader.bytecode), shader.len));
+    hash.addData(QByteArrayLiteral("glslang"));
+    hash.addData(QByteArray::number(static_cast<int>(executionModel)));
+    for (uint32_t i = 0; i < shader.num_resource_parameters; i++) {
+        hash.addData(QByteArrayView(shader.resource_parameters[i].name));
+    }
+    for (uint32_t i = 0; i < shader.num_scalar_parameters; i++) {
+        hash.addData(QByteArrayView(shader.scalar_parameters[i].name));
+    }
+
+    const QString key = QStringLiteral("%1-%2").arg(shaderCacheVersion).arg(QString::fromLatin1(hash.result().toHex()));
+    if (auto cached = loadCachedShader(key)) {
+        return *cached;
+    }
+
+    const auto translated = translateShader(shader);
+
+    dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
+    const dxvk::DxbcModule module(reader);
+
     // TODO: for debug only
-    spirv_cross::CompilerGLSL glsl(result.code.data(), result.code.dwords());
+    spirv_cross::CompilerGLSL glsl(translated.data(), translated.size());
 
     auto resources = glsl.get_shader_resources();
 
@@ -94,29 +155,65 @@ VkShaderModule ShaderManager::convertShaderModule(const physis_Shader &shader, s
     glsl.set_common_options(options);
     glsl.set_entry_point("main", executionModel);
 
-    auto newModule = compileGLSL(glsl.compile(), executionModel == spv::ExecutionModelVertex ? ShaderStage::Vertex : ShaderStage::Pixel);
-    createInfo.codeSize = newModule.size() * sizeof(uint32_t);
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(newModule.data());
+    auto code = compileGLSL(glsl.compile(), executionModel == spv::ExecutionModelVertex ? ShaderStage::Vertex : ShaderStage::Pixel);
+
+    // Don't cache failures, so they show up again on the next run
+    if (!code.empty()) {
+        saveCachedShader(key, code);
+    }
+
+    return code;
 #else
-    createInfo.codeSize = result.code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(result.code.data());
+    Q_UNUSED(executionModel)
+
+    return translateShader(shader);
 #endif
+}
 
-    VkShaderModule shaderModule;
-    vkCreateShaderModule(m_device.device, &createInfo, nullptr, &shaderModule);
+std::optional<std::vector<uint32_t>> ShaderManager::loadCachedShader(const QString &key) const
+{
+    QFile file(QDir(m_cacheDirectory).absoluteFilePath(key + QStringLiteral(".spv")));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
 
-    return shaderModule;
+    const QByteArray data = file.readAll();
+    if (data.size() < static_cast<qsizetype>(sizeof(uint32_t)) || data.size() % sizeof(uint32_t) != 0) {
+        return std::nullopt;
+    }
+
+    std::vector<uint32_t> code(data.size() / sizeof(uint32_t));
+    memcpy(code.data(), data.constData(), data.size());
+
+    // Catches files that were truncated or overwritten by something else
+    if (code[0] != spirvMagic) {
+        return std::nullopt;
+    }
+
+    return code;
+}
+
+void ShaderManager::saveCachedShader(const QString &key, const std::vector<uint32_t> &code) const
+{
+    // Written through QSaveFile, so a crash never leaves half a shader behind
+    QSaveFile file(QDir(m_cacheDirectory).absoluteFilePath(key + QStringLiteral(".spv")));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write shader cache entry" << key;
+        return;
+    }
+
+    file.write(reinterpret_cast<const char *>(code.data()), static_cast<qsizetype>(code.size() * sizeof(uint32_t)));
+    file.commit();
 }
 
 std::vector<uint32_t> ShaderManager::compileGLSL(const std::string_view sourceString, const ShaderStage stage)
 {
 #ifdef HAVE_GLSLANG
-    static bool ProcessInitialized = false;
-
-    if (!ProcessInitialized) {
+    // Pipelines are created on worker threads, so more than one of them can get here first
+    static std::once_flag processInitialized;
+    std::call_once(processInitialized, [] {
         glslang::InitializeProcess();
-        ProcessInitialized = true;
-    }
+    });
 
     const char *InputCString = sourceString.data();
 
@@ -13,17 +13,24 @@
 #include "shaderstructs.h"
 #include "swapchain.h"
 
+#include <algorithm>
 #include <glm/gtc/type_ptr.hpp>
+#include <limits>
+#include <numeric>
 
 constexpr size_t MAX_LIGHTS = 1024;
 
+// Enough for a few thousand parts or instances
+constexpr size_t initialFrameBufferSize = 256 * 1024;
+
 struct ShaderLight {
     glm::vec4 directionOrPos;
     glm::vec4 colorIntensity;
 };
 
 SimpleRenderer::SimpleRenderer(Device &device)
-    : m_device(device)
+    : m_lightsRing(device, MAX_LIGHTS * sizeof(ShaderLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    , m_device(device)
 {
     m_dummyTex = m_device.createDummyTexture();
     m_device.nameTexture(m_dummyTex, "Dummy Texture");
@@ -39,8 +46,6 @@ SimpleRenderer::SimpleRenderer(Device &device)
     samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     vkCreateSampler(m_device.device, &samplerInfo, nullptr, &m_sampler);
-
-    m_lightsBuffer = m_device.createBuffer(MAX_LIGHTS * sizeof(ShaderLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 }
 
 SimpleRenderer::~SimpleRenderer()
@@ -58,6 +63,13 @@ SimpleRenderer::~SimpleRenderer()
 
     vkDestroySampler(m_device.device, m_sampler, nullptr);
     m_device.destroyTexture(m_dummyTex);
+
+    for (auto &buffer : m_indirectBuffers) {
+        m_device.destroyBuffer(buffer);
+    }
+    for (auto &buffer : m_instanceBuffers) {
+        m_device.destroyBuffer(buffer);
+    }
 }
 
 void SimpleRenderer::resize()
@@ -109,8 +121,15 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    // update lights
-    std::array<ShaderLight, MAX_LIGHTS> lights{};
+    // Anything written while recording goes into this frame's copy, as the previous frames may still be running
+    const uint32_t frame = m_device.swapChain->currentFrame;
+
+    // update lights, straight into this frame's part of the ring
+    m_lightsRing.beginFrame(frame);
+    const auto lightsAllocation = m_lightsRing.allocate(MAX_LIGHTS * sizeof(ShaderLight));
+    auto lights = static_cast<ShaderLight *>(lightsAllocation->data);
+    std::fill_n(lights, MAX_LIGHTS, ShaderLight{});
+
     size_t lightCount = scene.lights.size();
     if (lightCount > MAX_LIGHTS) {
         qWarning() << "Too many lights, please raise the limit to include" << lightCount;
@@ -122,14 +141,32 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene
             lights[i].colorIntensity = glm::vec4(scene.lights[i].color, scene.lights[i].intensity);
         }
     }
-    m_device.copyToBuffer(m_lightsBuffer, lights.data(), m_lightsBuffer.size);
 
     const auto frustum = camera.frustum();
 
     scene.culledObjects = 0;
 
-    for (auto &model : models) {
-        const auto distance = glm::distance(glm::make_vec3(model.transformation.translation), camera.position);
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+    m_batches.clear();
+    m_batchIndices.clear();
+
+    scene.updateObjectHierarchy(models);
+
+    // Only the models in view are visited at all, instead of testing each one
+    m_visibleObjects.clear();
+    if (scene.frustumCulling) {
+        scene.objectHierarchy.queryFrustum(frustum, m_visibleObjects);
+        scene.culledObjects = models.size() - m_visibleObjects.size();
+    } else {
+        m_visibleObjects.resize(models.size());
+        std::iota(m_visibleObjects.begin(), m_visibleObjects.end(), 0);
+    }
+
+    for (const auto index : m_visibleObjects) {
+        const auto &model = models[index];
+        const auto distance = glm::distance(glm::make_vec3(model.transformation().translation), camera.position);
 
         // Not sure if this is the intended use case of this property, but we can use it for some shitty culling
         // Note that the 0.0 check is because terrain models usually have 0 here.
@@ -143,128 +180,179 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, Camera &camera, Scene
             continue;
         }
 
-        // Shitty unoptimized frustum check
-        glm::vec4 boundMin = glm::make_vec4(model.sourceObject->model.bounding_box.min);
-        glm::vec4 boundMax = glm::make_vec4(model.sourceObject->model.bounding_box.max);
+        // Cached, static scenery never has to rebuild it
+        const glm::mat4 &m = model.modelMatrix();
+        const size_t lod = model.sourceObject->chooseLod(distance);
 
-        auto m = glm::mat4(1.0f);
-        m = glm::translate(m, glm::vec3(model.transformation.translation[0], model.transformation.translation[1], model.transformation.translation[2]));
-        m *= glm::mat4_cast(glm::quat(glm::vec3(model.transformation.rotation[0], model.transformation.rotation[1], model.transformation.rotation[2])));
-        m = glm::scale(m, glm::vec3(model.transformation.scale[0], model.transformation.scale[1], model.transformation.scale[2]));
+        // Instances of the same model (and LOD) are drawn together, see below
+        const auto key = std::make_pair(model.sourceObject, lod);
+        auto [it, inserted] = m_batchIndices.try_emplace(key, m_batches.size());
+        if (inserted) {
+            m_batches.push_back(InstanceBatch{.object = model.sourceObject, .lod = lod});
+        }
+        m_batches[it->second].transforms.push_back(m);
+    }
 
-        glm::vec4 newBoundMin;
-        glm::vec4 newBoundMax;
+    // Parts of a batch that share a material and geometry pages become one group, with one indirect command per part.
+    // Each command draws every instance of the batch, which read their transforms from the instance buffer.
+    m_drawGroups.clear();
+    m_indirectCommands.clear();
+    m_instanceTransforms.clear();
 
-        newBoundMin = boundMin + glm::vec4(glm::make_vec3(model.transformation.translation), 0.0f);
-        newBoundMax = glm::vec4(glm::make_vec3(model.transformation.translation), 0.0f) + boundMax;
+    for (size_t batchIndex = 0; batchIndex < m_batches.size(); batchIndex++) {
+        auto &batch = m_batches[batchIndex];
+        const size_t firstGroup = m_drawGroups.size();
 
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
-                auto a = m[i][j] * boundMin[j];
-                auto b = m[i][j] * boundMax[j];
-                newBoundMin[i] += a < b ? a : b;
-                newBoundMax[i] += a < b ? b : a;
+        batch.firstInstance = static_cast<uint32_t>(m_instanceTransforms.size());
+        m_instanceTransforms.insert(m_instanceTransforms.end(), batch.transforms.begin(), batch.transforms.end());
+
+        for (const auto &part : batch.object->lods[batch.lod].parts) {
+            // not sure why this happens
+            if (part.numIndices == 0 || !part.vertices.isValid()) {
+                continue;
             }
-        }
 
-        auto bounding_box = BoundingBox{
-            .min = {newBoundMin[0], newBoundMin[1], newBoundMin[2]},
-            .max = {newBoundMax[0], newBoundMax[1], newBoundMax[2]},
-        };
-        model.lastBoundingBox = bounding_box;
-        if (scene.frustumCulling && !test_aabb_frustum(frustum, bounding_box)) {
-            scene.culledObjects++;
-            continue;
-        }
+            const RenderMaterial *material = nullptr;
+            if (static_cast<size_t>(part.materialIndex) < batch.object->materials.size()) {
+                material = &batch.object->materials[part.materialIndex];
+            }
 
-        if (model.sourceObject->skinned) {
-            if (scene.wireframe) {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipelineWireframe);
-            } else {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipeline);
+            const auto h = std::hash<std::string>{}(material ? material->path : std::string{});
+            if (!m_cachedDescriptors.contains(h)) {
+                if (const auto descriptor = createDescriptorFor(*batch.object, material ? *material : RenderMaterial{}); descriptor != VK_NULL_HANDLE) {
+                    m_cachedDescriptors[h] = descriptor;
+                } else {
+                    qWarning() << "Failed to create descriptor?!";
+                    continue;
+                }
             }
-        } else {
-            if (scene.wireframe) {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineWireframe);
-            } else {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+            const DrawGroup newGroup{
+                .batch = batchIndex,
+                .descriptor = m_cachedDescriptors[h],
+                .vertexBuffer = m_device.geometry->buffer(GeometryManager::Kind::Vertex, part.vertices),
+                .indexBuffer = m_device.geometry->buffer(GeometryManager::Kind::Index, part.indices),
+                .materialType = static_cast<int>(material ? material->type : MaterialType::Object),
+            };
+
+            // Parts are appended in order, so only the last group of this batch can be extended
+            if (m_drawGroups.size() == firstGroup || !m_drawGroups.back().canMerge(newGroup)) {
+                auto &group = m_drawGroups.emplace_back(newGroup);
+                group.firstCommand = static_cast<uint32_t>(m_indirectCommands.size());
             }
+            m_drawGroups.back().commandCount++;
+
+            m_indirectCommands.push_back(VkDrawIndexedIndirectCommand{
+                .indexCount = static_cast<uint32_t>(part.numIndices),
+                .instanceCount = static_cast<uint32_t>(batch.transforms.size()),
+                .firstIndex = part.firstIndex(),
+                .vertexOffset = part.vertexOffset(),
+                .firstInstance = 0,
+            });
         }
+    }
 
-        // copy bone data
-        {
-            constexpr size_t bufferSize = sizeof(glm::mat3x4) * JOINT_MATRIX_SIZE_DAWNTRAIL;
-            void *mapped_data = nullptr;
-            vkMapMemory(m_device.device, model.sourceObject->boneInfoBuffer.memory, 0, bufferSize, 0, &mapped_data);
+    const Buffer &indirectBuffer = prepareFrameBuffer(m_indirectBuffers,
+                                                      m_indirectCommands.data(),
+                                                      m_indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+                                                      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                      "Simple Renderer Indirect Commands");
+    const Buffer &instanceBuffer = prepareFrameBuffer(m_instanceBuffers,
+                                                      m_instanceTransforms.data(),
+                                                      m_instanceTransforms.size() * sizeof(glm::mat4),
+                                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                      "Simple Renderer Instance Transforms");
 
-            memcpy(mapped_data, model.sourceObject->boneData.data(), bufferSize);
+    const glm::mat4 vp = camera.perspective * camera.view;
+    const auto viewPos = glm::vec4(-camera.position, 0.0f);
 
-            VkMappedMemoryRange range = {};
-            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            range.memory = model.sourceObject->boneInfoBuffer.memory;
-            range.size = bufferSize;
-            vkFlushMappedMemoryRanges(m_device.device, 1, &range);
+    // In binding order, so the bones and then the lights
+    const std::array dynamicOffsets = {static_cast<uint32_t>(DrawObject::boneInfoOffset(frame)), lightsAllocation->offset};
 
-            vkUnmapMemory(m_device.device, model.sourceObject->boneInfoBuffer.memory);
-        }
+    // These are the same for every group, and push constants stay around between pipelines with the same layout
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &vp);
 
-        const auto &lod = model.sourceObject->chooseLod(distance);
-        for (const auto &part : model.sourceObject->lods[lod].parts) {
-            // not sure why this happens
-            if (part.numIndices == 0 || part.vertexBuffer.buffer == VK_NULL_HANDLE) {
-                continue;
+    vkCmdPushConstants(commandBuffer,
+                       m_pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       sizeof(glm::mat4) * 2,
+                       sizeof(glm::vec4),
+                       &viewPos);
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    size_t currentBatch = std::numeric_limits<size_t>::max();
+
+    for (const auto &group : m_drawGroups) {
+        const auto &batch = m_batches[group.batch];
+
+        // Everything that's shared between instances (pipeline, bones, descriptors, geometry and most push constants) is only set once
+        if (group.batch != currentBatch) {
+            VkPipeline pipeline;
+            if (batch.object->skinned) {
+                pipeline = scene.wireframe ? m_skinnedPipelineWireframe : m_skinnedPipeline;
+            } else {
+                pipeline = scene.wireframe ? m_pipelineWireframe : m_pipeline;
             }
 
-            RenderMaterial material = {};
-            if (static_cast<size_t>(part.materialIndex) < model.sourceObject->materials.size()) {
-                material = model.sourceObject->materials[part.materialIndex];
+            if (pipeline != boundPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                boundPipeline = pipeline;
             }
 
-            const auto h = std::hash<std::string>{}(material.path);
-            if (!m_cachedDescriptors.contains(h)) {
-                if (const auto descriptor = createDescriptorFor(*model.sourceObject, material); descriptor != VK_NULL_HANDLE) {
-                    m_cachedDescriptors[h] = descriptor;
-                } else {
-                    qWarning() << "Failed to create descriptor?!";
-                    continue;
-                }
+            // The instances of this batch start at the beginning of the stream, so the commands don't need a firstInstance
+            const VkDeviceSize instanceOffset = batch.firstInstance * sizeof(glm::mat4);
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer.buffer, &instanceOffset);
+
+            // copy bone data, but only if this frame's copy is out of date
+            if (auto &uploadedVersion = batch.object->uploadedBoneDataVersions[frame]; uploadedVersion != batch.object->boneDataVersion) {
+                // Bone buffers are persistently mapped and coherent, so no flush is needed
+                memcpy(batch.object->mappedBoneInfo(frame), batch.object->boneData.data(), DrawObject::boneInfoSize);
+                uploadedVersion = batch.object->boneDataVersion;
             }
 
-            const auto descriptor = m_cachedDescriptors[h];
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descriptor, 0, nullptr);
-
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &part.vertexBuffer.buffer, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, part.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-            glm::mat4 vp = camera.perspective * camera.view;
-
-            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &vp);
-
-            vkCmdPushConstants(commandBuffer,
-                               m_pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                               sizeof(glm::mat4),
-                               sizeof(glm::mat4),
-                               &m);
-
-            auto viewPos = glm::vec4(-camera.position, 0.0f);
-            vkCmdPushConstants(commandBuffer,
-                               m_pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                               sizeof(glm::mat4) * 2,
-                               sizeof(glm::vec4),
-                               &viewPos);
-
-            const int type = static_cast<int>(material.type);
-            vkCmdPushConstants(commandBuffer,
-                               m_pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                               sizeof(glm::mat4) * 2 + sizeof(glm::vec4),
-                               sizeof(int),
-                               &type);
-
-            vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, 0, 0, 0);
+            currentBatch = group.batch;
+        }
+
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                m_pipelineLayout,
+                                0,
+                                1,
+                                &group.descriptor,
+                                dynamicOffsets.size(),
+                                dynamicOffsets.data());
+
+        // Most parts share the same pages, so this rarely has to rebind anything
+        if (group.vertexBuffer != boundVertexBuffer) {
+            constexpr VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &group.vertexBuffer, offsets);
+            boundVertexBuffer = group.vertexBuffer;
+        }
+
+        if (group.indexBuffer != boundIndexBuffer) {
+            vkCmdBindIndexBuffer(commandBuffer, group.indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            boundIndexBuffer = group.indexBuffer;
+        }
+
+        vkCmdPushConstants(commandBuffer,
+                           m_pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           sizeof(glm::mat4) * 2 + sizeof(glm::vec4),
+                           sizeof(int),
+                           &group.materialType);
+
+        const VkDeviceSize commandOffset = group.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+
+        if (m_device.multiDrawIndirect) {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.buffer, commandOffset, group.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            for (uint32_t j = 0; j < group.commandCount; j++) {
+                vkCmdDrawIndexedIndirect(commandBuffer,
+                                         indirectBuffer.buffer,
+                                         commandOffset + j * sizeof(VkDrawIndexedIndirectCommand),
+                                         1,
+                                         sizeof(VkDrawIndexedIndirectCommand));
+            }
         }
     }
 
@@ -391,6 +479,14 @@ void SimpleRenderer::initPipeline()
     VkVertexInputBindingDescription binding = {};
     binding.stride = sizeof(Vertex);
 
+    // The model matrix of each instance
+    VkVertexInputBindingDescription instanceBinding = {};
+    instanceBinding.binding = 1;
+    instanceBinding.stride = sizeof(glm::mat4);
+    instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    const std::array bindings = {binding, instanceBinding};
+
     VkVertexInputAttributeDescription positionAttribute = {};
     positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
     positionAttribute.offset = offsetof(Vertex, position);
@@ -430,13 +526,24 @@ void SimpleRenderer::initPipeline()
     boneIdAttribute.location = 7;
     boneIdAttribute.offset = offsetof(Vertex, bone_id);
 
-    const std::array attributes =
+    std::vector<VkVertexInputAttributeDescription> attributes =
         {positionAttribute, uv0Attribute, uv1Attribute, normalAttribute, bitangentAttribute, colorAttribute, boneWeightAttribute, boneIdAttribute};
 
+    // A mat4 attribute takes up four locations, one for each column
+    for (uint32_t i = 0; i < 4; i++) {
+        VkVertexInputAttributeDescription modelAttribute = {};
+        modelAttribute.binding = 1;
+        modelAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        modelAttribute.location = 8 + i;
+        modelAttribute.offset = i * sizeof(glm::vec4);
+
+        attributes.push_back(modelAttribute);
+    }
+
     VkPipelineVertexInputStateCreateInfo vertexInputState = {};
     vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputState.vertexBindingDescriptionCount = 1;
-    vertexInputState.pVertexBindingDescriptions = &binding;
+    vertexInputState.vertexBindingDescriptionCount = bindings.size();
+    vertexInputState.pVertexBindingDescriptions = bindings.data();
     vertexInputState.vertexAttributeDescriptionCount = attributes.size();
     vertexInputState.pVertexAttributeDescriptions = attributes.data();
 
@@ -515,19 +622,19 @@ void SimpleRenderer::initPipeline()
     createInfo.layout = m_pipelineLayout;
     createInfo.renderPass = m_renderPass;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &m_pipeline);
 
     shaderStages[0] = skinnedVertexShaderStageInfo;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_skinnedPipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &m_skinnedPipeline);
 
     rasterizer.polygonMode = VK_POLYGON_MODE_LINE;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_skinnedPipelineWireframe);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &m_skinnedPipelineWireframe);
 
     shaderStages[0] = vertexShaderStageInfo;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipelineWireframe);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &m_pipelineWireframe);
 
     vkDestroyShaderModule(m_device.device, meshFragmentModule, nullptr);
     vkDestroyShaderModule(m_device.device, meshVertexModule, nullptr);
@@ -537,7 +644,7 @@ void SimpleRenderer::initPipeline()
 void SimpleRenderer::initDescriptors()
 {
     VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
-    boneInfoBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    boneInfoBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     boneInfoBufferBinding.descriptorCount = 1;
     boneInfoBufferBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     boneInfoBufferBinding.binding = 2;
@@ -567,7 +674,7 @@ void SimpleRenderer::initDescriptors()
     multiBinding.binding = 6;
 
     VkDescriptorSetLayoutBinding lightInfoBinding = {};
-    lightInfoBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightInfoBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     lightInfoBinding.descriptorCount = 1;
     lightInfoBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     lightInfoBinding.binding = 7;
@@ -699,7 +806,7 @@ void SimpleRenderer::initSkyPipeline()
     createInfo.layout = m_skyPipelineLayout;
     createInfo.renderPass = m_renderPass;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_skyPipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &createInfo, nullptr, &m_skyPipeline);
 
     vkDestroyShaderModule(m_device.device, fragmentModule, nullptr);
     vkDestroyShaderModule(m_device.device, vertexModule, nullptr);
@@ -758,18 +865,16 @@ VkDescriptorSet SimpleRenderer::createDescriptorFor(const DrawObject &model, con
 
     m_device.nameObject(VK_OBJECT_TYPE_DESCRIPTOR_SET, reinterpret_cast<uint64_t>(set), material.path);
 
-    constexpr size_t bufferSize = sizeof(glm::mat3x4) * JOINT_MATRIX_SIZE_DAWNTRAIL;
-
     std::vector<VkWriteDescriptorSet> writes;
 
     VkDescriptorBufferInfo bufferInfo = {};
     bufferInfo.buffer = model.boneInfoBuffer.buffer;
-    bufferInfo.range = bufferSize;
+    bufferInfo.range = DrawObject::boneInfoSize; // the frame's copy is picked when binding
 
     VkWriteDescriptorSet descriptorWrite = {};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrite.dstSet = set;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrite.descriptorCount = 1;
     descriptorWrite.pBufferInfo = &bufferInfo;
     descriptorWrite.dstBinding = 2;
@@ -861,13 +966,13 @@ VkDescriptorSet SimpleRenderer::createDescriptorFor(const DrawObject &model, con
     writes.push_back(multiDescriptorWrite2);
 
     VkDescriptorBufferInfo lightBufferInfo = {};
-    lightBufferInfo.buffer = m_lightsBuffer.buffer;
-    lightBufferInfo.range = m_lightsBuffer.size;
+    lightBufferInfo.buffer = m_lightsRing.buffer().buffer;
+    lightBufferInfo.range = MAX_LIGHTS * sizeof(ShaderLight); // the offset is given when binding
 
     VkWriteDescriptorSet lightBufferDescriptorWrite = {};
     lightBufferDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     lightBufferDescriptorWrite.dstSet = set;
-    lightBufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightBufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     lightBufferDescriptorWrite.descriptorCount = 1;
     lightBufferDescriptorWrite.pBufferInfo = &lightBufferInfo;
     lightBufferDescriptorWrite.dstBinding = 7;
@@ -931,6 +1036,31 @@ Device &SimpleRenderer::device()
     return m_device;
 }
 
+const Buffer &SimpleRenderer::prepareFrameBuffer(std::array<Buffer, SwapChain::framesInFlight> &buffers,
+                                                 const void *data,
+                                                 const size_t size,
+                                                 const VkBufferUsageFlags usageFlags,
+                                                 const std::string_view name)
+{
+    // The fence for this frame was already waited on, so nothing on the GPU is reading this buffer anymore
+    auto &buffer = buffers[m_device.swapChain->currentFrame % buffers.size()];
+
+    const size_t requiredSize = std::max<size_t>(size, 1);
+    if (requiredSize > buffer.size) {
+        m_device.destroyBuffer(buffer);
+
+        // Leave some room, so the buffer doesn't have to be recreated every time a few more models come into view
+        buffer = m_device.createBuffer(std::max(requiredSize * 2, initialFrameBufferSize), usageFlags);
+        m_device.nameBuffer(buffer, name);
+    }
+
+    if (size > 0) {
+        memcpy(buffer.mapped(), data, size);
+    }
+
+    return buffer;
+}
+
 VkFramebuffer SimpleRenderer::framebuffer() const
 {
     return m_framebuffer;
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "uniformring.h"
+
+#include "device.h"
+#include "swapchain.h"
+
+#include <algorithm>
+
+UniformRing::UniformRing(Device &device, const VkDeviceSize frameSize, const VkBufferUsageFlags usageFlags)
+    : m_device(device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_device.physicalDevice, &properties);
+
+    // The same buffer can be bound as either kind, so every allocation has to satisfy both
+    m_alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+
+    // Keeps every region aligned too
+    m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+    m_buffer = m_device.createBuffer(m_frameSize * SwapChain::framesInFlight, usageFlags);
+    m_device.nameBuffer(m_buffer, "Uniform Ring");
+}
+
+UniformRing::~UniformRing()
+{
+    m_device.destroyBuffer(m_buffer);
+}
+
+void UniformRing::beginFrame(const uint32_t frame)
+{
+    m_frameStart = m_frameSize * (frame % SwapChain::framesInFlight);
+    m_head = 0;
+}
+
+std::optional<UniformRing::Allocation> UniformRing::allocate(const VkDeviceSize size)
+{
+    if (m_head + size > m_frameSize) {
+        return std::nullopt;
+    }
+
+    const VkDeviceSize offset = m_frameStart + m_head;
+    m_head = (m_head + size + m_alignment - 1) / m_alignment * m_alignment;
+
+    return Allocation{.offset = static_cast<uint32_t>(offset), .data = static_cast<uint8_t *>(m_buffer.mapped()) + offset};
+}
+
+const Buffer &UniformRing::buffer() const
+{
+    return m_buffer;
+}
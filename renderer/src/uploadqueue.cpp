@@ -0,0 +1,283 @@
+// SPDX-FileCopyrightText: 2026 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "uploadqueue.h"
+
+#include "device.h"
+
+#include <QDebug>
+
+#include <cstring>
+#include <limits>
+
+// Enough for most textures, bigger ones get a temporary staging buffer
+static constexpr VkDeviceSize ringSize = 32 * 1024 * 1024;
+
+// Covers the texel block size of every format we upload, which is what vkCmdCopyBufferToImage requires for bufferOffset
+static constexpr VkDeviceSize stagingAlignment = 16;
+
+UploadQueue::UploadQueue(Device &device, const uint32_t queueFamilyIndex)
+    : m_device(device)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    vkCreateCommandPool(m_device.device, &poolInfo, nullptr, &m_commandPool);
+
+    m_ring = m_device.createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    m_device.nameBuffer(m_ring, "Staging Ring");
+}
+
+UploadQueue::~UploadQueue()
+{
+    waitForUploads();
+
+    for (const auto &batch : m_freeBatches) {
+        vkDestroyFence(m_device.device, batch.fence, nullptr);
+    }
+
+    // Also frees all of the command buffers
+    vkDestroyCommandPool(m_device.device, m_commandPool, nullptr);
+
+    m_device.destroyBuffer(m_ring);
+}
+
+void UploadQueue::uploadToBuffer(const Buffer &buffer, const void *data, const size_t size, const VkDeviceSize offset)
+{
+    if (size == 0) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceSize stagingOffset = 0;
+    void *staging = allocateStaging(size, stagingBuffer, stagingOffset);
+    memcpy(staging, data, size);
+
+    VkBufferCopy region = {};
+    region.srcOffset = stagingOffset;
+    region.dstOffset = offset;
+    region.size = size;
+
+    vkCmdCopyBuffer(recordingCommandBuffer(), stagingBuffer, buffer.buffer, 1, &region);
+}
+
+void UploadQueue::uploadToImage(const VkImage image,
+                                const VkImageSubresourceRange &range,
+                                const void *data,
+                                const size_t size,
+                                const std::vector<VkBufferImageCopy> &regions)
+{
+    QMutexLocker locker(&m_mutex);
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceSize stagingOffset = 0;
+    void *staging = allocateStaging(size, stagingBuffer, stagingOffset);
+    memcpy(staging, data, size);
+
+    std::vector<VkBufferImageCopy> stagingRegions = regions;
+    for (auto &region : stagingRegions) {
+        region.bufferOffset += stagingOffset;
+    }
+
+    const VkCommandBuffer commandBuffer = recordingCommandBuffer();
+
+    Device::inlineTransitionImageLayout(commandBuffer,
+                                        image,
+                                        VK_FORMAT_UNDEFINED,
+                                        range.aspectMask,
+                                        range,
+                                        VK_IMAGE_LAYOUT_UNDEFINED,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    vkCmdCopyBufferToImage(commandBuffer,
+                           stagingBuffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(stagingRegions.size()),
+                           stagingRegions.data());
+
+    Device::inlineTransitionImageLayout(commandBuffer,
+                                        image,
+                                        VK_FORMAT_UNDEFINED,
+                                        range.aspectMask,
+                                        range,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+}
+
+void UploadQueue::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    flushLocked();
+}
+
+void UploadQueue::waitForUploads()
+{
+    QMutexLocker locker(&m_mutex);
+    flushLocked();
+
+    while (!m_inFlight.empty()) {
+        retireBatches(true);
+    }
+}
+
+void *UploadQueue::allocateStaging(const size_t size, VkBuffer &buffer, VkDeviceSize &offset)
+{
+    // It would never fit, so don't stall on uploads in flight just to find that out
+    if (size > m_ring.size) {
+        auto &temporaryBuffer = m_recording.temporaryBuffers.emplace_back(m_device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+
+        buffer = temporaryBuffer.buffer;
+        offset = 0;
+        return temporaryBuffer.mapped();
+    }
+
+    while (!tryAllocateFromRing(size, offset)) {
+        if (!m_inFlight.empty()) {
+            // Only waits for the oldest batch of uploads, which is usually done by now anyway
+            retireBatches(true);
+        } else {
+            // Everything left in the ring belongs to the batch being recorded
+            flushLocked();
+        }
+    }
+
+    buffer = m_ring.buffer;
+    return static_cast<uint8_t *>(m_ring.mapped()) + offset;
+}
+
+bool UploadQueue::tryAllocateFromRing(const size_t size, VkDeviceSize &offset)
+{
+    const VkDeviceSize alignedHead = (m_ringHead + stagingAlignment - 1) & ~(stagingAlignment - 1);
+
+    VkDeviceSize consumed = 0;
+    if (alignedHead + size <= m_ring.size) {
+        offset = alignedHead;
+        consumed = alignedHead - m_ringHead + size;
+    } else {
+        // Wrap around, and waste whatever is left at the end
+        offset = 0;
+        consumed = m_ring.size - m_ringHead + size;
+    }
+
+    if (m_ringUsed + consumed > m_ring.size) {
+        return false;
+    }
+
+    m_ringHead = offset + size;
+    m_ringUsed += consumed;
+    m_recording.ringBytes += consumed;
+
+    return true;
+}
+
+VkCommandBuffer UploadQueue::recordingCommandBuffer()
+{
+    if (m_recording.commandBuffer != VK_NULL_HANDLE) {
+        return m_recording.commandBuffer;
+    }
+
+    if (!m_freeBatches.empty()) {
+        m_recording.commandBuffer = m_freeBatches.back().commandBuffer;
+        m_recording.fence = m_freeBatches.back().fence;
+        m_freeBatches.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        vkAllocateCommandBuffers(m_device.device, &allocInfo, &m_recording.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        vkCreateFence(m_device.device, &fenceInfo, nullptr, &m_recording.fence);
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(m_recording.commandBuffer, &beginInfo);
+
+    return m_recording.commandBuffer;
+}
+
+void UploadQueue::flushLocked()
+{
+    if (m_recording.commandBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // Barriers apply to everything later in submission order, so any frame submitted after this sees the new data
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier(m_recording.commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+
+    vkEndCommandBuffer(m_recording.commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_recording.commandBuffer;
+
+    vkResetFences(m_device.device, 1, &m_recording.fence);
+    if (vkQueueSubmit(m_device.graphicsQueue, 1, &submitInfo, m_recording.fence) != VK_SUCCESS) {
+        qWarning() << "Failed to submit uploads";
+    }
+
+    m_inFlight.push_back(std::move(m_recording));
+    m_recording = {};
+
+    // Opportunistically clean up anything that's already done
+    retireBatches(false);
+}
+
+void UploadQueue::retireBatches(const bool waitForOldest)
+{
+    bool wait = waitForOldest;
+    while (!m_inFlight.empty()) {
+        auto &batch = m_inFlight.front();
+        if (wait) {
+            vkWaitForFences(m_device.device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            wait = false;
+        } else if (vkGetFenceStatus(m_device.device, batch.fence) != VK_SUCCESS) {
+            break;
+        }
+
+        for (auto &buffer : batch.temporaryBuffers) {
+            m_device.destroyBuffer(buffer);
+        }
+        m_ringUsed -= batch.ringBytes;
+
+        m_freeBatches.push_back(Batch{.commandBuffer = batch.commandBuffer, .fence = batch.fence});
+        m_inFlight.pop_front();
+    }
+
+    // Start from the beginning again when possible, so there's less wasted space from wrapping around
+    if (m_ringUsed == 0) {
+        m_ringHead = 0;
+    }
+}
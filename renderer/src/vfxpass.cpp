@@ -199,7 +199,7 @@ void VfxPass::createPipeline()
     pipelineInfo.layout = m_pipelineLayout;
     pipelineInfo.renderPass = renderer->renderPass();
 
-    vkCreateGraphicsPipelines(m_device.device, nullptr, 1, &pipelineInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline);
 
     vkDestroyShaderModule(m_device.device, debugVertexShader, nullptr);
     vkDestroyShaderModule(m_device.device, debugFragmentShader, nullptr);